@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <cipv4.h>
+#include <cipv4_acl.h>
+#include <cipv4_sort.h>
+#include <cipv4_anon.h>
+#include <cipv4_flow.h>
+#include <cipv4_gen.h>
+#include <cipv4_net.h>
+#include <cipv4_limit.h>
+#include <cipv4_ingest.h>
+#include <cipv4_hist.h>
+#include <util_string.h>
+
+/**
+ * Benchmark harness for the hot paths of the library.
+ *
+ * The input corpus is generated from a fixed seed and mixes valid and
+ * invalid addresses, so two runs on the same machine are comparable.
+ * Every benchmark prints one JSON object per line:
+ *
+ * {"benchmark": "...", "ops": N, "ns_per_op": X, "ops_per_sec": Y, "allocs_per_op": Z,
+ *  "items_per_op": I, "ns_per_item": X / I}
+ *
+ * An item is what one call of the single-address benchmarks handles (an
+ * address, a database line or rule, a histogram bucket), so ns_per_item
+ * compares batch calls such as cipv4_flow_classify_64 with them.
+ *
+ * Allocations are counted by wrapping malloc/calloc/realloc at link
+ * time (-Wl,--wrap=malloc ...), see the bench target of the Makefile.
+ *
+ * Usage: bench [path-to-example.db] [min-seconds-per-benchmark]
+ */
+
+#define CORPUS_SIZE 65536
+#define VALID_PERCENT 80
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void * p, size_t size);
+
+static unsigned long int allocs = 0;
+
+void * __wrap_malloc(size_t size){
+    allocs++;
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t n, size_t size){
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void * __wrap_realloc(void * p, size_t size){
+    allocs++;
+    return __real_realloc(p, size);
+}
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+static double min_seconds = 0.25;
+static volatile long int sink = 0;
+
+static uint32_t rng(void){
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char * name, unsigned long int ops, unsigned long int items, double seconds,
+                   unsigned long int nallocs){
+    fprintf(stdout, "{\"benchmark\": \"%s\", \"ops\": %lu, \"ns_per_op\": %.2f, "
+            "\"ops_per_sec\": %.0f, \"allocs_per_op\": %.3f, \"items_per_op\": %lu, \"ns_per_item\": %.2f}\n",
+            name, ops, seconds * 1e9 / ops, ops / seconds, (double)nallocs / ops,
+            items, seconds * 1e9 / ops / items);
+    fflush(stdout);
+}
+
+// one of the rejection paths of cipv4_is_ip_valid()
+static void make_invalid(char * buffer){
+    uint32_t a = rng();
+    switch (rng() % 7){
+        case 0: sprintf(buffer, "%u.%u.%u.%u", a >> 24, (a >> 16) & 0xFF, 256 + (a & 0x3FF), a & 0xFF); break;
+        case 1: sprintf(buffer, "%u.0%u.%u.%u", a >> 24, 1 + (a >> 16) % 9, (a >> 8) & 0xFF, a & 0xFF); break;
+        case 2: sprintf(buffer, "%u.%u.%u", a >> 24, (a >> 16) & 0xFF, (a >> 8) & 0xFF); break;
+        case 3: sprintf(buffer, "%u.%u.x%u.%u", a >> 24, (a >> 16) & 0xFF, (a >> 8) & 0xF, a & 0xFF); break;
+        case 4: sprintf(buffer, "%u..%u.%u", a >> 24, (a >> 8) & 0xFF, a & 0xFF); break;
+        case 5: sprintf(buffer, "%u.%u.%u.%u.", a >> 24, (a >> 16) & 0xFF, (a >> 8) & 0xFF, a & 0xFF); break;
+        default: sprintf(buffer, "1%u.1%u.1%u.1%u", 100 + (a >> 24) % 900, 100 + (a >> 8) % 900,
+                         100 + (a >> 16) % 900, 100 + a % 900); break;
+    }
+}
+
+// valid addresses are biased towards the special ranges so the
+// classifiers do not always take the same branch
+static void make_valid(char * buffer){
+    static const char * prefixes[] = {"10", "127", "169.254", "172.16", "192.168", "100.64", "224", "240"};
+    uint32_t a = rng();
+    if (rng() % 4 == 0){
+        const char * p = prefixes[rng() % 8];
+        int dots = (int)cstr_count(p, DOT);
+        if (dots == 0)
+            sprintf(buffer, "%s.%u.%u.%u", p, (a >> 16) & 0xFF, (a >> 8) & 0xFF, a & 0xFF);
+        else
+            sprintf(buffer, "%s.%u.%u", p, (a >> 8) & 0xFF, a & 0xFF);
+        return;
+    }
+    cipv4_uint_to_str(a, buffer);
+}
+
+static unsigned long int load_lines(const char * path, char *** lines){
+    FILE * f = fopen(path, "r");
+    if (!f)
+        return 0;
+    unsigned long int n = 0;
+    unsigned long int capacity = 1024;
+    char buffer[256];
+    char trimmed[256];
+    *lines = (char**) malloc(capacity * sizeof(char*));
+    while (fgets(buffer, sizeof(buffer), f)){
+        cstr_trim(buffer, trimmed);
+        if (cstr_len(trimmed) == 0)
+            continue;
+        if (n == capacity){
+            capacity *= 2;
+            *lines = (char**) realloc(*lines, capacity * sizeof(char*));
+        }
+        (*lines)[n] = (char*) malloc(cstr_len(trimmed) + 1);
+        cstr_cpy((*lines)[n++], trimmed);
+    }
+    fclose(f);
+    return n;
+}
+
+// run the body for i in 0~n-1 again and again until min_seconds elapsed,
+// every run of the body handles items addresses (or lines, rules, ...)
+#define BENCH_ITEMS(name, n, items, ...) do{                                         \
+        unsigned long int _ops = 0;                                     \
+        unsigned long int _allocs = allocs;                             \
+        double _start = now();                                          \
+        double _elapsed = 0;                                            \
+        do{                                                             \
+            for (unsigned long int i=0; i<(n); ++i){ __VA_ARGS__; }      \
+            _ops += (n);                                                \
+            _elapsed = now() - _start;                                  \
+        }while (_elapsed < min_seconds);                                \
+        report(name, _ops, (items), _elapsed, allocs - _allocs);        \
+    }while(0)
+#define BENCH(name, n, ...) BENCH_ITEMS(name, n, 1, __VA_ARGS__)
+
+typedef int (*classifier_from_string)(const char *);
+typedef int (*classifier)(cipv4_ctx *);
+
+int main(int argc, char ** argv){
+    const char * path = argc > 1 ? argv[1] : "test/example.db";
+    if (argc > 2)
+        min_seconds = atof(argv[2]);
+    char (*corpus)[20] = malloc(CORPUS_SIZE * sizeof(*corpus));
+    char (*valid)[20] = malloc(CORPUS_SIZE * sizeof(*valid));
+    uint32_t * uints = (uint32_t*) malloc(CORPUS_SIZE * sizeof(uint32_t));
+    cipv4_ctx ** ctxs = (cipv4_ctx**) malloc(CORPUS_SIZE * sizeof(cipv4_ctx*));
+    char buffer[20];
+    for (int i=0; i<CORPUS_SIZE; ++i){
+        if (rng() % 100 < VALID_PERCENT)
+            make_valid(corpus[i]);
+        else
+            make_invalid(corpus[i]);
+        make_valid(valid[i]);
+        uints[i] = cipv4_str_to_uint(valid[i]);
+        ctxs[i] = cipv4_parse_ip(valid[i]);
+    }
+
+    BENCH("cipv4_is_ip_valid", CORPUS_SIZE, sink += cipv4_is_ip_valid(corpus[i]));
+    BENCH("cipv4_str_to_uint", CORPUS_SIZE, sink += cipv4_str_to_uint(valid[i]));
+    BENCH("cipv4_uint_to_str", CORPUS_SIZE, sink += cipv4_uint_to_str(uints[i], buffer)[0]);
+    BENCH("cipv4_parse_ip", CORPUS_SIZE,
+          cipv4_ctx * ctx = cipv4_parse_ip(corpus[i]); if (ctx) sink += ctx->error; cipv4_free(ctx));
+    // a whole corpus alive at once, as when loading a database
+    cipv4_ctx ** keep = (cipv4_ctx**) malloc(CORPUS_SIZE * sizeof(cipv4_ctx*));
+    BENCH("cipv4_parse_ip_keep", CORPUS_SIZE,
+          keep[i] = cipv4_parse_ip(corpus[i]); if (keep[i]) sink += keep[i]->error;
+          if (i == CORPUS_SIZE - 1) for (int k=0; k<CORPUS_SIZE; ++k) cipv4_free(keep[k]));
+    free(keep);
+    cipv4_arena * arena = cipv4_arena_new(0);
+    BENCH("cipv4_parse_ip_arena", CORPUS_SIZE,
+          cipv4_ctx * ctx = cipv4_parse_ip_arena(arena, corpus[i]); if (ctx) sink += ctx->error;
+          if (i == CORPUS_SIZE - 1) cipv4_arena_reset(arena));
+    cipv4_arena_free(arena);
+
+    static const struct { const char * name; classifier_from_string fn; } from_string[] = {
+        {"cipv4_is_private_from_string", cipv4_is_private_from_string},
+        {"cipv4_is_public_network_from_string", cipv4_is_public_network_from_string},
+        {"cipv4_is_global_from_string", cipv4_is_global_from_string},
+        {"cipv4_is_loopback_from_string", cipv4_is_loopback_from_string},
+        {"cipv4_is_multicast_from_string", cipv4_is_multicast_from_string},
+        {"cipv4_is_unspecified_from_string", cipv4_is_unspecified_from_string},
+        {"cipv4_is_linklocal_from_string", cipv4_is_linklocal_from_string},
+        {"cipv4_is_reserved_from_string", cipv4_is_reserved_from_string},
+    };
+    static const struct { const char * name; classifier fn; } from_ctx[] = {
+        {"cipv4_is_private", cipv4_is_private},
+        {"cipv4_is_public_network", cipv4_is_public_network},
+        {"cipv4_is_global", cipv4_is_global},
+        {"cipv4_is_loopback", cipv4_is_loopback},
+        {"cipv4_is_multicast", cipv4_is_multicast},
+        {"cipv4_is_unspecified", cipv4_is_unspecified},
+        {"cipv4_is_linklocal", cipv4_is_linklocal},
+        {"cipv4_is_reserved", cipv4_is_reserved},
+    };
+    for (unsigned long int c=0; c<sizeof(from_string) / sizeof(from_string[0]); ++c){
+        from_string[c].fn(valid[0]);        // lazy initialization is not measured
+        BENCH(from_string[c].name, CORPUS_SIZE, sink += from_string[c].fn(corpus[i]));
+    }
+    for (unsigned long int c=0; c<sizeof(from_ctx) / sizeof(from_ctx[0]); ++c){
+        from_ctx[c].fn(ctxs[0]);
+        BENCH(from_ctx[c].name, CORPUS_SIZE, sink += from_ctx[c].fn(ctxs[i]));
+    }
+
+    char ** lines = NULL;
+    unsigned long int nlines = load_lines(path, &lines);
+    if (nlines == 0){
+        fprintf(stderr, "Can not read %s\n", path);
+        return 1;
+    }
+    // test_1.c: parse every line of the database and test one address
+    BENCH("db_scan", nlines,
+          cipv4_ctx * ctx = cipv4_parse_ip(lines[i]);
+          if (ctx && ctx->error == 0) sink += cipv4_is_address_in(ctx, valid[i & (CORPUS_SIZE - 1)]);
+          cipv4_free(ctx));
+
+    // the same database in one buffer, every line per call
+    size_t db_size = 0;
+    for (unsigned long int i=0; i<nlines; ++i)
+        db_size += strlen(lines[i]) + 1;
+    char * db_buffer = (char*) malloc(db_size);
+    for (size_t i=0, off=0; i<nlines; ++i){
+        size_t len = strlen(lines[i]);
+        memcpy(db_buffer + off, lines[i], len);
+        db_buffer[off + len] = '\n';
+        off += len + 1;
+    }
+    BENCH_ITEMS("cipv4_ingest_buffer_db", 1, nlines,
+          cipv4_ingest * ingest = cipv4_ingest_new();
+          sink += cipv4_ingest_buffer(ingest, db_buffer, db_size);
+          cipv4_ingest_free(ingest));
+    free(db_buffer);
+
+    cipv4_acl_rule * rules = (cipv4_acl_rule*) malloc(nlines * sizeof(cipv4_acl_rule));
+    unsigned long int nrules = 0;
+    for (unsigned long int i=0; i<nlines; ++i){
+        cipv4_ctx * ctx = cipv4_parse_ip(lines[i]);
+        if (!ctx || ctx->error != 0){
+            cipv4_free(ctx);
+            continue;
+        }
+        rules[nrules].addr = ctx->addr;
+        rules[nrules].network_prefix = ctx->network_prefix;
+        rules[nrules].action = CIPV4_ACL_PERMIT;
+        nrules++;
+        cipv4_free(ctx);
+    }
+    cipv4_acl * acl = cipv4_acl_compile(rules, nrules, CIPV4_ACL_DENY);
+    BENCH("cipv4_acl_lookup", CORPUS_SIZE, sink += cipv4_acl_lookup(acl, uints[i]));
+
+    // the whole database per call: overlaps inside it, then against its first half
+    cipv4_net * nets = (cipv4_net*) malloc(nrules * sizeof(cipv4_net));
+    uint8_t * net_flags = (uint8_t*) malloc(nrules);
+    for (unsigned long int i=0; i<nrules; ++i){
+        nets[i].addr_start = rules[i].addr;
+        nets[i].network_prefix = rules[i].network_prefix;
+    }
+    BENCH_ITEMS("cipv4_net_overlaps_within_db", 1, nrules, sink += cipv4_net_overlaps_within(nets, nrules, net_flags));
+    BENCH_ITEMS("cipv4_net_match_any_db", 1, nrules,
+          sink += cipv4_net_match_any(nets, nrules, nets, nrules / 2, CIPV4_NET_OVERLAPS, net_flags));
+    free(nets);
+    free(net_flags);
+
+    // per matched prefix of the database, /24 for the others, 64 addresses per call
+    cipv4_limit_config limit_config;
+    cipv4_limit_config_init(&limit_config);
+    limit_config.acl = cipv4_acl_compile_lpm(rules, nrules, CIPV4_ACL_DENY);
+    limit_config.capacity = 1 << 20;
+    cipv4_limit * limit = cipv4_limit_new(&limit_config);
+    uint8_t limit_admitted[64];
+    uint64_t limit_now = cipv4_limit_now();
+    BENCH_ITEMS("cipv4_limit_admit_64", CORPUS_SIZE / 64, 64,
+          sink += cipv4_limit_admit(limit, uints + 64 * i, 64, limit_now + i, limit_admitted));
+    cipv4_limit_free(limit);
+    cipv4_acl_free((cipv4_acl*) limit_config.acl);
+    // network-order src/dst of 16-byte flow records, 64 records per call
+    uint32_t * flows = (uint32_t*) malloc(CORPUS_SIZE * 4 * sizeof(uint32_t));
+    uint32_t flow_addrs[64];
+    uint8_t flow_classes[64];
+    int flow_rules[64];
+    for (int i=0; i<CORPUS_SIZE; ++i)
+        flows[4 * i] = __builtin_bswap32(uints[i]);
+    BENCH_ITEMS("cipv4_flow_classify_64", CORPUS_SIZE / 64, 64,
+          cipv4_flow_classify(flows + 4 * 64 * i, 16, 64, acl, flow_addrs, flow_classes, flow_rules);
+          sink += flow_rules[0]);
+    cipv4_acl_free(acl);
+    free(flows);
+
+    uint32_t * sorted = (uint32_t*) malloc(CORPUS_SIZE * sizeof(uint32_t));
+    BENCH_ITEMS("cipv4_sort_65536", 1, CORPUS_SIZE,
+          memcpy(sorted, uints, CORPUS_SIZE * sizeof(uint32_t)); cipv4_sort(sorted, CORPUS_SIZE));
+    BENCH_ITEMS("cipv4_sort_parallel_4_65536", 1, CORPUS_SIZE,
+          memcpy(sorted, uints, CORPUS_SIZE * sizeof(uint32_t)); cipv4_sort_parallel(sorted, CORPUS_SIZE, 4));
+
+    uint8_t key[CIPV4_ANON_KEY_LENGTH];
+    for (int i=0; i<CIPV4_ANON_KEY_LENGTH; ++i)
+        key[i] = (uint8_t)rng();
+    cipv4_anon * anon = cipv4_anon_new(key);
+    BENCH("cipv4_anon_addr", CORPUS_SIZE, sink += cipv4_anon_addr(anon, uints[i]));
+    anon->aesni = 0;
+    BENCH("cipv4_anon_addr_soft", CORPUS_SIZE, sink += cipv4_anon_addr(anon, uints[i]));
+    cipv4_anon_free(anon);
+
+    // 4096 records per call, the output is rewritten in place
+    cipv4_net all = {0, 0};
+    cipv4_gen_config gen_config;
+    cipv4_gen_config_init(&gen_config);
+    gen_config.exclude = CIPV4_CLASS_PRIVATE;
+    gen_config.malformed_rate = 0.01;
+    cipv4_gen * gen = cipv4_gen_new(&all, 1, &gen_config);
+    char * gen_text = (char*) malloc(4096 * CIPV4_GEN_MAX_LINE);
+    BENCH_ITEMS("cipv4_gen_addrs_4096", CORPUS_SIZE / 4096, 4096,
+          cipv4_gen_addrs(gen, i * 4096, sorted, 4096); sink += sorted[0]);
+    BENCH_ITEMS("cipv4_gen_text_4096", CORPUS_SIZE / 4096, 4096,
+          sink += cipv4_gen_text(gen, i * 4096, 4096, gen_text));
+    cipv4_gen_free(gen);
+    free(gen_text);
+
+    // 4096 addresses per call into one shard, then the merge of all the /24 buckets
+    cipv4_hist * hist16 = cipv4_hist_new(16, 1);
+    cipv4_hist * hist24 = cipv4_hist_new(24, 1);
+    BENCH_ITEMS("cipv4_hist_add_batch_16_4096", CORPUS_SIZE / 4096, 4096,
+          cipv4_hist_add_batch(hist16->shards, uints + i * 4096, 4096));
+    BENCH_ITEMS("cipv4_hist_add_batch_24_4096", CORPUS_SIZE / 4096, 4096,
+          cipv4_hist_add_batch(hist24->shards, uints + i * 4096, 4096));
+    BENCH_ITEMS("cipv4_hist_merge_24", 1, hist24->nbuckets, sink += cipv4_hist_merge(hist24, 1));
+    cipv4_hist_free(hist16);
+    cipv4_hist_free(hist24);
+
+    for (unsigned long int i=0; i<nlines; ++i)
+        free(lines[i]);
+    for (int i=0; i<CORPUS_SIZE; ++i)
+        cipv4_free(ctxs[i]);
+    free(lines);
+    free(rules);
+    free(sorted);
+    free(corpus);
+    free(valid);
+    free(uints);
+    free(ctxs);
+    return 0;
+}
@@ -7,6 +7,17 @@
 
 #define DOT '.'
 #define CIPV4_PRAVATE_ARRAY_LENGTH 14
+#define CIPV4_ERR_MSG_LENGTH 256
+#define CIPV4_ARENA_BLOCK_SIZE (1024 * 1024)
+
+// the networks of cipv4_is_private(), X(a, b, c, d, prefix) for every one
+// of them builds the tables of cipv4.c, cipv4_flow.c and cipv4.hpp
+#define CIPV4_PRIVATE_NETWORKS(X)                                       \
+    X(0, 0, 0, 0, 8) X(10, 0, 0, 0, 8) X(127, 0, 0, 0, 8)               \
+    X(240, 0, 0, 0, 4) X(255, 255, 255, 255, 32) X(169, 254, 0, 0, 16)  \
+    X(172, 16, 0, 0, 12) X(192, 0, 0, 0, 29) X(192, 0, 0, 170, 31)     \
+    X(192, 0, 2, 0, 24) X(192, 168, 0, 0, 16) X(198, 18, 0, 0, 15)     \
+    X(198, 51, 100, 0, 24) X(203, 0, 113, 0, 24)
 
 /**
 * @details Type definition of the struct _cipv4_ctx
@@ -16,6 +27,20 @@
 */
 typedef struct _cipv4_ctx cipv4_ctx;
 
+/**
+* @details Type definition of the struct _cipv4_arena
+*
+* cipv4_arena: memory arena created by cipv4_arena_new()
+*/
+typedef struct _cipv4_arena cipv4_arena;
+
+/**
+* @details Type definition of the struct _cipv4_net
+*
+* cipv4_net: a network as a packed (start, prefix) pair
+*/
+typedef struct _cipv4_net cipv4_net;
+
 
 /**
  * @details This structure contains all the necessary information for IPv4.
@@ -28,12 +53,25 @@ struct _cipv4_ctx{
     char * err_msg;           ///< description of the error code goes here
     uint32_t addr_start;      ///< first IP address in range
     uint32_t addr_end;        ///< end of ip address range for this prefix
+    cipv4_arena * arena;      ///< arena the context is allocated from (NULL for malloc)
+};
+
+/**
+ * @details A network without the strings of cipv4_ctx, for large arrays.
+ */
+struct _cipv4_net{
+    uint32_t addr_start;      ///< first IP address of the network (host bits are 0)
+    uint8_t network_prefix;   ///< prefix len between 0~32
 };
 
 
 
 void cipv4_free(cipv4_ctx * ctx);
 cipv4_ctx * cipv4_parse_ip(const char * ip);
+cipv4_ctx * cipv4_parse_ip_arena(cipv4_arena * arena, const char * ip);
+cipv4_arena * cipv4_arena_new(unsigned long int block_size);
+void cipv4_arena_reset(cipv4_arena * arena);
+void cipv4_arena_free(cipv4_arena * arena);
 char * cipv4_get_network_address(cipv4_ctx ctx);
 char * cipv4_get_broadcast_address(cipv4_ctx ctx);
 char * cipv4_get_subnet_mask(cipv4_ctx* ctx, char * buffer);
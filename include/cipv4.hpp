@@ -0,0 +1,216 @@
+/** @file */
+#ifndef _CIPV4_HPP_
+#define _CIPV4_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include <cipv4.h>
+}
+
+/**
+ * @details Header-only C++17 layer over the C library.
+ *
+ * `address` and `network` are trivially copyable values; parsing, masks,
+ * containment and the special-range tests are constexpr. Literals used in
+ * a constant expression (constexpr variable, static_assert, template
+ * argument) are checked by the compiler and folded into constants, so
+ * `net.contains(a)` compiles to the same mask and compare as a hand-written
+ * bit test:
+ *
+ * @code
+ * using namespace cipv4::literals;
+ * constexpr auto net = "10.0.0.0/8"_net;      // compile error if invalid
+ * static_assert(net.contains("10.20.30.40"_ip));
+ * bool inside = net.contains(cipv4::address(cipv4_str_to_uint(buffer)));
+ * @endcode
+ *
+ * Parsing follows cipv4_is_ip_valid() and cipv4_parse_ip(): four decimal
+ * parts without leading zeros and an optional prefix between 1~32.
+ */
+namespace cipv4{
+
+/**
+ * @details An IPv4 address (same value as cipv4_str_to_uint()).
+ */
+class address{
+public:
+    constexpr address() noexcept : value_(0){}
+    constexpr explicit address(uint32_t value) noexcept : value_(value){}
+
+    /// parse "a.b.c.d", returns an empty optional for invalid input
+    static constexpr std::optional<address> parse(std::string_view s) noexcept{
+        uint32_t value = 0;
+        std::size_t pos = 0;
+        for (int part=0; part<4; ++part){
+            if (part > 0){
+                if (pos >= s.size() || s[pos] != DOT)
+                    return std::nullopt;
+                ++pos;
+            }
+            std::size_t begin = pos;
+            uint32_t octet = 0;
+            while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && pos - begin < 3)
+                octet = octet * 10 + (uint32_t)(s[pos++] - '0');
+            std::size_t len = pos - begin;
+            if (len == 0 || (len > 1 && s[begin] == '0') || octet > 255)
+                return std::nullopt;
+            value = (value << 8) | octet;
+        }
+        if (pos != s.size())
+            return std::nullopt;
+        return address(value);
+    }
+
+    static address from_ctx(const cipv4_ctx & ctx) noexcept{ return address(ctx.addr); }
+
+    constexpr uint32_t value() const noexcept{ return value_; }
+    constexpr uint8_t octet(int i) const noexcept{ return (uint8_t)(value_ >> (8 * (3 - i))); }
+
+    constexpr bool is_private() const noexcept;
+    constexpr bool is_public_network() const noexcept;
+    constexpr bool is_global() const noexcept;
+    constexpr bool is_loopback() const noexcept;
+    constexpr bool is_multicast() const noexcept;
+    constexpr bool is_unspecified() const noexcept;
+    constexpr bool is_linklocal() const noexcept;
+    constexpr bool is_reserved() const noexcept;
+
+    /// same output as cipv4_uint_to_str(), buffer must hold 16 chars
+    const char * to_string(char * buffer) const noexcept{ return cipv4_uint_to_str(value_, buffer); }
+
+    friend constexpr bool operator==(address a, address b) noexcept{ return a.value_ == b.value_; }
+    friend constexpr bool operator!=(address a, address b) noexcept{ return a.value_ != b.value_; }
+    friend constexpr bool operator<(address a, address b) noexcept{ return a.value_ < b.value_; }
+
+private:
+    uint32_t value_;
+};
+
+/**
+ * @details An IPv4 network: the address (host bits kept, like
+ * cipv4_ctx.addr) and the prefix len.
+ */
+class network{
+public:
+    constexpr network() noexcept : addr_(0), prefix_(32){}
+    /// throws std::invalid_argument if prefix is above 32
+    constexpr network(address addr, uint8_t prefix) : addr_(addr.value()), prefix_(checked_prefix(prefix)){}
+
+    /// parse "a.b.c.d" or "a.b.c.d/len", returns an empty optional for invalid input
+    static constexpr std::optional<network> parse(std::string_view s) noexcept{
+        std::size_t slash = s.find('/');
+        auto addr = address::parse(s.substr(0, slash));
+        if (!addr)
+            return std::nullopt;
+        if (slash == std::string_view::npos)
+            return network(*addr, 32);
+        std::string_view p = s.substr(slash + 1);
+        if (p.empty() || p.size() > 2 || p[0] == '0')
+            return std::nullopt;
+        uint32_t prefix = 0;
+        for (char c : p){
+            if (c < '0' || c > '9')
+                return std::nullopt;
+            prefix = prefix * 10 + (uint32_t)(c - '0');
+        }
+        if (prefix < 1 || prefix > 32)
+            return std::nullopt;
+        return network(*addr, (uint8_t)prefix);
+    }
+
+    static network from_ctx(const cipv4_ctx & ctx){ return network(address(ctx.addr), ctx.network_prefix); }
+
+    constexpr address addr() const noexcept{ return address(addr_); }
+    constexpr uint8_t prefix() const noexcept{ return prefix_; }
+    constexpr uint32_t mask() const noexcept{ return prefix_ == 0 ? 0 : 0xFFFFFFFFu << (32 - prefix_); }
+    constexpr uint32_t hostmask() const noexcept{ return ~mask(); }
+    constexpr address first() const noexcept{ return address(addr_ & mask()); }
+    constexpr address last() const noexcept{ return address(addr_ | hostmask()); }
+    constexpr uint64_t size() const noexcept{ return (uint64_t)hostmask() + 1; }
+
+    constexpr bool contains(address a) const noexcept{ return ((a.value() ^ addr_) & mask()) == 0; }
+    constexpr bool contains(network n) const noexcept{ return n.prefix_ >= prefix_ && contains(n.addr()); }
+
+    friend constexpr bool operator==(network a, network b) noexcept{ return a.addr_ == b.addr_ && a.prefix_ == b.prefix_; }
+    friend constexpr bool operator!=(network a, network b) noexcept{ return !(a == b); }
+
+private:
+    static constexpr uint8_t checked_prefix(uint8_t prefix){
+        if (prefix > 32)
+            throw std::invalid_argument("cipv4: IPv4 network prefix above 32");
+        return prefix;
+    }
+
+    uint32_t addr_;
+    uint8_t prefix_;
+};
+
+static_assert(std::is_trivially_copyable<address>::value, "address must be trivially copyable");
+static_assert(std::is_trivially_copyable<network>::value, "network must be trivially copyable");
+
+namespace detail{
+
+constexpr network must_parse(std::string_view s){
+    auto n = network::parse(s);
+    // throwing here makes the literal ill-formed in a constant expression
+    if (!n)
+        throw std::invalid_argument("cipv4: invalid IPv4 network");
+    return *n;
+}
+
+#define CIPV4_HPP_PRIVATE(a, b, c, d, prefix) \
+    network(address(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d)), prefix),
+constexpr network private_networks[CIPV4_PRAVATE_ARRAY_LENGTH] = {CIPV4_PRIVATE_NETWORKS(CIPV4_HPP_PRIVATE)};
+#undef CIPV4_HPP_PRIVATE
+constexpr network public_network = must_parse("100.64.0.0/10");
+constexpr network loopback = must_parse("127.0.0.0/8");
+constexpr network multicast = must_parse("224.0.0.0/4");
+constexpr network linklocal = must_parse("169.254.0.0/16");
+constexpr network reserved = must_parse("240.0.0.0/4");
+
+// unrolled so every test is folded into a constant mask and compare
+template <std::size_t... I>
+constexpr bool in_private_networks(address a, std::index_sequence<I...>) noexcept{
+    return (private_networks[I].contains(a) || ...);
+}
+
+}
+
+constexpr bool address::is_private() const noexcept{
+    return detail::in_private_networks(*this, std::make_index_sequence<CIPV4_PRAVATE_ARRAY_LENGTH>());
+}
+
+constexpr bool address::is_public_network() const noexcept{ return detail::public_network.contains(*this); }
+constexpr bool address::is_global() const noexcept{ return !is_private() && !is_public_network(); }
+constexpr bool address::is_loopback() const noexcept{ return detail::loopback.contains(*this); }
+constexpr bool address::is_multicast() const noexcept{ return detail::multicast.contains(*this); }
+constexpr bool address::is_unspecified() const noexcept{ return value_ == 0; }
+constexpr bool address::is_linklocal() const noexcept{ return detail::linklocal.contains(*this); }
+constexpr bool address::is_reserved() const noexcept{ return detail::reserved.contains(*this); }
+
+namespace literals{
+
+/// "10.1.2.3"_ip, ill-formed in a constant expression if the address is invalid
+constexpr address operator""_ip(const char * s, std::size_t len){
+    auto a = address::parse(std::string_view(s, len));
+    if (!a)
+        throw std::invalid_argument("cipv4: invalid IPv4 address");
+    return *a;
+}
+
+/// "10.0.0.0/8"_net, ill-formed in a constant expression if the network is invalid
+constexpr network operator""_net(const char * s, std::size_t len){
+    return detail::must_parse(std::string_view(s, len));
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+/** @file */
+#include <stdint.h>
+
+#ifndef _CIPV4_ACL_H_
+#define _CIPV4_ACL_H_
+
+
+#define CIPV4_ACL_DENY 0
+#define CIPV4_ACL_PERMIT 1
+#define CIPV4_ACL_CHUNK 0x80000000u
+
+/**
+* @details Type definition of the struct _cipv4_acl_rule
+*
+* cipv4_acl_rule: one ordered "action network" entry of an ACL
+*/
+typedef struct _cipv4_acl_rule cipv4_acl_rule;
+
+/**
+ * @details One ACL entry. The fields can be filled directly from the
+ * context returned by cipv4_parse_ip() (addr and network_prefix).
+ */
+struct _cipv4_acl_rule{
+    uint32_t addr;            ///< network address, host bits are ignored
+    uint8_t network_prefix;   ///< prefix len between 0~32 (0 matches everything)
+    int action;               ///< value returned when this rule is the first match
+};
+
+/**
+* @details Type definition of the struct _cipv4_acl_range
+*
+* cipv4_acl_range: a disjoint address range and the rule deciding it
+*/
+typedef struct _cipv4_acl_range cipv4_acl_range;
+
+/**
+ * @details A range of addresses which is decided by the same rule.
+ */
+struct _cipv4_acl_range{
+    uint32_t addr_start;      ///< first IP address in range
+    uint32_t addr_end;        ///< last IP address in range
+    int rule;                 ///< index of the first matching rule or -1 (default action)
+};
+
+/**
+* @details Type definition of the struct _cipv4_acl
+*
+* cipv4_acl: compiled ACL created by cipv4_acl_compile()
+*/
+typedef struct _cipv4_acl cipv4_acl;
+
+/**
+ * @details Compiled first-match ACL.
+ *
+ * The lookup table is a 16-8-8 multibit trie. Every entry is either
+ * rule index + 1 (0 means no rule matched) or, when CIPV4_ACL_CHUNK
+ * is set, the number of a 256-entry chunk of the next level.
+ */
+struct _cipv4_acl{
+    uint32_t * tbl16;         ///< first level, indexed by the top 16 bits
+    uint32_t * chunks;        ///< second and third level chunks (256 entries each)
+    uint32_t nchunks;         ///< number of allocated chunks
+    int * actions;            ///< action of each rule
+    uint32_t nrules;          ///< number of rules
+    int default_action;       ///< action returned when no rule matches
+    cipv4_acl_range * ranges; ///< disjoint ranges covering the whole address space
+    uint32_t nranges;         ///< number of ranges
+    uint32_t * shadowed;      ///< indexes of the rules which never match
+    uint32_t nshadowed;       ///< number of shadowed rules
+};
+
+
+cipv4_acl * cipv4_acl_compile(const cipv4_acl_rule * rules, uint32_t nrules, int default_action);
+cipv4_acl * cipv4_acl_compile_lpm(const cipv4_acl_rule * rules, uint32_t nrules, int default_action);
+void cipv4_acl_free(cipv4_acl * acl);
+int cipv4_acl_match(const cipv4_acl * acl, uint32_t addr);
+int cipv4_acl_lookup(const cipv4_acl * acl, uint32_t addr);
+void cipv4_acl_memory(const cipv4_acl * acl, unsigned long int * bytes);
+
+#endif
@@ -0,0 +1,42 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _CIPV4_ANON_H_
+#define _CIPV4_ANON_H_
+
+
+#define CIPV4_ANON_KEY_LENGTH 32
+#define CIPV4_ANON_CACHE_BITS 16
+
+/**
+* @details Type definition of the struct _cipv4_anon
+*
+* cipv4_anon: keyed prefix-preserving anonymizer created by cipv4_anon_new()
+*/
+typedef struct _cipv4_anon cipv4_anon;
+
+/**
+ * @details Crypto-PAn state: the AES-128 round keys, the secret pad and
+ * the one-time-pad bits of every /16 (they only depend on the top 16
+ * bits of the address, so they are computed once by cipv4_anon_new()).
+ */
+struct _cipv4_anon{
+    uint32_t rk[44];                    ///< AES-128 round keys (big-endian words)
+    uint8_t rk_bytes[176];              ///< the same round keys in byte order (AES-NI)
+    uint8_t pad[16];                    ///< AES(second half of the key)
+    uint32_t pad32;                     ///< first 4 bytes of the pad
+    uint32_t te[256];                   ///< AES T-table of the software path
+    uint8_t sbox[256];                  ///< AES S-box of the software path
+    uint16_t cache[1 << CIPV4_ANON_CACHE_BITS]; ///< pad bits 0~15 of every /16
+    int aesni;                          ///< 1 if AES-NI instructions are used
+};
+
+
+cipv4_anon * cipv4_anon_new(const uint8_t * key);
+void cipv4_anon_free(cipv4_anon * anon);
+uint32_t cipv4_anon_addr(const cipv4_anon * anon, uint32_t addr);
+void cipv4_anon_batch(const cipv4_anon * anon, const uint32_t * addrs, uint32_t * out, size_t n);
+void cipv4_anon_encrypt_block(const cipv4_anon * anon, const uint8_t * in, uint8_t * out);
+
+#endif
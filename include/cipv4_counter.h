@@ -0,0 +1,73 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifndef _CIPV4_COUNTER_H_
+#define _CIPV4_COUNTER_H_
+
+
+#define CIPV4_CACHE_LINE 64
+
+/**
+* @details Type definition of the struct _cipv4_counter_shard
+*
+* cipv4_counter_shard: counters owned by one thread
+*/
+typedef struct _cipv4_counter_shard cipv4_counter_shard;
+
+/**
+ * @details Counters of one thread. Only the owner thread writes to it,
+ * the counts array starts and ends on a cache line boundary so two
+ * shards never share a cache line.
+ */
+struct _cipv4_counter_shard{
+    _Atomic uint64_t * counts;  ///< hits of every key (plain load + store, no RMW)
+    uint32_t nkeys;             ///< number of keys
+};
+
+/**
+* @details Type definition of the struct _cipv4_counter
+*
+* cipv4_counter: per-key hit counters created by cipv4_counter_new()
+*/
+typedef struct _cipv4_counter cipv4_counter;
+
+/**
+ * @details Hit counters for keys 0~nkeys-1, e.g. the rule index
+ * returned by cipv4_acl_match().
+ */
+struct _cipv4_counter{
+    cipv4_counter_shard * shards; ///< one shard per thread
+    int nshards;                  ///< number of shards
+    uint32_t nkeys;               ///< number of keys
+    uint64_t * last;              ///< totals of the previous snapshot (start of the window)
+};
+
+/**
+* @details Type definition of the struct _cipv4_counter_totals
+*
+* cipv4_counter_totals: merged counters returned by cipv4_counter_snapshot()
+*/
+typedef struct _cipv4_counter_totals cipv4_counter_totals;
+
+/**
+ * @details Counters of all the shards merged together.
+ */
+struct _cipv4_counter_totals{
+    uint32_t nkeys;             ///< number of keys
+    uint64_t * total;           ///< hits of every key since cipv4_counter_new()
+    uint64_t * window;          ///< hits of every key since the previous snapshot
+};
+
+
+cipv4_counter * cipv4_counter_new(uint32_t nkeys, int nshards);
+void cipv4_counter_free(cipv4_counter * counter);
+cipv4_counter_shard * cipv4_counter_get_shard(cipv4_counter * counter, int shard);
+void cipv4_counter_add(cipv4_counter_shard * shard, int key, uint64_t count);
+void cipv4_counter_add_batch(cipv4_counter_shard * shard, const int * keys, size_t n);
+cipv4_counter_totals * cipv4_counter_snapshot(cipv4_counter * counter);
+void cipv4_counter_totals_free(cipv4_counter_totals * totals);
+uint32_t cipv4_counter_top(const cipv4_counter_totals * totals, uint32_t n, int by_window, uint32_t * keys);
+
+#endif
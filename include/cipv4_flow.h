@@ -0,0 +1,32 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4.h>
+#include <cipv4_acl.h>
+
+#ifndef _CIPV4_FLOW_H_
+#define _CIPV4_FLOW_H_
+
+
+/*
+ * Class bits returned by cipv4_flow_class() and cipv4_flow_classify(),
+ * same answers as the cipv4_is_*() functions for a single address.
+ */
+#define CIPV4_CLASS_PRIVATE         0x01
+#define CIPV4_CLASS_PUBLIC_NETWORK  0x02
+#define CIPV4_CLASS_GLOBAL          0x04
+#define CIPV4_CLASS_LOOPBACK        0x08
+#define CIPV4_CLASS_MULTICAST       0x10
+#define CIPV4_CLASS_UNSPECIFIED     0x20
+#define CIPV4_CLASS_LINKLOCAL       0x40
+#define CIPV4_CLASS_RESERVED        0x80
+
+#define CIPV4_FLOW_BLOCK 8
+
+
+uint8_t cipv4_flow_class(uint32_t addr);
+int cipv4_flow_ranges(uint8_t classes, cipv4_net * nets, int max);
+int cipv4_flow_classify(const void * base, size_t stride, size_t n, const cipv4_acl * acl,
+                        uint32_t * addrs, uint8_t * classes, int * rules);
+
+#endif
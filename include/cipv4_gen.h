@@ -0,0 +1,76 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4.h>
+
+#ifndef _CIPV4_GEN_H_
+#define _CIPV4_GEN_H_
+
+
+#define CIPV4_GEN_UNIFORM 0
+#define CIPV4_GEN_ZIPF 1
+#define CIPV4_GEN_MAX_LINE 17       // longest text record including the newline
+
+/**
+ * @details Malformed strings made by cipv4_gen_malformed(), one for every
+ * rejection path of cipv4_is_ip_valid().
+ */
+enum cipv4_gen_malformed{
+    CIPV4_GEN_BAD_SHORT,        ///< shorter than 7 characters ("1.2..3")
+    CIPV4_GEN_BAD_DOTS,         ///< not 3 dots ("1.2.3.4.5")
+    CIPV4_GEN_BAD_LONG,         ///< longer than 15 characters ("1000.100.100.100")
+    CIPV4_GEN_BAD_CHAR,         ///< a character which is not a digit ("10.2x.3.4")
+    CIPV4_GEN_BAD_ZERO,         ///< a part with a leading zero ("10.02.3.4")
+    CIPV4_GEN_BAD_EMPTY,        ///< an empty part ("10..3.4")
+    CIPV4_GEN_BAD_RANGE,        ///< a part above 255 ("10.256.3.4")
+    CIPV4_GEN_BAD_KINDS
+};
+
+/**
+* @details Type definition of the struct _cipv4_gen_config
+*
+* cipv4_gen_config: options of cipv4_gen_new()
+*/
+typedef struct _cipv4_gen_config cipv4_gen_config;
+
+/**
+ * @details Options of a generator, cipv4_gen_config_init() sets the defaults.
+ */
+struct _cipv4_gen_config{
+    int distribution;           ///< CIPV4_GEN_UNIFORM (every address of the set) or CIPV4_GEN_ZIPF (by network)
+    double zipf_s;              ///< Zipf exponent, the network at index k has weight 1/(k+1)^s
+    uint8_t exclude;            ///< CIPV4_CLASS_* bits of the special ranges which are never generated
+    double malformed_rate;      ///< fraction of malformed records in the text output (0~1)
+    uint64_t seed;              ///< the same seed gives the same stream
+    int nthreads;               ///< threads used to fill the output
+};
+
+/**
+* @details Type definition of the struct _cipv4_gen
+*
+* cipv4_gen: address stream generator created by cipv4_gen_new()
+*/
+typedef struct _cipv4_gen cipv4_gen;
+
+/**
+ * @details The input networks minus the excluded ranges, split into
+ * disjoint pieces, and an alias table to draw a piece in O(1).
+ */
+struct _cipv4_gen{
+    cipv4_gen_config config;    ///< copy of the options
+    cipv4_net * pieces;         ///< networks addresses are drawn from
+    uint32_t npieces;           ///< number of pieces
+    uint64_t * threshold;       ///< alias method: keep the piece if a 32-bit draw is below
+    uint32_t * alias;           ///< alias method: otherwise take this piece
+    uint64_t key;               ///< mixed seed
+};
+
+
+void cipv4_gen_config_init(cipv4_gen_config * config);
+cipv4_gen * cipv4_gen_new(const cipv4_net * nets, uint32_t n, const cipv4_gen_config * config);
+void cipv4_gen_free(cipv4_gen * gen);
+int cipv4_gen_addrs(const cipv4_gen * gen, uint64_t first, uint32_t * out, size_t n);
+long int cipv4_gen_text(const cipv4_gen * gen, uint64_t first, size_t n, char * buffer);
+char * cipv4_gen_malformed(int kind, uint64_t random, char * buffer);
+
+#endif
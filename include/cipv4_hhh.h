@@ -0,0 +1,77 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _CIPV4_HHH_H_
+#define _CIPV4_HHH_H_
+
+
+#define CIPV4_HHH_MAX_LEVELS 33
+
+/**
+* @details Type definition of the struct _cipv4_hhh_level
+*
+* cipv4_hhh_level: frequent prefixes of one prefix len
+*/
+typedef struct _cipv4_hhh_level cipv4_hhh_level;
+
+/**
+ * @details Misra-Gries summary of the prefixes of one length. The
+ * counters are indexed by an open addressing hash table.
+ */
+struct _cipv4_hhh_level{
+    uint8_t network_prefix;     ///< prefix len of this level
+    uint32_t used;              ///< number of used counters
+    uint32_t * keys;            ///< network address of every counter
+    uint64_t * counts;          ///< count of every counter (lower bound)
+    int32_t * slots;            ///< hash table, counter index or -1
+    uint64_t total;             ///< number of addresses counted at this level
+};
+
+/**
+* @details Type definition of the struct _cipv4_hhh
+*
+* cipv4_hhh: hierarchical heavy hitter sketch created by cipv4_hhh_new()
+*/
+typedef struct _cipv4_hhh cipv4_hhh;
+
+/**
+ * @details Hierarchical heavy hitter sketch with a fixed amount of memory.
+ */
+struct _cipv4_hhh{
+    cipv4_hhh_level levels[CIPV4_HHH_MAX_LEVELS]; ///< from the shortest to the longest prefix
+    int nlevels;                ///< number of levels
+    uint32_t capacity;          ///< counters per level
+    uint32_t table_bits;        ///< log2 of the hash table size
+    int sampled;                ///< 1 if only one random level is updated per address
+    uint64_t rng;               ///< state of the level sampler
+    uint64_t total;             ///< number of addresses seen
+};
+
+/**
+* @details Type definition of the struct _cipv4_hhh_item
+*
+* cipv4_hhh_item: one heavy hitter returned by cipv4_hhh_query()
+*/
+typedef struct _cipv4_hhh_item cipv4_hhh_item;
+
+/**
+ * @details A heavy hitter prefix. The real count of the prefix is
+ * between count and count + error.
+ */
+struct _cipv4_hhh_item{
+    uint32_t addr;              ///< network address
+    uint8_t network_prefix;     ///< prefix len
+    uint64_t count;             ///< estimated number of addresses in the prefix
+    uint64_t conditioned;       ///< count minus the counts of reported sub-prefixes
+    uint64_t error;             ///< maximum error of the estimate
+};
+
+
+cipv4_hhh * cipv4_hhh_new(uint8_t min_prefix, uint8_t step, uint32_t capacity, int sampled);
+void cipv4_hhh_free(cipv4_hhh * hhh);
+void cipv4_hhh_update(cipv4_hhh * hhh, uint32_t addr);
+void cipv4_hhh_update_batch(cipv4_hhh * hhh, const uint32_t * addrs, size_t n);
+uint32_t cipv4_hhh_query(const cipv4_hhh * hhh, double phi, cipv4_hhh_item * items, uint32_t max_items);
+
+#endif
@@ -0,0 +1,63 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4.h>
+
+#ifndef _CIPV4_HIST_H_
+#define _CIPV4_HIST_H_
+
+
+#define CIPV4_HIST_MAX_PREFIX 24    // 16.7M buckets
+#define CIPV4_HIST_MAX_THREADS 64
+
+/**
+* @details Type definition of the struct _cipv4_hist_shard
+*
+* cipv4_hist_shard: buckets owned by one thread
+*/
+typedef struct _cipv4_hist_shard cipv4_hist_shard;
+
+/**
+ * @details Dense buckets of one thread, bucket k is the network
+ * k << (32 - network_prefix). Only the owner thread writes to it.
+ */
+struct _cipv4_hist_shard{
+    uint64_t * counts;          ///< addresses seen in every bucket, lanes arrays of nbuckets
+    uint32_t shift;             ///< 32 - network_prefix
+    uint32_t lanes;             ///< copies of the buckets, summed by cipv4_hist_merge()
+};
+
+/**
+* @details Type definition of the struct _cipv4_hist
+*
+* cipv4_hist: address histogram created by cipv4_hist_new()
+*/
+typedef struct _cipv4_hist cipv4_hist;
+
+/**
+ * @details Histogram of addresses by /network_prefix. The shards are
+ * summed into total by cipv4_hist_merge().
+ */
+struct _cipv4_hist{
+    uint8_t network_prefix;     ///< size of the buckets (1~CIPV4_HIST_MAX_PREFIX)
+    uint32_t nbuckets;          ///< 2^network_prefix
+    cipv4_hist_shard * shards;  ///< one shard per thread
+    int nshards;                ///< number of shards
+    uint64_t * total;           ///< all the shards, valid after cipv4_hist_merge()
+    uint64_t hits;              ///< sum of total
+    uint32_t nonzero;           ///< buckets of total which are not 0
+};
+
+
+cipv4_hist * cipv4_hist_new(uint8_t network_prefix, int nshards);
+void cipv4_hist_free(cipv4_hist * hist);
+cipv4_hist_shard * cipv4_hist_get_shard(cipv4_hist * hist, int shard);
+void cipv4_hist_add(cipv4_hist_shard * shard, uint32_t addr, uint64_t count);
+void cipv4_hist_add_batch(cipv4_hist_shard * shard, const uint32_t * addrs, size_t n);
+int cipv4_hist_count(cipv4_hist * hist, const uint32_t * addrs, size_t n);
+int cipv4_hist_merge(cipv4_hist * hist, int nthreads);
+void cipv4_hist_clear(cipv4_hist * hist);
+uint32_t cipv4_hist_top(const cipv4_hist * hist, uint32_t k, cipv4_net * nets, uint64_t * counts);
+uint32_t cipv4_hist_export(const cipv4_hist * hist, uint32_t first, cipv4_net * nets, uint64_t * counts, uint32_t max);
+
+#endif
@@ -0,0 +1,51 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4.h>
+
+#ifndef _CIPV4_INGEST_H_
+#define _CIPV4_INGEST_H_
+
+
+/*
+ * Notations recognized by cipv4_ingest_record(), index of
+ * cipv4_ingest::forms.
+ */
+#define CIPV4_INGEST_CIDR 0         // 10.0.0.0/8
+#define CIPV4_INGEST_NETMASK 1      // 10.0.0.0/255.0.0.0
+#define CIPV4_INGEST_HOSTMASK 2     // 10.0.0.0/0.255.255.255
+#define CIPV4_INGEST_ADDRESS 3      // 10.0.0.1 (a /32)
+#define CIPV4_INGEST_RANGE 4        // 10.0.0.0-10.0.2.255
+#define CIPV4_INGEST_FORMS 5
+
+#define CIPV4_INGEST_MAX_NETS 62    // most networks of one range
+
+/**
+* @details Type definition of the struct _cipv4_ingest
+*
+* cipv4_ingest: networks loaded by cipv4_ingest_buffer() and cipv4_ingest_file()
+*/
+typedef struct _cipv4_ingest cipv4_ingest;
+
+/**
+ * @details Networks of every valid record, in input order, and what was
+ * found in the input.
+ */
+struct _cipv4_ingest{
+    cipv4_net * nets;                   ///< the networks (host bits are 0)
+    size_t count;                       ///< number of networks
+    size_t capacity;                    ///< allocated elements of nets
+    uint64_t lines;                     ///< lines read (including blank and comment lines)
+    uint64_t errors;                    ///< lines which are not a valid record
+    uint64_t first_error;               ///< line number of the first error (1-based, 0 if none)
+    uint64_t forms[CIPV4_INGEST_FORMS]; ///< records of every notation
+};
+
+
+cipv4_ingest * cipv4_ingest_new(void);
+void cipv4_ingest_free(cipv4_ingest * ingest);
+int cipv4_ingest_record(const char * text, size_t len, cipv4_net * out, int * form);
+long int cipv4_ingest_buffer(cipv4_ingest * ingest, const char * buffer, size_t size);
+long int cipv4_ingest_file(cipv4_ingest * ingest, const char * path);
+
+#endif
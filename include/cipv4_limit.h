@@ -0,0 +1,81 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <cipv4_acl.h>
+
+#ifndef _CIPV4_LIMIT_H_
+#define _CIPV4_LIMIT_H_
+
+
+#define CIPV4_LIMIT_DENY 0
+#define CIPV4_LIMIT_ADMIT 1
+#define CIPV4_LIMIT_PROBES 16       // slots visited to find or place a bucket
+
+/**
+* @details Type definition of the struct _cipv4_limit_config
+*
+* cipv4_limit_config: options of cipv4_limit_new()
+*/
+typedef struct _cipv4_limit_config cipv4_limit_config;
+
+/**
+ * @details Options of a rate limiter, cipv4_limit_config_init() sets the defaults.
+ */
+struct _cipv4_limit_config{
+    double rate;                ///< tokens added per second to every bucket
+    double burst;               ///< size of a bucket (at least 1)
+    const cipv4_acl * acl;      ///< bucket of the matching rule (cipv4_acl_compile_lpm()), NULL for none
+    uint8_t network_prefix;     ///< bucket of the /network_prefix of the address when no rule matches (0~32)
+    uint32_t capacity;          ///< most buckets in memory (rounded up to a power of 2)
+    int overflow_action;        ///< CIPV4_LIMIT_ADMIT or CIPV4_LIMIT_DENY when no bucket can be placed
+};
+
+/**
+* @details Type definition of the struct _cipv4_limit_slot
+*
+* cipv4_limit_slot: one bucket of the hash table
+*/
+typedef struct _cipv4_limit_slot cipv4_limit_slot;
+
+/**
+ * @details A bucket: its key and its whole token bucket state in one
+ * 64-bit word, the time at which it will be full again (GCRA).
+ */
+struct _cipv4_limit_slot{
+    _Atomic uint64_t key;       ///< bucket key, 0 for an empty slot and 1 for an evicted one
+    _Atomic uint64_t tat;       ///< theoretical arrival time in ns, any value <= now is a full bucket
+};
+
+/**
+* @details Type definition of the struct _cipv4_limit
+*
+* cipv4_limit: rate limiter created by cipv4_limit_new()
+*/
+typedef struct _cipv4_limit cipv4_limit;
+
+/**
+ * @details Fixed-size open addressing table of buckets, updated without
+ * locks by any number of threads.
+ */
+struct _cipv4_limit{
+    cipv4_limit_config config;  ///< copy of the options
+    uint64_t interval;          ///< ns per token
+    uint64_t tolerance;         ///< ns of credit of a full bucket (burst * interval)
+    cipv4_limit_slot * slots;   ///< the buckets
+    uint32_t mask;              ///< number of slots - 1
+    _Atomic uint64_t evictions; ///< idle buckets removed
+    _Atomic uint64_t overflows; ///< requests which found no room for their bucket
+};
+
+
+void cipv4_limit_config_init(cipv4_limit_config * config);
+cipv4_limit * cipv4_limit_new(const cipv4_limit_config * config);
+void cipv4_limit_free(cipv4_limit * limit);
+uint64_t cipv4_limit_now(void);
+int cipv4_limit_take(cipv4_limit * limit, uint32_t addr, uint32_t cost, uint64_t now);
+long int cipv4_limit_admit(cipv4_limit * limit, const uint32_t * addrs, size_t n, uint64_t now, uint8_t * admitted);
+double cipv4_limit_tokens(cipv4_limit * limit, uint32_t addr, uint64_t now);
+uint64_t cipv4_limit_evict(cipv4_limit * limit, uint64_t now);
+
+#endif
@@ -0,0 +1,30 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4.h>
+
+#ifndef _CIPV4_NET_H_
+#define _CIPV4_NET_H_
+
+
+/*
+ * Relations of cipv4_net_match_any(), same meaning as the single pair
+ * functions (a is the network tested, b the other one).
+ */
+#define CIPV4_NET_OVERLAPS 0
+#define CIPV4_NET_SUBNET_OF 1
+#define CIPV4_NET_SUPERNET_OF 2
+
+#define CIPV4_NET_MAX_EXCLUDE 32    // most networks returned by cipv4_net_exclude()
+
+
+int cipv4_net_overlaps(const cipv4_net * a, const cipv4_net * b);
+int cipv4_net_subnet_of(const cipv4_net * a, const cipv4_net * b);
+int cipv4_net_supernet_of(const cipv4_net * a, const cipv4_net * b);
+int cipv4_net_exclude(const cipv4_net * net, const cipv4_net * hole, cipv4_net * out);
+long int cipv4_net_match_any(const cipv4_net * a, size_t n, const cipv4_net * b, size_t m,
+                             int relation, uint8_t * flags);
+long int cipv4_net_overlaps_within(const cipv4_net * nets, size_t n, uint8_t * flags);
+long int cipv4_net_outermost(const cipv4_net * nets, size_t n, cipv4_net * out);
+
+#endif
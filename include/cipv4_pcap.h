@@ -0,0 +1,69 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4_acl.h>
+
+#ifndef _CIPV4_PCAP_H_
+#define _CIPV4_PCAP_H_
+
+
+#define CIPV4_PCAP_LINKTYPE_NULL 0
+#define CIPV4_PCAP_LINKTYPE_ETHERNET 1
+#define CIPV4_PCAP_LINKTYPE_RAW 101
+#define CIPV4_PCAP_LINKTYPE_LINUX_SLL 113
+#define CIPV4_PCAP_LINKTYPE_IPV4 228
+#define CIPV4_PCAP_SRC 0
+#define CIPV4_PCAP_DST 1
+#define CIPV4_PCAP_CLASSES 8
+
+/**
+* @details Type definition of the struct _cipv4_pcap
+*
+* cipv4_pcap: classic pcap file mapped by cipv4_pcap_open()
+*/
+typedef struct _cipv4_pcap cipv4_pcap;
+
+/**
+ * @details A read-only mapping of a classic (libpcap) capture file.
+ */
+struct _cipv4_pcap{
+    const unsigned char * data; ///< the whole file
+    size_t size;                ///< size of the file
+    int swapped;                ///< 1 if the headers are in the other byte order
+    int nanosecond;             ///< 1 for nanosecond timestamps
+    uint32_t snaplen;           ///< maximum captured length of a packet
+    uint32_t linktype;          ///< CIPV4_PCAP_LINKTYPE_*
+};
+
+/**
+* @details Type definition of the struct _cipv4_pcap_totals
+*
+* cipv4_pcap_totals: counters returned by cipv4_pcap_analyze()
+*/
+typedef struct _cipv4_pcap_totals cipv4_pcap_totals;
+
+/**
+ * @details Packet and byte totals of a capture. Bytes are the original
+ * length of the packets on the wire. The [2] arrays are indexed by
+ * CIPV4_PCAP_SRC and CIPV4_PCAP_DST, classes by the bit number of the
+ * CIPV4_CLASS_* flags.
+ */
+struct _cipv4_pcap_totals{
+    uint64_t packets;           ///< all the records
+    uint64_t bytes;             ///< bytes of all the records
+    uint64_t ipv4_packets;      ///< records with an IPv4 header
+    uint64_t ipv4_bytes;        ///< bytes of the IPv4 records
+    uint32_t nrules;            ///< number of rules of the ACL
+    uint64_t * rule_packets[2]; ///< IPv4 packets by matching rule, index nrules counts the unmatched
+    uint64_t * rule_bytes[2];   ///< IPv4 bytes by matching rule, index nrules counts the unmatched
+    uint64_t class_packets[2][CIPV4_PCAP_CLASSES]; ///< IPv4 packets by class
+    uint64_t class_bytes[2][CIPV4_PCAP_CLASSES];   ///< IPv4 bytes by class
+};
+
+
+cipv4_pcap * cipv4_pcap_open(const char * path);
+void cipv4_pcap_close(cipv4_pcap * pcap);
+cipv4_pcap_totals * cipv4_pcap_analyze(const cipv4_pcap * pcap, const cipv4_acl * acl, int nthreads);
+void cipv4_pcap_totals_free(cipv4_pcap_totals * totals);
+
+#endif
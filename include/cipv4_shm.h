@@ -0,0 +1,41 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <cipv4_acl.h>
+
+#ifndef _CIPV4_SHM_H_
+#define _CIPV4_SHM_H_
+
+
+#define CIPV4_SHM_MAGIC 0x43495056344143ULL     // "CIPV4AC"
+#define CIPV4_SHM_VERSION 1
+#define CIPV4_SHM_NAME_LENGTH 200
+
+/**
+* @details Type definition of the struct _cipv4_shm_reader
+*
+* cipv4_shm_reader: read-only mapping of a published table
+*/
+typedef struct _cipv4_shm_reader cipv4_shm_reader;
+
+/**
+ * @details A worker's view of a table published by cipv4_shm_publish().
+ * acl points into the shared mapping, nothing is copied.
+ */
+struct _cipv4_shm_reader{
+    char name[CIPV4_SHM_NAME_LENGTH];   ///< name of the table
+    void * control;                     ///< mapping of the control segment (generation)
+    void * data;                        ///< mapping of the current table
+    size_t data_size;                   ///< size of the mapping
+    uint64_t generation;                ///< generation of the mapped table
+    cipv4_acl acl;                      ///< compiled ACL backed by the mapping
+};
+
+
+int64_t cipv4_shm_publish(const char * name, const cipv4_acl * acl);
+int cipv4_shm_unlink(const char * name);
+cipv4_shm_reader * cipv4_shm_open(const char * name);
+int cipv4_shm_refresh(cipv4_shm_reader * reader);
+void cipv4_shm_close(cipv4_shm_reader * reader);
+
+#endif
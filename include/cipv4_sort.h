@@ -0,0 +1,15 @@
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _CIPV4_SORT_H_
+#define _CIPV4_SORT_H_
+
+
+int cipv4_sort(uint32_t * addrs, size_t n);
+int cipv4_sort_parallel(uint32_t * addrs, size_t n, int nthreads);
+size_t cipv4_dedup(uint32_t * addrs, size_t n);
+size_t cipv4_count_distinct(const uint32_t * addrs, size_t n, uint8_t network_prefix);
+void cipv4_count_distinct_all(const uint32_t * addrs, size_t n, size_t * counts);
+
+#endif
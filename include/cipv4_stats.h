@@ -0,0 +1,136 @@
+/** @file */
+#include <stdint.h>
+#include <stdatomic.h>
+
+#ifndef _CIPV4_STATS_H_
+#define _CIPV4_STATS_H_
+
+
+#define CIPV4_STATS_LATENCY_BUCKETS 32
+#define CIPV4_STATS_TABLE_LEVELS 3
+
+/**
+ * @details Classifier functions counted by the statistics.
+ */
+enum cipv4_stats_classifier{
+    CIPV4_STATS_IS_PRIVATE,
+    CIPV4_STATS_IS_PRIVATE_FROM_STRING,
+    CIPV4_STATS_IS_PUBLIC_NETWORK,
+    CIPV4_STATS_IS_PUBLIC_NETWORK_FROM_STRING,
+    CIPV4_STATS_IS_GLOBAL,
+    CIPV4_STATS_IS_GLOBAL_FROM_STRING,
+    CIPV4_STATS_IS_LOOPBACK,
+    CIPV4_STATS_IS_LOOPBACK_FROM_STRING,
+    CIPV4_STATS_IS_MULTICAST,
+    CIPV4_STATS_IS_MULTICAST_FROM_STRING,
+    CIPV4_STATS_IS_UNSPECIFIED,
+    CIPV4_STATS_IS_UNSPECIFIED_FROM_STRING,
+    CIPV4_STATS_IS_LINKLOCAL,
+    CIPV4_STATS_IS_LINKLOCAL_FROM_STRING,
+    CIPV4_STATS_IS_RESERVED,
+    CIPV4_STATS_IS_RESERVED_FROM_STRING,
+    CIPV4_STATS_CLASSIFIERS
+};
+
+/**
+ * @details Operations with a latency histogram.
+ */
+enum cipv4_stats_operation{
+    CIPV4_STATS_PARSE,          ///< cipv4_parse_ip() and cipv4_parse_ip_arena()
+    CIPV4_STATS_ACL_MATCH,      ///< cipv4_acl_match() and cipv4_acl_lookup()
+    CIPV4_STATS_OPERATIONS
+};
+
+/**
+* @details Type definition of the struct _cipv4_stats
+*
+* cipv4_stats: counters returned by cipv4_stats_snapshot()
+*/
+typedef struct _cipv4_stats cipv4_stats;
+
+/**
+ * @details Sum of the counters of all the threads.
+ */
+struct _cipv4_stats{
+    uint64_t parse_ok;                              ///< successful parses (ctx->error == 0)
+    uint64_t parse_error[4];                        ///< by ctx->error, index 0 counts NULL results
+    uint64_t classifier_calls[CIPV4_STATS_CLASSIFIERS]; ///< calls of every classifier
+    uint64_t lookup_depth[CIPV4_STATS_TABLE_LEVELS];    ///< ACL lookups ending at level 1, 2 and 3
+    uint64_t table_bytes[CIPV4_STATS_TABLE_LEVELS];     ///< memory of the live ACL tables by level
+    uint64_t latency[CIPV4_STATS_OPERATIONS][CIPV4_STATS_LATENCY_BUCKETS]; ///< sampled latencies, bucket i counts [2^i, 2^(i+1)) ns
+};
+
+
+int cipv4_stats_enabled(void);
+int cipv4_stats_snapshot(cipv4_stats * stats);
+void cipv4_stats_set_sampling(uint32_t every);
+
+/*
+ * Instrumentation used inside the library. Everything below expands to
+ * nothing unless the library is compiled with -DCIPV4_STATS (make STATS=1).
+ */
+#ifdef CIPV4_STATS
+
+typedef struct _cipv4_stats_block cipv4_stats_block;
+struct _cipv4_stats_block{
+    _Atomic uint64_t parse_ok;
+    _Atomic uint64_t parse_error[4];
+    _Atomic uint64_t classifier_calls[CIPV4_STATS_CLASSIFIERS];
+    _Atomic uint64_t lookup_depth[CIPV4_STATS_TABLE_LEVELS];
+    _Atomic uint64_t latency[CIPV4_STATS_OPERATIONS][CIPV4_STATS_LATENCY_BUCKETS];
+    uint32_t tick;
+    int shared;                 // the fallback block, updated by several threads
+    cipv4_stats_block * next;
+};
+
+extern _Thread_local cipv4_stats_block * _cipv4_stats_tls;
+extern _Atomic uint32_t _cipv4_stats_sample_every;
+cipv4_stats_block * _cipv4_stats_register(void);
+uint64_t _cipv4_stats_now(void);
+void _cipv4_stats_latency(int operation, uint64_t start);
+void _cipv4_stats_table(int level, int64_t bytes);
+
+// only the owner thread writes its block: relaxed load + store, no RMW,
+// except for the shared fallback block
+#define _CIPV4_STATS_ADD(block, field, n) do{                                                  \
+    cipv4_stats_block * _cipv4_b = (block);                                                   \
+    if (_cipv4_b->shared)                                                                      \
+        atomic_fetch_add_explicit(&_cipv4_b->field, (n), memory_order_relaxed);                \
+    else                                                                                       \
+        atomic_store_explicit(&_cipv4_b->field,                                                \
+            atomic_load_explicit(&_cipv4_b->field, memory_order_relaxed) + (n), memory_order_relaxed); \
+}while(0)
+#define _CIPV4_STATS_BLOCK() (_cipv4_stats_tls ? _cipv4_stats_tls : _cipv4_stats_register())
+
+// returns a timestamp for one call out of every `every` calls, 0 otherwise
+static inline uint64_t _cipv4_stats_sample_start(void){
+    uint32_t every = atomic_load_explicit(&_cipv4_stats_sample_every, memory_order_relaxed);
+    if (!every)
+        return 0;
+    cipv4_stats_block * b = _CIPV4_STATS_BLOCK();
+    if (b->shared)      // no latency samples without a block of our own
+        return 0;
+    return ++b->tick % every == 0 ? _cipv4_stats_now() : 0;
+}
+
+#define CIPV4_STATS_PARSE_OK() _CIPV4_STATS_ADD(_CIPV4_STATS_BLOCK(), parse_ok, 1)
+#define CIPV4_STATS_PARSE_ERROR(code) _CIPV4_STATS_ADD(_CIPV4_STATS_BLOCK(), parse_error[(code) & 3], 1)
+#define CIPV4_STATS_CLASSIFIER(which) _CIPV4_STATS_ADD(_CIPV4_STATS_BLOCK(), classifier_calls[which], 1)
+#define CIPV4_STATS_LOOKUP_DEPTH(depth) _CIPV4_STATS_ADD(_CIPV4_STATS_BLOCK(), lookup_depth[(depth) - 1], 1)
+#define CIPV4_STATS_TABLE(level, bytes) _cipv4_stats_table(level, bytes)
+#define CIPV4_STATS_SAMPLE_START() _cipv4_stats_sample_start()
+#define CIPV4_STATS_SAMPLE_END(operation, start) do{ if (start) _cipv4_stats_latency(operation, start); }while(0)
+
+#else
+
+#define CIPV4_STATS_PARSE_OK() ((void)0)
+#define CIPV4_STATS_PARSE_ERROR(code) ((void)0)
+#define CIPV4_STATS_CLASSIFIER(which) ((void)0)
+#define CIPV4_STATS_LOOKUP_DEPTH(depth) ((void)(depth))
+#define CIPV4_STATS_TABLE(level, bytes) ((void)0)
+#define CIPV4_STATS_SAMPLE_START() 0
+#define CIPV4_STATS_SAMPLE_END(operation, start) (void)(start)
+
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+"""
+Prefix lookup over test/example.db: the ipaddress loop of
+test/pytest_1.py against the batch functions of the cipv4 module.
+
+Usage: python3 bench.py [path-to-example.db] [count]
+"""
+import ipaddress
+import random
+import sys
+import time
+import cipv4
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "../test/example.db"
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 1000000
+    with open(path) as f:
+        lines = [line.strip() for line in f if line.strip()]
+    rng = random.Random(1)
+    text = "".join("%d.%d.%d.%d\n" % tuple(rng.randrange(256) for _ in range(4)) for _ in range(count)).encode()
+    sample = text.split(b"\n")[:20]
+
+    # pytest_1.py: every network of the database for every address
+    start = time.perf_counter()
+    networks = [ipaddress.ip_network(line) for line in lines]
+    load_ipaddress = time.perf_counter() - start
+    start = time.perf_counter()
+    for addr in sample:
+        ip = ipaddress.ip_address(addr.decode())
+        hits = [n for n in networks if ip in n]
+    per_ipaddress = (time.perf_counter() - start) / len(sample)
+
+    start = time.perf_counter()
+    table = cipv4.Table(lines)
+    load_cipv4 = time.perf_counter() - start
+    start = time.perf_counter()
+    addrs, valid = cipv4.parse(text)
+    parse = time.perf_counter() - start
+    start = time.perf_counter()
+    matches = table.lookup(addrs)
+    lookup = time.perf_counter() - start
+    start = time.perf_counter()
+    classes = cipv4.classify(addrs)
+    classify = time.perf_counter() - start
+    assert len(matches) == len(classes) == count and all(valid)
+    del hits
+
+    print("networks %d, addresses %d" % (len(lines), count))
+    print("%-28s %12s %14s" % ("", "load_s", "ns_per_addr"))
+    print("%-28s %12.3f %14.0f" % ("ipaddress (pytest_1.py)", load_ipaddress, per_ipaddress * 1e9))
+    print("%-28s %12.3f %14.1f" % ("cipv4.parse + Table.lookup", load_cipv4, (parse + lookup) * 1e9 / count))
+    print("%-28s %12s %14.1f" % ("  cipv4.parse", "", parse * 1e9 / count))
+    print("%-28s %12s %14.1f" % ("  cipv4.Table.lookup", "", lookup * 1e9 / count))
+    print("%-28s %12s %14.1f" % ("  cipv4.classify", "", classify * 1e9 / count))
+    print("speedup x%.0f" % (per_ipaddress * count / (parse + lookup)))
+
+
+if __name__ == "__main__":
+    main()
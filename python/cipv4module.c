@@ -0,0 +1,436 @@
+/// @file cipv4module.c
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+#include <cipv4.h>
+#include <cipv4_acl.h>
+#include <cipv4_flow.h>
+
+
+#define CIPV4_PY_MAX_FIELD 16       // longest address (15 characters) + null
+
+/*
+ * Batch functions over buffers: every input is read through the buffer
+ * protocol (bytes, bytearray, array.array, numpy arrays, mmap, ...) and
+ * every output is an array.array filled in place, so no Python object is
+ * created per address and the GIL is released while the batch runs.
+ */
+
+typedef struct _cipv4_py_table cipv4_py_table;
+struct _cipv4_py_table{
+    PyObject_HEAD
+    cipv4_acl * acl;
+    cipv4_acl_rule * rules;
+    uint32_t nrules;
+};
+
+static PyObject * cipv4_py_array_type = NULL;
+
+static PyObject * cipv4_py_new_array(const char * typecode, Py_ssize_t n, Py_buffer * view);
+static int cipv4_py_get_addrs(PyObject * obj, Py_buffer * view);
+static int cipv4_py_get_text(PyObject * obj, Py_buffer * view, PyObject ** packed);
+static void cipv4_py_parse_field(const char * field, Py_ssize_t len, uint32_t * addr, uint8_t * valid);
+
+
+/**
+ * @brief parse(data) -> (addrs, valid)
+ *
+ * data is either text with one address per line (bytes, bytearray,
+ * mmap, ...), a buffer of fixed-width strings (numpy dtype 'S') or a
+ * list of str/bytes. addrs is an array('I') of host-order integers and
+ * valid an array('B') with 1 where cipv4_is_ip_valid() accepts the
+ * record (addrs is 0 otherwise). Records are checked as they are: only
+ * the \n or \r\n line terminator of text and the null padding of
+ * fixed-width strings are removed, longer items are invalid.
+ */
+static PyObject * cipv4_py_parse(PyObject * self, PyObject * arg){
+    (void) self;
+    Py_buffer in;
+    PyObject * packed = NULL;
+    if (cipv4_py_get_text(arg, &in, &packed) != 0)
+        return NULL;
+    const char * data = (const char*) in.buf;
+    Py_ssize_t size = in.len;
+    Py_ssize_t width = in.ndim == 1 && in.itemsize > 1 ? in.itemsize : 0;
+    Py_ssize_t n = 0;
+    if (width)
+        n = size / width;
+    else{
+        for (Py_ssize_t i=0; i<size; ++i)
+            n += data[i] == '\n';
+        if (size > 0 && data[size - 1] != '\n')
+            n++;
+    }
+    Py_buffer addrs_view, valid_view;
+    PyObject * addrs = cipv4_py_new_array("I", n, &addrs_view);
+    PyObject * valid = addrs ? cipv4_py_new_array("B", n, &valid_view) : NULL;
+    if (!valid){
+        if (addrs){
+            PyBuffer_Release(&addrs_view);
+            Py_DECREF(addrs);
+        }
+        PyBuffer_Release(&in);
+        Py_XDECREF(packed);
+        return NULL;
+    }
+    uint32_t * out = (uint32_t*) addrs_view.buf;
+    uint8_t * ok = (uint8_t*) valid_view.buf;
+    Py_BEGIN_ALLOW_THREADS
+    if (width){
+        for (Py_ssize_t i=0; i<n; ++i){
+            const char * field = data + i * width;
+            const char * end = memchr(field, '\0', width);
+            cipv4_py_parse_field(field, end ? end - field : width, &out[i], &ok[i]);
+        }
+    }
+    else{
+        const char * p = data;
+        const char * end = data + size;
+        for (Py_ssize_t i=0; i<n; ++i){
+            const char * eol = memchr(p, '\n', end - p);
+            if (!eol)
+                eol = end;
+            Py_ssize_t len = eol - p;
+            if (eol < end && len > 0 && p[len - 1] == '\r')
+                len--;          // \r\n line terminator
+            cipv4_py_parse_field(p, len, &out[i], &ok[i]);
+            p = eol + 1;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&addrs_view);
+    PyBuffer_Release(&valid_view);
+    PyBuffer_Release(&in);
+    Py_XDECREF(packed);
+    PyObject * result = PyTuple_Pack(2, addrs, valid);
+    Py_DECREF(addrs);
+    Py_DECREF(valid);
+    return result;
+}
+
+/**
+ * @brief classify(addrs) -> array('B')
+ *
+ * CIPV4_CLASS_* bits (see cipv4_flow.h) of every host-order address of
+ * a uint32 buffer, as cipv4_flow_class().
+ */
+static PyObject * cipv4_py_classify(PyObject * self, PyObject * arg){
+    (void) self;
+    Py_buffer in, out_view;
+    if (cipv4_py_get_addrs(arg, &in) != 0)
+        return NULL;
+    Py_ssize_t n = in.len / 4;
+    PyObject * classes = cipv4_py_new_array("B", n, &out_view);
+    if (!classes){
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+    const uint32_t * addrs = (const uint32_t*) in.buf;
+    uint8_t * out = (uint8_t*) out_view.buf;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i=0; i<n; ++i)
+        out[i] = cipv4_flow_class(addrs[i]);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&out_view);
+    PyBuffer_Release(&in);
+    return classes;
+}
+
+static int cipv4_py_table_init(cipv4_py_table * self, PyObject * args, PyObject * kwds){
+    static char * keywords[] = {"cidrs", "lpm", NULL};
+    PyObject * cidrs = NULL;
+    int lpm = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", keywords, &cidrs, &lpm))
+        return -1;
+    // lookups run without the GIL, the table can not change under them
+    if (self->acl){
+        PyErr_SetString(PyExc_RuntimeError, "table is already initialized");
+        return -1;
+    }
+    PyObject * seq = PySequence_Fast(cidrs, "cidrs must be an iterable of str or bytes");
+    if (!seq)
+        return -1;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    if (n > UINT32_MAX){
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "too many networks");
+        return -1;
+    }
+    cipv4_acl_rule * rules = (cipv4_acl_rule*) PyMem_Malloc((n ? n : 1) * sizeof(cipv4_acl_rule));
+    if (!rules){
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i=0; i<n; ++i){
+        PyObject * item = PySequence_Fast_GET_ITEM(seq, i);
+        const char * text = NULL;
+        if (PyUnicode_Check(item))
+            text = PyUnicode_AsUTF8(item);
+        else if (PyBytes_Check(item))
+            text = PyBytes_AS_STRING(item);
+        else
+            PyErr_SetString(PyExc_TypeError, "cidrs must be an iterable of str or bytes");
+        cipv4_ctx * ctx = text ? cipv4_parse_ip(text) : NULL;
+        if (!ctx || ctx->error != 0){
+            if (text)
+                PyErr_Format(PyExc_ValueError, "invalid network '%s'", text);
+            else if (!PyErr_Occurred())
+                PyErr_NoMemory();
+            cipv4_free(ctx);
+            PyMem_Free(rules);
+            Py_DECREF(seq);
+            return -1;
+        }
+        rules[i].addr = ctx->addr_start;
+        rules[i].network_prefix = ctx->network_prefix;
+        rules[i].action = CIPV4_ACL_PERMIT;
+        cipv4_free(ctx);
+    }
+    Py_DECREF(seq);
+    cipv4_acl * acl = lpm ? cipv4_acl_compile_lpm(rules, (uint32_t)n, CIPV4_ACL_DENY) :
+                            cipv4_acl_compile(rules, (uint32_t)n, CIPV4_ACL_DENY);
+    if (!acl){
+        PyMem_Free(rules);
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->acl = acl;
+    self->rules = rules;
+    self->nrules = (uint32_t)n;
+    return 0;
+}
+
+static void cipv4_py_table_dealloc(cipv4_py_table * self){
+    cipv4_acl_free(self->acl);
+    PyMem_Free(self->rules);
+    Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+/**
+ * @brief Table.lookup(addrs) -> array('i')
+ *
+ * Index of the matching network (the most specific one with lpm=True,
+ * the first one otherwise) of every host-order address of a uint32
+ * buffer, or -1.
+ */
+static PyObject * cipv4_py_table_lookup(cipv4_py_table * self, PyObject * arg){
+    Py_buffer in, out_view;
+    if (!self->acl){
+        PyErr_SetString(PyExc_ValueError, "table is not initialized");
+        return NULL;
+    }
+    if (cipv4_py_get_addrs(arg, &in) != 0)
+        return NULL;
+    Py_ssize_t n = in.len / 4;
+    PyObject * result = cipv4_py_new_array("i", n, &out_view);
+    if (!result){
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+    const uint32_t * addrs = (const uint32_t*) in.buf;
+    int * out = (int*) out_view.buf;
+    const cipv4_acl * acl = self->acl;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i=0; i<n; ++i)
+        out[i] = cipv4_acl_match(acl, addrs[i]);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&out_view);
+    PyBuffer_Release(&in);
+    return result;
+}
+
+static Py_ssize_t cipv4_py_table_length(cipv4_py_table * self){
+    return self->nrules;
+}
+
+static PyObject * cipv4_py_table_item(cipv4_py_table * self, Py_ssize_t i){
+    if (i < 0 || i >= (Py_ssize_t)self->nrules){
+        PyErr_SetString(PyExc_IndexError, "table index out of range");
+        return NULL;
+    }
+    char buffer[CIPV4_PY_MAX_FIELD] = {0};
+    cipv4_uint_to_str(self->rules[i].addr, buffer);
+    return PyUnicode_FromFormat("%s/%d", buffer, (int)self->rules[i].network_prefix);
+}
+
+
+// array.array(typecode, [0]) * n and a writable view of its memory
+static PyObject * cipv4_py_new_array(const char * typecode, Py_ssize_t n, Py_buffer * view){
+    PyObject * one = PyObject_CallFunction(cipv4_py_array_type, "s[i]", typecode, 0);
+    if (!one)
+        return NULL;
+    PyObject * array = PySequence_Repeat(one, n);
+    Py_DECREF(one);
+    if (!array)
+        return NULL;
+    if (PyObject_GetBuffer(array, view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0){
+        Py_DECREF(array);
+        return NULL;
+    }
+    return array;
+}
+
+// contiguous buffer of 4-byte integers (array('I'), numpy uint32, raw bytes)
+static int cipv4_py_get_addrs(PyObject * obj, Py_buffer * view){
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        return -1;
+    const char * format = view->format ? view->format : "B";
+    if (*format == '@' || *format == '=' || *format == '<' || *format == '>' || *format == '!')
+        format++;
+    int bytes = strcmp(format, "B") == 0 || strcmp(format, "b") == 0 || strcmp(format, "c") == 0;
+    int words = view->itemsize == 4 && strchr("IiLl", *format) && format[1] == '\0';
+    if ((!bytes && !words) || view->len % 4 != 0){
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_TypeError, "expected a buffer of uint32 values");
+        return -1;
+    }
+    return 0;
+}
+
+// text, fixed-width strings or a list packed into CIPV4_PY_MAX_FIELD columns
+static int cipv4_py_get_text(PyObject * obj, Py_buffer * view, PyObject ** packed){
+    *packed = NULL;
+    if (PyList_Check(obj) || PyTuple_Check(obj)){
+        Py_ssize_t n = PySequence_Fast_GET_SIZE(obj);
+        *packed = PyBytes_FromStringAndSize(NULL, n * CIPV4_PY_MAX_FIELD);
+        if (!*packed)
+            return -1;
+        char * p = PyBytes_AS_STRING(*packed);
+        memset(p, 0, n * CIPV4_PY_MAX_FIELD);
+        for (Py_ssize_t i=0; i<n; ++i){
+            PyObject * item = PySequence_Fast_GET_ITEM(obj, i);
+            const char * text = NULL;
+            Py_ssize_t len = 0;
+            if (PyUnicode_Check(item))
+                text = PyUnicode_AsUTF8AndSize(item, &len);
+            else if (PyBytes_Check(item)){
+                text = PyBytes_AS_STRING(item);
+                len = PyBytes_GET_SIZE(item);
+            }
+            if (!text){
+                Py_CLEAR(*packed);
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_TypeError, "expected a list of str or bytes");
+                return -1;
+            }
+            // too long or with a null byte: a full field without null is never valid
+            if (len >= CIPV4_PY_MAX_FIELD || memchr(text, '\0', len))
+                memset(p + i * CIPV4_PY_MAX_FIELD, '#', CIPV4_PY_MAX_FIELD);
+            else
+                memcpy(p + i * CIPV4_PY_MAX_FIELD, text, len);
+        }
+        if (PyBuffer_FillInfo(view, *packed, p, n * CIPV4_PY_MAX_FIELD, 1, PyBUF_SIMPLE) != 0){
+            Py_CLEAR(*packed);
+            return -1;
+        }
+        view->ndim = 1;
+        view->itemsize = CIPV4_PY_MAX_FIELD;
+        return 0;
+    }
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        return -1;
+    const char * format = view->format ? view->format : "B";
+    size_t len = strlen(format);
+    int bytes = view->itemsize == 1 && len == 1 && strchr("Bbcs", *format);
+    int strings = view->ndim == 1 && view->itemsize > 1 && len > 0 && format[len - 1] == 's';
+    if (!bytes && !strings){
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_TypeError, "expected text or a buffer of fixed-width strings");
+        return -1;
+    }
+    return 0;
+}
+
+// exactly one record, checked by cipv4_is_ip_valid() and converted by
+// cipv4_str_to_uint() on a null-terminated copy
+static void cipv4_py_parse_field(const char * field, Py_ssize_t len, uint32_t * addr, uint8_t * valid){
+    char buffer[CIPV4_PY_MAX_FIELD];
+    *addr = 0;
+    *valid = 0;
+    if (len >= CIPV4_PY_MAX_FIELD || memchr(field, '\0', len))
+        return;
+    memcpy(buffer, field, len);
+    buffer[len] = '\0';
+    if (!cipv4_is_ip_valid(buffer))
+        return;
+    *addr = cipv4_str_to_uint(buffer);
+    *valid = 1;
+}
+
+
+static PyMethodDef cipv4_py_table_methods[] = {
+    {"lookup", (PyCFunction) cipv4_py_table_lookup, METH_O,
+     "lookup(addrs) -> array('i'): index of the matching network of every uint32 address or -1"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods cipv4_py_table_sequence = {
+    .sq_length = (lenfunc) cipv4_py_table_length,
+    .sq_item = (ssizeargfunc) cipv4_py_table_item,
+};
+
+static PyTypeObject cipv4_py_table_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cipv4.Table",
+    .tp_basicsize = sizeof(cipv4_py_table),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Table(cidrs, lpm=True): compiled prefix table, table[i] is the i-th network",
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc) cipv4_py_table_init,
+    .tp_dealloc = (destructor) cipv4_py_table_dealloc,
+    .tp_methods = cipv4_py_table_methods,
+    .tp_as_sequence = &cipv4_py_table_sequence,
+};
+
+static PyMethodDef cipv4_py_methods[] = {
+    {"parse", cipv4_py_parse, METH_O,
+     "parse(data) -> (array('I'), array('B')): addresses and validity of every record"},
+    {"classify", cipv4_py_classify, METH_O,
+     "classify(addrs) -> array('B'): CIPV4_CLASS_* bits of every uint32 address"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef cipv4_py_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "cipv4",
+    .m_doc = "Batch IPv4 parsing, classification and prefix lookup over buffers",
+    .m_size = -1,
+    .m_methods = cipv4_py_methods,
+};
+
+PyMODINIT_FUNC PyInit_cipv4(void){
+    if (PyType_Ready(&cipv4_py_table_type) < 0)
+        return NULL;
+    if (!cipv4_py_array_type){
+        PyObject * array = PyImport_ImportModule("array");
+        if (!array)
+            return NULL;
+        cipv4_py_array_type = PyObject_GetAttrString(array, "array");
+        Py_DECREF(array);
+        if (!cipv4_py_array_type)
+            return NULL;
+    }
+    PyObject * module = PyModule_Create(&cipv4_py_module);
+    if (!module)
+        return NULL;
+    Py_INCREF(&cipv4_py_table_type);
+    if (PyModule_AddObject(module, "Table", (PyObject*) &cipv4_py_table_type) != 0){
+        Py_DECREF(&cipv4_py_table_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    static const struct { const char * name; int value; } classes[] = {
+        {"CLASS_PRIVATE", CIPV4_CLASS_PRIVATE}, {"CLASS_PUBLIC_NETWORK", CIPV4_CLASS_PUBLIC_NETWORK},
+        {"CLASS_GLOBAL", CIPV4_CLASS_GLOBAL}, {"CLASS_LOOPBACK", CIPV4_CLASS_LOOPBACK},
+        {"CLASS_MULTICAST", CIPV4_CLASS_MULTICAST}, {"CLASS_UNSPECIFIED", CIPV4_CLASS_UNSPECIFIED},
+        {"CLASS_LINKLOCAL", CIPV4_CLASS_LINKLOCAL}, {"CLASS_RESERVED", CIPV4_CLASS_RESERVED},
+    };
+    for (size_t i=0; i<sizeof(classes) / sizeof(classes[0]); ++i)
+        if (PyModule_AddIntConstant(module, classes[i].name, classes[i].value) != 0){
+            Py_DECREF(module);
+            return NULL;
+        }
+    return module;
+}
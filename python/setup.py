@@ -0,0 +1,23 @@
+import glob
+import os
+from setuptools import setup, Extension
+
+# the extension is linked with the library sources, no libcipv4.so needed
+here = os.path.dirname(os.path.abspath(__file__))
+os.chdir(here)
+
+cipv4 = Extension(
+    "cipv4",
+    sources=["cipv4module.c"] + sorted(glob.glob("../src/*.c")),
+    include_dirs=["../include"],
+    extra_compile_args=["-O2", "-pthread"],
+    extra_link_args=["-pthread"],
+    libraries=["rt", "m"],
+)
+
+setup(
+    name="cipv4",
+    version="1.0",
+    description="Batch IPv4 parsing, classification and prefix lookup over buffers",
+    ext_modules=[cipv4],
+)
@@ -0,0 +1,94 @@
+import array
+import ipaddress
+import threading
+import cipv4
+
+
+def test_parse():
+    addrs, valid = cipv4.parse(b"1.2.3.4\n10.0.0.1\r\n01.2.3.4\n\n255.255.255.255\n256.1.1.1")
+    assert list(valid) == [1, 1, 0, 0, 1, 0]
+    assert list(addrs) == [0x01020304, 0x0A000001, 0, 0, 0xFFFFFFFF, 0]
+    assert addrs.typecode == "I" and valid.typecode == "B"
+    # the same records as a list (packed like a numpy dtype 'S16' array)
+    lines = ["1.2.3.4", "10.0.0.1", "01.2.3.4", "", "255.255.255.255", "1.2.3.4.5.6.7.8.9"]
+    a, v = cipv4.parse(lines)
+    assert list(a) == list(addrs) and list(v) == list(valid)
+    a, v = cipv4.parse(b"1.2.3.4\n")
+    assert list(a) == [0x01020304] and list(v) == [1]
+    a, v = cipv4.parse(b"")
+    assert len(a) == 0 and len(v) == 0
+    a, v = cipv4.parse(bytearray(b"8.8.8.8"))
+    assert list(a) == [0x08080808]
+    # only the line terminator is removed, as cipv4_is_ip_valid() sees it
+    a, v = cipv4.parse(b"1.2.3.4 \n 1.2.3.4\n1.2.3.4\r\n1.2.3.4\r\r\n1.2.3.4\r")
+    assert list(v) == [0, 0, 1, 0, 0]
+    # trailing garbage, trailing spaces, over-long and null bytes in a list
+    items = ["1.2.3.4         x", "1.2.3.4 ", "1.2.3.4" + " " * 20, "1.2.3.4\r",
+             b"1.2.3.4\0", "1.2.3.4", b"1.2.3.4"]
+    a, v = cipv4.parse(items)
+    assert list(v) == [0, 0, 0, 0, 0, 1, 1] and list(a) == [0] * 5 + [0x01020304] * 2
+    try:
+        cipv4.parse(array.array("d", [1.0]))
+        assert False
+    except TypeError:
+        pass
+
+
+def test_classify():
+    addrs = array.array("I", [0x0A000001, 0x7F000001, 0xE0000001, 0x08080808, 0])
+    classes = cipv4.classify(addrs)
+    assert classes[0] & cipv4.CLASS_PRIVATE
+    assert classes[1] & cipv4.CLASS_LOOPBACK
+    assert classes[2] & cipv4.CLASS_MULTICAST
+    assert classes[3] & cipv4.CLASS_GLOBAL
+    assert classes[4] & cipv4.CLASS_UNSPECIFIED
+    # raw native-order bytes are accepted too
+    assert list(cipv4.classify(addrs.tobytes())) == list(classes)
+    try:
+        cipv4.classify(b"123")
+        assert False
+    except TypeError:
+        pass
+
+
+def test_table():
+    cidrs = ["10.0.0.0/8", "10.1.0.0/16", "192.168.1.0/24", b"8.8.8.8/32"]
+    table = cipv4.Table(cidrs)
+    assert len(table) == 4 and table[1] == "10.1.0.0/16" and table[3] == "8.8.8.8/32"
+    addrs, valid = cipv4.parse(b"10.1.2.3\n10.2.0.1\n192.168.1.9\n8.8.8.8\n1.1.1.1\n")
+    assert list(table.lookup(addrs)) == [1, 0, 2, 3, -1]
+    first = cipv4.Table(cidrs, lpm=False)
+    assert list(first.lookup(addrs)) == [0, 0, 2, 3, -1]
+    try:
+        cipv4.Table(["10.0.0.0/33"])
+        assert False
+    except ValueError:
+        pass
+    # same answers as ipaddress on example.db, from several threads at once
+    with open("../test/example.db") as f:
+        nets = [line.strip() for line in f if line.strip()]
+    table = cipv4.Table(nets)
+    probe = [str(ipaddress.ip_network(n)[0]) for n in nets[:50]]
+    addrs, valid = cipv4.parse(probe)
+    results = [None] * 4
+
+    def run(k):
+        results[k] = table.lookup(addrs)
+    threads = [threading.Thread(target=run, args=(k,)) for k in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert all(r == results[0] for r in results)
+    objects = [ipaddress.ip_network(n) for n in nets]
+    for addr, index in zip(probe, results[0]):
+        ip = ipaddress.ip_address(addr)
+        best = max((o for o in objects if ip in o), key=lambda o: o.prefixlen)
+        assert objects[index] == best
+
+
+if __name__ == "__main__":
+    test_parse()
+    test_classify()
+    test_table()
+    print("** All Python tests done successfully!")
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <cipv4.h>
 #include <util_string.h>
+#include <cipv4_stats.h>
 
 
 static char _cipv4_ip_loopback[] = "127.0.0.0/8";
@@ -13,22 +14,42 @@ static char _cipv4_ip_linklocal[] = "169.254.0.0/16";
 static char _cipv4_ip_reserved[] = "240.0.0.0/4";
 static char _cipv4_ip_unspecified[] = "0.0.0.0";
 static char _cipv4_ip_public_network[] = "100.64.0.0/10";
-static char _cipv4_ip_private[CIPV4_PRAVATE_ARRAY_LENGTH][19] = {"0.0.0.0/8", "10.0.0.0/8",
-                                         "127.0.0.0/8", "240.0.0.0/4", "255.255.255.255/32",
-                                        "169.254.0.0/16", "172.16.0.0/12", "192.0.0.0/29",
-                                        "192.0.0.170/31", "192.0.2.0/24", "192.168.0.0/16",
-                                        "198.18.0.0/15", "198.51.100.0/24", "203.0.113.0/24"};
+#define CIPV4_PRIVATE_STRING(a, b, c, d, prefix) #a "." #b "." #c "." #d "/" #prefix,
+static char _cipv4_ip_private[CIPV4_PRAVATE_ARRAY_LENGTH][19] = {CIPV4_PRIVATE_NETWORKS(CIPV4_PRIVATE_STRING)};
 
 
 
-static cipv4_ctx* cipv4_init(void);
+#define CIPV4_ARENA_ALIGN 16
+#define CIPV4_ARENA_HEADER ((sizeof(cipv4_arena_block) + CIPV4_ARENA_ALIGN - 1) & ~(CIPV4_ARENA_ALIGN - 1))
+
+typedef struct _cipv4_arena_block cipv4_arena_block;
+struct _cipv4_arena_block{
+    cipv4_arena_block * next;
+    unsigned long int size;     // usable bytes after the header
+    unsigned long int used;
+};
+
+struct _cipv4_arena{
+    cipv4_arena_block * head;
+    cipv4_arena_block * current;
+    unsigned long int block_size;
+};
+
+
+static cipv4_ctx* cipv4_init(cipv4_arena * arena);
+static cipv4_ctx * cipv4_parse(cipv4_arena * arena, const char * ip);
+static void * cipv4_arena_alloc(cipv4_arena * arena, unsigned long int size);
+static int cipv4_check_private(cipv4_ctx * ctx);
+static int cipv4_check_private_from_string(const char * ip);
+static int cipv4_check_public_network(cipv4_ctx * ctx);
+static int cipv4_check_public_network_from_string(const char * ip);
 
 /**
  * @brief Free the memory allocated for the context created by cipv4_parse_ip()
  * @return nothing
  */
 void cipv4_free(cipv4_ctx * ctx){
-    if (!ctx)
+    if (!ctx || ctx->arena)     // released by cipv4_arena_free()
         return;
     if (ctx->raw)
         free(ctx->raw);
@@ -44,18 +65,8 @@ void cipv4_free(cipv4_ctx * ctx){
  * iana-ipv4-special-registry, 0 otherwise and -1 in case of error.
  */
 int cipv4_is_private(cipv4_ctx * ctx){
-    static cipv4_ctx* private[CIPV4_PRAVATE_ARRAY_LENGTH] = {NULL};
-    if (!ctx)
-        return -1;
-    if (!private[0]){
-        // initialize the array
-        for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
-            private[i] = cipv4_parse_ip(_cipv4_ip_private[i]);
-    }
-    for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
-        if (cipv4_is_address_in(private[i], ctx->raw))
-                return 1;
-    return 0;
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_PRIVATE);
+    return cipv4_check_private(ctx);
 }
 
 /**
@@ -65,19 +76,8 @@ int cipv4_is_private(cipv4_ctx * ctx){
  * iana-ipv4-special-registry, 0 otherwise and -1 in case of error.
  */
 int cipv4_is_private_from_string(const char * ip){
-    static cipv4_ctx* private[CIPV4_PRAVATE_ARRAY_LENGTH] = {NULL};
-    if (!ip || cipv4_is_ip_valid(ip) == 0)
-        return -1;
-    if (!private[0]){
-        // initialize the array
-        for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
-            private[i] = cipv4_parse_ip(_cipv4_ip_private[i]);
-    }
-    uint32_t int_ip = cipv4_str_to_uint(ip);
-    for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
-        if (int_ip >= private[i]->addr_start && int_ip <= private[i]->addr_end)
-            return 1;
-    return 0;
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_PRIVATE_FROM_STRING);
+    return cipv4_check_private_from_string(ip);
 }
 
 /**
@@ -87,14 +87,8 @@ int cipv4_is_private_from_string(const char * ip){
  * 0 otherwise and -1 in case of error.
  */
 int cipv4_is_public_network(cipv4_ctx * ctx){
-    static cipv4_ctx * public = NULL;
-    if (!ctx)
-        return -1;
-    if (!public)
-        public = cipv4_parse_ip(_cipv4_ip_public_network);
-    if (cipv4_is_address_in(public, ctx->raw))
-        return 1;
-    return 0;
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_PUBLIC_NETWORK);
+    return cipv4_check_public_network(ctx);
 }
 
 /**
@@ -103,15 +97,8 @@ int cipv4_is_public_network(cipv4_ctx * ctx){
  * @return 1 if IP address is public network, 0 otherwise and -1 for errors.
  */
 int cipv4_is_public_network_from_string(const char * ip){
-    static cipv4_ctx * public = NULL;
-    if (!ip || cipv4_is_ip_valid(ip) == 0)
-        return -1;
-    if (!public)
-        public = cipv4_parse_ip(_cipv4_ip_public_network);
-    uint32_t int_ip = cipv4_str_to_uint(ip);
-    if (int_ip >= public->addr_start && int_ip <= public->addr_end)
-        return 1;
-    return 0;
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_PUBLIC_NETWORK_FROM_STRING);
+    return cipv4_check_public_network_from_string(ip);
 }
 
 
@@ -121,8 +108,9 @@ int cipv4_is_public_network_from_string(const char * ip){
  * @return 1 if IP address is global, 0 otherwise and -1 for errors.
  */
 int cipv4_is_global_from_string(const char * ip){
-    return (!cipv4_is_public_network_from_string(ip)) &&
-           (!cipv4_is_private_from_string(ip));
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_GLOBAL_FROM_STRING);
+    return (!cipv4_check_public_network_from_string(ip)) &&
+           (!cipv4_check_private_from_string(ip));
 }
 
 /**
@@ -131,8 +119,9 @@ int cipv4_is_global_from_string(const char * ip){
  * @return 1 if IP address is global, 0 otherwise and -1 for errors.
  */
 int cipv4_is_global(cipv4_ctx * ctx){
-    return (!cipv4_is_private(ctx)) &&
-           (!cipv4_is_public_network(ctx));
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_GLOBAL);
+    return (!cipv4_check_private(ctx)) &&
+           (!cipv4_check_public_network(ctx));
 }
 
 
@@ -142,11 +131,12 @@ int cipv4_is_global(cipv4_ctx * ctx){
  * @return 1 if IP address is loopback, 0 otherwise and -1 for errors.
  */
 int cipv4_is_loopback(cipv4_ctx * ctx){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_LOOPBACK);
     static cipv4_ctx * loopback = NULL;
     if (!ctx)
         return -1;
     if (!loopback)
-        loopback = cipv4_parse_ip(_cipv4_ip_loopback);
+        loopback = cipv4_parse(NULL, _cipv4_ip_loopback);
     if (cipv4_is_address_in(loopback, ctx->raw))
         return 1;
     return 0;
@@ -159,11 +149,12 @@ int cipv4_is_loopback(cipv4_ctx * ctx){
  * @return 1 if IP address is loopback, 0 otherwise and -1 for errors.
  */
 int cipv4_is_loopback_from_string(const char * ip){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_LOOPBACK_FROM_STRING);
     static cipv4_ctx * loopback = NULL;
     if (!ip || cipv4_is_ip_valid(ip) == 0)
         return -1;
     if (!loopback)
-        loopback = cipv4_parse_ip(_cipv4_ip_loopback);
+        loopback = cipv4_parse(NULL, _cipv4_ip_loopback);
     uint32_t int_ip = cipv4_str_to_uint(ip);
     if (int_ip >= loopback->addr_start && int_ip <= loopback->addr_end)
         return 1;
@@ -177,11 +168,12 @@ int cipv4_is_loopback_from_string(const char * ip){
  * @return 1 if IP address is multicast, 0 otherwise and -1 for errors.
  */
 int cipv4_is_multicast(cipv4_ctx * ctx){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_MULTICAST);
     static cipv4_ctx * multicast = NULL;
     if (!ctx)
         return -1;
     if (!multicast)
-        multicast = cipv4_parse_ip(_cipv4_ip_multicast);
+        multicast = cipv4_parse(NULL, _cipv4_ip_multicast);
     if (cipv4_is_address_in(multicast, ctx->raw))
         return 1;
     return 0;
@@ -193,11 +185,12 @@ int cipv4_is_multicast(cipv4_ctx * ctx){
  * @return 1 if IP address is multicast, 0 otherwise and -1 for errors.
  */
 int cipv4_is_multicast_from_string(const char * ip){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_MULTICAST_FROM_STRING);
     static cipv4_ctx * multicast = NULL;
     if (!ip || cipv4_is_ip_valid(ip) == 0)
         return -1;
     if (!multicast)
-        multicast = cipv4_parse_ip(_cipv4_ip_multicast);
+        multicast = cipv4_parse(NULL, _cipv4_ip_multicast);
     uint32_t int_ip = cipv4_str_to_uint(ip);
     if (int_ip >= multicast->addr_start && int_ip <= multicast->addr_end)
         return 1;
@@ -212,11 +205,12 @@ int cipv4_is_multicast_from_string(const char * ip){
  * @return 1 if IP address is unspecified, 0 otherwise and -1 for errors.
  */
 int cipv4_is_unspecified(cipv4_ctx * ctx){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_UNSPECIFIED);
     static cipv4_ctx * unspecified = NULL;
     if (!ctx)
         return -1;
     if (!unspecified)
-        unspecified = cipv4_parse_ip(_cipv4_ip_unspecified);
+        unspecified = cipv4_parse(NULL, _cipv4_ip_unspecified);
     if (cipv4_is_address_in(unspecified, ctx->raw))
         return 1;
     return 0;
@@ -228,11 +222,12 @@ int cipv4_is_unspecified(cipv4_ctx * ctx){
  * @return 1 if IP address is unspecified, 0 otherwise and -1 for errors.
  */
 int cipv4_is_unspecified_from_string(const char * ip){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_UNSPECIFIED_FROM_STRING);
     static cipv4_ctx * unspecified = NULL;
     if (!ip || cipv4_is_ip_valid(ip) == 0)
         return -1;
     if (!unspecified)
-        unspecified = cipv4_parse_ip(_cipv4_ip_unspecified);
+        unspecified = cipv4_parse(NULL, _cipv4_ip_unspecified);
     uint32_t int_ip = cipv4_str_to_uint(ip);
     if (int_ip >= unspecified->addr_start && int_ip <= unspecified->addr_end)
         return 1;
@@ -247,11 +242,12 @@ int cipv4_is_unspecified_from_string(const char * ip){
  * @return 1 if IP address is link-local, 0 otherwise and -1 for errors.
  */
 int cipv4_is_linklocal_from_string(const char * ip){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_LINKLOCAL_FROM_STRING);
     static cipv4_ctx * linklocal = NULL;
     if (!ip || cipv4_is_ip_valid(ip) == 0)
         return -1;
     if (!linklocal)
-        linklocal = cipv4_parse_ip(_cipv4_ip_linklocal);
+        linklocal = cipv4_parse(NULL, _cipv4_ip_linklocal);
     uint32_t int_ip = cipv4_str_to_uint(ip);
     if (int_ip >= linklocal->addr_start && int_ip <= linklocal->addr_end)
         return 1;
@@ -265,11 +261,12 @@ int cipv4_is_linklocal_from_string(const char * ip){
  * @return 1 if IP address is link-local, 0 otherwise and -1 for errors.
  */
 int cipv4_is_linklocal(cipv4_ctx * ctx){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_LINKLOCAL);
     static cipv4_ctx * linklocal = NULL;
     if (!ctx)
         return -1;
     if (!linklocal)
-        linklocal = cipv4_parse_ip(_cipv4_ip_linklocal);
+        linklocal = cipv4_parse(NULL, _cipv4_ip_linklocal);
     if (cipv4_is_address_in(linklocal, ctx->raw))
         return 1;
     return 0;
@@ -282,11 +279,12 @@ int cipv4_is_linklocal(cipv4_ctx * ctx){
  * @return 1 if IP address is reserved, 0 otherwise and -1 for errors.
  */
 int cipv4_is_reserved_from_string(const char * ip){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_RESERVED_FROM_STRING);
     static cipv4_ctx * reserved = NULL;
     if (!ip || cipv4_is_ip_valid(ip) == 0)
         return -1;
     if (!reserved)
-        reserved = cipv4_parse_ip(_cipv4_ip_reserved);
+        reserved = cipv4_parse(NULL, _cipv4_ip_reserved);
     uint32_t int_ip = cipv4_str_to_uint(ip);
     if (int_ip >= reserved->addr_start && int_ip <= reserved->addr_end)
         return 1;
@@ -299,11 +297,12 @@ int cipv4_is_reserved_from_string(const char * ip){
  * @return 1 if IP address is reserved, 0 otherwise and -1 for errors.
  */
 int cipv4_is_reserved(cipv4_ctx * ctx){
+    CIPV4_STATS_CLASSIFIER(CIPV4_STATS_IS_RESERVED);
     static cipv4_ctx * reserved = NULL;
     if (!ctx)
         return -1;
     if (!reserved)
-        reserved = cipv4_parse_ip(_cipv4_ip_reserved);
+        reserved = cipv4_parse(NULL, _cipv4_ip_reserved);
     if (cipv4_is_address_in(reserved, ctx->raw))
         return 1;
     return 0;
@@ -380,22 +379,129 @@ char * cipv4_get_subnet_mask(cipv4_ctx * ctx, char * buffer){
 }
 
 
-static cipv4_ctx* cipv4_init(void){
-    cipv4_ctx * ctx = (cipv4_ctx*) malloc(sizeof(cipv4_ctx));
-    if (!ctx)
-        return NULL;
-    ctx->err_msg = (char*) malloc(256);
-    if (!ctx->err_msg){
-        free(ctx);
-        return NULL;
+static cipv4_ctx* cipv4_init(cipv4_arena * arena){
+    cipv4_ctx * ctx = NULL;
+    if (arena){
+        ctx = (cipv4_ctx*) cipv4_arena_alloc(arena, sizeof(cipv4_ctx));
+        if (!ctx)
+            return NULL;
+        ctx->err_msg = (char*) cipv4_arena_alloc(arena, CIPV4_ERR_MSG_LENGTH);
+        if (!ctx->err_msg)
+            return NULL;
+    }else{
+        ctx = (cipv4_ctx*) malloc(sizeof(cipv4_ctx));
+        if (!ctx)
+            return NULL;
+        ctx->err_msg = (char*) malloc(CIPV4_ERR_MSG_LENGTH);
+        if (!ctx->err_msg){
+            free(ctx);
+            return NULL;
+        }
     }
-    for(int i=0; i<256; ++i)
+    for(int i=0; i<CIPV4_ERR_MSG_LENGTH; ++i)
         ctx->err_msg[i] = '\0';
     ctx->error = 0;    //success
     ctx->raw = NULL;
+    ctx->arena = arena;
     return ctx;
 }
 
+/**
+ * @brief Create a memory arena for cipv4_parse_ip_arena()
+ * @param block_size Size of the memory blocks requested from malloc
+ * (0 uses CIPV4_ARENA_BLOCK_SIZE)
+ * @return A pointer to the arena or NULL in case of failure.
+ *
+ * Contexts created from an arena are not freed one by one (cipv4_free()
+ * ignores them), they are all released at once by cipv4_arena_free() or
+ * cipv4_arena_reset().
+ *
+ * @code
+ *    cipv4_arena * arena = cipv4_arena_new(0);
+ *    while (read_line(buffer)){
+ *        cipv4_ctx * ctx = cipv4_parse_ip_arena(arena, buffer);
+ *        // do some stuff here...
+ *    }
+ *    cipv4_arena_free(arena);     // releases all the contexts
+ * @endcode
+ */
+cipv4_arena * cipv4_arena_new(unsigned long int block_size){
+    if (block_size == 0)
+        block_size = CIPV4_ARENA_BLOCK_SIZE;
+    cipv4_arena * arena = (cipv4_arena*) malloc(sizeof(cipv4_arena));
+    if (!arena)
+        return NULL;
+    arena->block_size = (block_size + CIPV4_ARENA_ALIGN - 1) & ~(CIPV4_ARENA_ALIGN - 1);
+    arena->head = (cipv4_arena_block*) malloc(CIPV4_ARENA_HEADER + arena->block_size);
+    if (!arena->head){
+        free(arena);
+        return NULL;
+    }
+    arena->head->next = NULL;
+    arena->head->size = arena->block_size;
+    arena->head->used = 0;
+    arena->current = arena->head;
+    return arena;
+}
+
+/**
+ * @brief Release all the contexts of the arena but keep its memory for reuse
+ * @param arena The arena created by cipv4_arena_new()
+ * @return nothing
+ *
+ * All the contexts created from this arena become invalid.
+ */
+void cipv4_arena_reset(cipv4_arena * arena){
+    if (!arena)
+        return;
+    for (cipv4_arena_block * b = arena->head; b; b = b->next)
+        b->used = 0;
+    arena->current = arena->head;
+}
+
+/**
+ * @brief Free the arena and all the contexts created from it
+ * @param arena The arena created by cipv4_arena_new() (can be NULL)
+ * @return nothing
+ */
+void cipv4_arena_free(cipv4_arena * arena){
+    if (!arena)
+        return;
+    cipv4_arena_block * b = arena->head;
+    while (b){
+        cipv4_arena_block * next = b->next;
+        free(b);
+        b = next;
+    }
+    free(arena);
+}
+
+static void * cipv4_arena_alloc(cipv4_arena * arena, unsigned long int size){
+    size = (size + CIPV4_ARENA_ALIGN - 1) & ~(CIPV4_ARENA_ALIGN - 1);
+    cipv4_arena_block * b = arena->current;
+    if (b->used + size <= b->size){
+        void * p = (char*)b + CIPV4_ARENA_HEADER + b->used;
+        b->used += size;
+        return p;
+    }
+    // blocks after the current one are empty (kept by cipv4_arena_reset())
+    cipv4_arena_block * next = b->next;
+    if (!next || next->size < size){
+        unsigned long int block_size = size > arena->block_size ? size : arena->block_size;
+        cipv4_arena_block * nb = (cipv4_arena_block*) malloc(CIPV4_ARENA_HEADER + block_size);
+        if (!nb)
+            return NULL;
+        nb->size = block_size;
+        nb->used = 0;
+        nb->next = next;
+        b->next = nb;
+        next = nb;
+    }
+    arena->current = next;
+    next->used = size;
+    return (char*)next + CIPV4_ARENA_HEADER;
+}
+
 /**
  * @brief Coverts an Integer IP address to string representation
  * @param addr IP address in a form of 32-bit integer
@@ -445,6 +551,30 @@ const char * cipv4_uint_to_str(uint32_t addr, const char * buffer){
  * @endcode
  */
 cipv4_ctx * cipv4_parse_ip(const char * ip){
+    return cipv4_parse_ip_arena(NULL, ip);
+}
+
+/**
+ * @brief Same as cipv4_parse_ip() but allocates the context from an arena
+ * @param arena The arena created by cipv4_arena_new() or NULL to use malloc
+ * @param ip A pointer to the null-terminated string contains IPv4 address
+ * @return A pointer to the context or NULL in case of error.
+ *
+ * The context (including raw and err_msg) lives until the arena is reset
+ * or freed, there is no need to call cipv4_free().
+ */
+cipv4_ctx * cipv4_parse_ip_arena(cipv4_arena * arena, const char * ip){
+    uint64_t start = CIPV4_STATS_SAMPLE_START();
+    cipv4_ctx * ctx = cipv4_parse(arena, ip);
+    if (ctx && ctx->error == 0)
+        CIPV4_STATS_PARSE_OK();
+    else
+        CIPV4_STATS_PARSE_ERROR(ctx ? ctx->error : 0);
+    CIPV4_STATS_SAMPLE_END(CIPV4_STATS_PARSE, start);
+    return ctx;
+}
+
+static cipv4_ctx * cipv4_parse(cipv4_arena * arena, const char * ip){
     if (NULL == ip || cstr_len(ip) > 20)     // what can I do?
         return NULL;
     char tmp[20] = {0};
@@ -454,7 +584,7 @@ cipv4_ctx * cipv4_parse_ip(const char * ip){
     prefix_pos = cstr_chr(tmp, '/');
     if (prefix_pos != NULL)
         has_prefix = 1;
-    cipv4_ctx * ctx = cipv4_init();
+    cipv4_ctx * ctx = cipv4_init(arena);
     if (!ctx)
         return NULL;
     if (has_prefix)
@@ -481,7 +611,10 @@ cipv4_ctx * cipv4_parse_ip(const char * ip){
     ctx->network_prefix = prefix;
     ctx->error = 0;
     ctx->err_msg[0] = '\0';
-    ctx->raw = (char*) malloc(cstr_len(ip)+1);
+    if (arena)
+        ctx->raw = (char*) cipv4_arena_alloc(arena, cstr_len(ip)+1);
+    else
+        ctx->raw = (char*) malloc(cstr_len(ip)+1);
     ctx->addr = cipv4_str_to_uint(tmp);
     if (!ctx->raw){
         ctx->error = 3;
@@ -592,3 +725,65 @@ int cipv4_is_ip_valid(const char * ip){
         return 0;
     return is_invalid == 1?0:1;           // valid
 }
+
+// The cipv4_check_*() helpers hold the lookups of the public classifiers,
+// which count the call and return the check. cipv4_is_global*() uses the
+// helpers directly so it counts as one classifier call, not three.
+
+// address of the context in one of the private networks
+static int cipv4_check_private(cipv4_ctx * ctx){
+    static cipv4_ctx* private[CIPV4_PRAVATE_ARRAY_LENGTH] = {NULL};
+    if (!ctx)
+        return -1;
+    if (!private[0]){
+        // initialize the array
+        for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
+            private[i] = cipv4_parse(NULL, _cipv4_ip_private[i]);
+    }
+    for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
+        if (cipv4_is_address_in(private[i], ctx->raw))
+                return 1;
+    return 0;
+}
+
+// address string in one of the private networks
+static int cipv4_check_private_from_string(const char * ip){
+    static cipv4_ctx* private[CIPV4_PRAVATE_ARRAY_LENGTH] = {NULL};
+    if (!ip || cipv4_is_ip_valid(ip) == 0)
+        return -1;
+    if (!private[0]){
+        // initialize the array
+        for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
+            private[i] = cipv4_parse(NULL, _cipv4_ip_private[i]);
+    }
+    uint32_t int_ip = cipv4_str_to_uint(ip);
+    for (int i=0; i< CIPV4_PRAVATE_ARRAY_LENGTH; ++i)
+        if (int_ip >= private[i]->addr_start && int_ip <= private[i]->addr_end)
+            return 1;
+    return 0;
+}
+
+// address of the context in the shared address space
+static int cipv4_check_public_network(cipv4_ctx * ctx){
+    static cipv4_ctx * public = NULL;
+    if (!ctx)
+        return -1;
+    if (!public)
+        public = cipv4_parse(NULL, _cipv4_ip_public_network);
+    if (cipv4_is_address_in(public, ctx->raw))
+        return 1;
+    return 0;
+}
+
+// address string in the shared address space
+static int cipv4_check_public_network_from_string(const char * ip){
+    static cipv4_ctx * public = NULL;
+    if (!ip || cipv4_is_ip_valid(ip) == 0)
+        return -1;
+    if (!public)
+        public = cipv4_parse(NULL, _cipv4_ip_public_network);
+    uint32_t int_ip = cipv4_str_to_uint(ip);
+    if (int_ip >= public->addr_start && int_ip <= public->addr_end)
+        return 1;
+    return 0;
+}
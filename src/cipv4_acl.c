@@ -0,0 +1,388 @@
+/// @file cipv4_acl.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cipv4_acl.h>
+#include <cipv4_stats.h>
+
+
+typedef struct _cipv4_acl_span cipv4_acl_span;
+struct _cipv4_acl_span{
+    uint64_t addr_start;
+    uint64_t addr_end;
+    uint32_t rule;
+};
+
+static int cipv4_acl_cmp_point(const void * a, const void * b);
+static int cipv4_acl_cmp_span(const void * a, const void * b);
+static int cipv4_acl_cmp_index(const void * a, const void * b);
+static int64_t cipv4_acl_new_chunk(cipv4_acl * acl, uint32_t * capacity);
+static int cipv4_acl_resolve(cipv4_acl * acl, const cipv4_acl_rule * rules, uint32_t nrules);
+static int cipv4_acl_build_table(cipv4_acl * acl);
+static void cipv4_acl_release(cipv4_acl * acl);
+
+
+/**
+ * @brief Free the memory allocated by cipv4_acl_compile()
+ * @param acl The compiled ACL (can be NULL)
+ * @return nothing
+ */
+void cipv4_acl_free(cipv4_acl * acl){
+    if (!acl)
+        return;
+    if (cipv4_stats_enabled()){
+        unsigned long int bytes[3];
+        cipv4_acl_memory(acl, bytes);
+        for (int i=0; i<3; ++i)
+            CIPV4_STATS_TABLE(i, -(int64_t)bytes[i]);
+    }
+    cipv4_acl_release(acl);
+}
+
+/**
+ * @brief Memory used by the lookup table of a compiled ACL
+ * @param acl The compiled ACL returned by cipv4_acl_compile()
+ * @param bytes User-provided array of 3 elements to receive the number of
+ * bytes used by the first (/16), second (/24) and third (/32) level.
+ * @return nothing
+ */
+void cipv4_acl_memory(const cipv4_acl * acl, unsigned long int * bytes){
+    unsigned long int level2 = 0;
+    for (uint32_t s=0; s<65536; ++s)
+        level2 += (acl->tbl16[s] & CIPV4_ACL_CHUNK) != 0;
+    bytes[0] = 65536 * sizeof(uint32_t);
+    bytes[1] = level2 * 256 * sizeof(uint32_t);
+    bytes[2] = (acl->nchunks - level2) * 256 * sizeof(uint32_t);
+}
+
+static void cipv4_acl_release(cipv4_acl * acl){
+    free(acl->tbl16);
+    free(acl->chunks);
+    free(acl->actions);
+    free(acl->ranges);
+    free(acl->shadowed);
+    free(acl);
+}
+
+/**
+ * @brief Compile an ordered list of rules with first-match semantic.
+ * @param rules Array of rules, the first rule matching an address wins.
+ * @param nrules Number of rules in the array
+ * @param default_action The action for addresses not matched by any rule
+ * @return A pointer to the compiled ACL or NULL in case of error
+ * (wrong prefix or memory allocation failure).
+ *
+ * Overlapping rules are resolved into disjoint ranges (acl->ranges) and
+ * the rules that can never match because earlier rules cover all their
+ * addresses are reported in acl->shadowed. Lookups take at most three
+ * memory accesses regardless of the number of rules.
+ *
+ * @code
+ *    cipv4_acl_rule rules[2];
+ *    cipv4_ctx * ctx = cipv4_parse_ip("10.1.0.0/16");
+ *    rules[0].addr = ctx->addr;
+ *    rules[0].network_prefix = ctx->network_prefix;
+ *    rules[0].action = CIPV4_ACL_DENY;
+ *    cipv4_free(ctx);
+ *    ctx = cipv4_parse_ip("10.0.0.0/8");
+ *    rules[1].addr = ctx->addr;
+ *    rules[1].network_prefix = ctx->network_prefix;
+ *    rules[1].action = CIPV4_ACL_PERMIT;
+ *    cipv4_free(ctx);
+ *    cipv4_acl * acl = cipv4_acl_compile(rules, 2, CIPV4_ACL_DENY);
+ *    // prints 1
+ *    fprintf(stdout, "%d\n", cipv4_acl_lookup(acl, cipv4_str_to_uint("10.2.3.4")));
+ *    cipv4_acl_free(acl);
+ * @endcode
+ */
+cipv4_acl * cipv4_acl_compile(const cipv4_acl_rule * rules, uint32_t nrules, int default_action){
+    if ((!rules && nrules > 0) || nrules >= CIPV4_ACL_CHUNK - 1)
+        return NULL;
+    for (uint32_t i=0; i<nrules; ++i)
+        if (rules[i].network_prefix > 32)
+            return NULL;
+    cipv4_acl * acl = (cipv4_acl*) calloc(1, sizeof(cipv4_acl));
+    if (!acl)
+        return NULL;
+    acl->nrules = nrules;
+    acl->default_action = default_action;
+    acl->actions = (int*) malloc((nrules + 1) * sizeof(int));
+    if (!acl->actions){
+        cipv4_acl_release(acl);
+        return NULL;
+    }
+    for (uint32_t i=0; i<nrules; ++i)
+        acl->actions[i] = rules[i].action;
+    if (cipv4_acl_resolve(acl, rules, nrules) != 0 || cipv4_acl_build_table(acl) != 0){
+        cipv4_acl_release(acl);
+        return NULL;
+    }
+    if (cipv4_stats_enabled()){
+        unsigned long int bytes[3];
+        cipv4_acl_memory(acl, bytes);
+        for (int i=0; i<3; ++i)
+            CIPV4_STATS_TABLE(i, (int64_t)bytes[i]);
+    }
+    return acl;
+}
+
+/**
+ * @brief Compile a list of networks with longest-prefix-match semantic.
+ * @param rules Array of rules, the most specific network containing an
+ * address wins (the first one for identical networks).
+ * @param nrules Number of rules in the array
+ * @param default_action The action for addresses not matched by any rule
+ * @return A pointer to the compiled ACL or NULL in case of error.
+ *
+ * Same table as cipv4_acl_compile(): cipv4_acl_match() returns the index
+ * of the longest matching prefix in the rules array, e.g. the line of a
+ * CIDR database. Only identical networks can be shadowed.
+ */
+cipv4_acl * cipv4_acl_compile_lpm(const cipv4_acl_rule * rules, uint32_t nrules, int default_action){
+    if ((!rules && nrules > 0) || nrules >= CIPV4_ACL_CHUNK - 1)
+        return NULL;
+    for (uint32_t i=0; i<nrules; ++i)
+        if (rules[i].network_prefix > 32)
+            return NULL;
+    // stable counting sort by prefix len, longest first
+    uint32_t start[34] = {0};
+    uint32_t * order = (uint32_t*) malloc((nrules + 1) * sizeof(uint32_t));
+    cipv4_acl_rule * sorted = (cipv4_acl_rule*) malloc((nrules + 1) * sizeof(cipv4_acl_rule));
+    if (!order || !sorted){
+        free(order);
+        free(sorted);
+        return NULL;
+    }
+    for (uint32_t i=0; i<nrules; ++i)
+        start[33 - rules[i].network_prefix]++;
+    for (int p=1; p<34; ++p)
+        start[p] += start[p - 1];
+    for (uint32_t i=nrules; i-- > 0;)
+        order[--start[33 - rules[i].network_prefix]] = i;
+    for (uint32_t k=0; k<nrules; ++k)
+        sorted[k] = rules[order[k]];
+    cipv4_acl * acl = cipv4_acl_compile(sorted, nrules, default_action);
+    free(sorted);
+    if (!acl){
+        free(order);
+        return NULL;
+    }
+    // translate the sorted indexes back to the indexes of the input
+    for (uint32_t s=0; s<65536; ++s)
+        if (acl->tbl16[s] && !(acl->tbl16[s] & CIPV4_ACL_CHUNK))
+            acl->tbl16[s] = order[acl->tbl16[s] - 1] + 1;
+    for (uint64_t c=0; c<(uint64_t)acl->nchunks * 256; ++c)
+        if (acl->chunks[c] && !(acl->chunks[c] & CIPV4_ACL_CHUNK))
+            acl->chunks[c] = order[acl->chunks[c] - 1] + 1;
+    for (uint32_t r=0; r<acl->nranges; ++r)
+        if (acl->ranges[r].rule >= 0)
+            acl->ranges[r].rule = (int)order[acl->ranges[r].rule];
+    for (uint32_t i=0; i<acl->nshadowed; ++i)
+        acl->shadowed[i] = order[acl->shadowed[i]];
+    qsort(acl->shadowed, acl->nshadowed, sizeof(uint32_t), cipv4_acl_cmp_index);
+    for (uint32_t i=0; i<nrules; ++i)
+        acl->actions[i] = rules[i].action;
+    free(order);
+    return acl;
+}
+
+/**
+ * @brief Find the first rule matching the address
+ * @param acl The compiled ACL returned by cipv4_acl_compile()
+ * @param addr IP address in a form of 32-bit integer
+ * @return Index of the first matching rule or -1 if no rule matches.
+ */
+int cipv4_acl_match(const cipv4_acl * acl, uint32_t addr){
+    uint64_t start = CIPV4_STATS_SAMPLE_START();
+    int depth = 1;
+    uint32_t e = acl->tbl16[addr >> 16];
+    if (e & CIPV4_ACL_CHUNK){
+        depth = 2;
+        e = acl->chunks[((e & ~CIPV4_ACL_CHUNK) << 8) | ((addr >> 8) & 0xFF)];
+        if (e & CIPV4_ACL_CHUNK){
+            depth = 3;
+            e = acl->chunks[((e & ~CIPV4_ACL_CHUNK) << 8) | (addr & 0xFF)];
+        }
+    }
+    CIPV4_STATS_LOOKUP_DEPTH(depth);
+    CIPV4_STATS_SAMPLE_END(CIPV4_STATS_ACL_MATCH, start);
+    return (int)e - 1;
+}
+
+/**
+ * @brief Returns the action of the first rule matching the address
+ * @param acl The compiled ACL returned by cipv4_acl_compile()
+ * @param addr IP address in a form of 32-bit integer
+ * @return The action of the matching rule or the default action.
+ */
+int cipv4_acl_lookup(const cipv4_acl * acl, uint32_t addr){
+    int rule = cipv4_acl_match(acl, addr);
+    return rule < 0 ? acl->default_action : acl->actions[rule];
+}
+
+
+static int cipv4_acl_cmp_point(const void * a, const void * b){
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cipv4_acl_cmp_index(const void * a, const void * b){
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cipv4_acl_cmp_span(const void * a, const void * b){
+    const cipv4_acl_span * x = (const cipv4_acl_span*)a;
+    const cipv4_acl_span * y = (const cipv4_acl_span*)b;
+    if (x->addr_start != y->addr_start)
+        return x->addr_start < y->addr_start ? -1 : 1;
+    return x->rule < y->rule ? -1 : x->rule > y->rule;
+}
+
+// sweep over the elementary intervals between rule boundaries keeping
+// the active rules in a min-heap of rule indexes. The top of the heap
+// is the first matching rule of the current interval.
+static int cipv4_acl_resolve(cipv4_acl * acl, const cipv4_acl_rule * rules, uint32_t nrules){
+    uint64_t * points = (uint64_t*) malloc((2 * nrules + 2) * sizeof(uint64_t));
+    cipv4_acl_span * spans = (cipv4_acl_span*) malloc((nrules + 1) * sizeof(cipv4_acl_span));
+    uint32_t * heap = (uint32_t*) malloc((nrules + 1) * sizeof(uint32_t));
+    uint8_t * hit = (uint8_t*) calloc(nrules + 1, 1);
+    acl->ranges = (cipv4_acl_range*) malloc((2 * nrules + 1) * sizeof(cipv4_acl_range));
+    acl->shadowed = (uint32_t*) malloc((nrules + 1) * sizeof(uint32_t));
+    int ret = -1;
+    if (!points || !spans || !heap || !hit || !acl->ranges || !acl->shadowed)
+        goto done;
+    uint32_t npoints = 0;
+    points[npoints++] = 0;
+    points[npoints++] = 1ULL << 32;
+    for (uint32_t i=0; i<nrules; ++i){
+        uint32_t mask = rules[i].network_prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - rules[i].network_prefix);
+        spans[i].addr_start = rules[i].addr & mask;
+        spans[i].addr_end = (rules[i].addr & mask) | ~mask;
+        spans[i].rule = i;
+        points[npoints++] = spans[i].addr_start;
+        points[npoints++] = spans[i].addr_end + 1;
+    }
+    qsort(points, npoints, sizeof(uint64_t), cipv4_acl_cmp_point);
+    qsort(spans, nrules, sizeof(cipv4_acl_span), cipv4_acl_cmp_span);
+    uint32_t unique = 1;
+    for (uint32_t i=1; i<npoints; ++i)
+        if (points[i] != points[unique - 1])
+            points[unique++] = points[i];
+    npoints = unique;
+    uint32_t nheap = 0;
+    uint32_t next = 0;
+    int last = -2;
+    acl->nranges = 0;
+    for (uint32_t k=0; k + 1<npoints; ++k){
+        uint64_t p = points[k];
+        while (next < nrules && spans[next].addr_start == p){
+            // push the rule index and sift up
+            uint32_t pos = nheap++;
+            uint32_t idx = next++;
+            while (pos > 0 && spans[heap[(pos - 1) / 2]].rule > spans[idx].rule){
+                heap[pos] = heap[(pos - 1) / 2];
+                pos = (pos - 1) / 2;
+            }
+            heap[pos] = idx;
+        }
+        while (nheap > 0 && spans[heap[0]].addr_end < p){
+            // pop the expired rule and sift down
+            uint32_t idx = heap[--nheap];
+            uint32_t pos = 0;
+            for (;;){
+                uint32_t child = 2 * pos + 1;
+                if (child >= nheap)
+                    break;
+                if (child + 1 < nheap && spans[heap[child + 1]].rule < spans[heap[child]].rule)
+                    child++;
+                if (spans[heap[child]].rule >= spans[idx].rule)
+                    break;
+                heap[pos] = heap[child];
+                pos = child;
+            }
+            heap[pos] = idx;
+        }
+        int winner = nheap > 0 ? (int)spans[heap[0]].rule : -1;
+        if (winner >= 0)
+            hit[winner] = 1;
+        if (winner == last){
+            acl->ranges[acl->nranges - 1].addr_end = (uint32_t)(points[k + 1] - 1);
+            continue;
+        }
+        acl->ranges[acl->nranges].addr_start = (uint32_t)p;
+        acl->ranges[acl->nranges].addr_end = (uint32_t)(points[k + 1] - 1);
+        acl->ranges[acl->nranges].rule = winner;
+        acl->nranges++;
+        last = winner;
+    }
+    acl->nshadowed = 0;
+    for (uint32_t i=0; i<nrules; ++i)
+        if (!hit[i])
+            acl->shadowed[acl->nshadowed++] = i;
+    ret = 0;
+done:
+    free(points);
+    free(spans);
+    free(heap);
+    free(hit);
+    return ret;
+}
+
+static int64_t cipv4_acl_new_chunk(cipv4_acl * acl, uint32_t * capacity){
+    if (acl->nchunks == *capacity){
+        uint32_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+        uint32_t * new_memory = (uint32_t*) realloc(acl->chunks, (size_t)new_capacity * 256 * sizeof(uint32_t));
+        if (!new_memory)
+            return -1;
+        acl->chunks = new_memory;
+        *capacity = new_capacity;
+    }
+    return acl->nchunks++;
+}
+
+// fill the 16-8-8 trie from the disjoint ranges. A slot gets a
+// chunk of the next level only when more than one range touches it.
+static int cipv4_acl_build_table(cipv4_acl * acl){
+    uint32_t capacity = 0;
+    uint32_t r = 0;
+    cipv4_acl_range * ranges = acl->ranges;
+    acl->tbl16 = (uint32_t*) malloc(65536 * sizeof(uint32_t));
+    if (!acl->tbl16)
+        return -1;
+    for (uint32_t s=0; s<65536; ++s){
+        uint32_t lo = s << 16;
+        while (ranges[r].addr_end < lo)
+            r++;
+        if (ranges[r].addr_end >= (lo | 0xFFFF)){
+            acl->tbl16[s] = (uint32_t)(ranges[r].rule + 1);
+            continue;
+        }
+        int64_t c2 = cipv4_acl_new_chunk(acl, &capacity);
+        if (c2 < 0)
+            return -1;
+        acl->tbl16[s] = CIPV4_ACL_CHUNK | (uint32_t)c2;
+        for (uint32_t t=0; t<256; ++t){
+            uint32_t lo2 = lo | (t << 8);
+            while (ranges[r].addr_end < lo2)
+                r++;
+            if (ranges[r].addr_end >= (lo2 | 0xFF)){
+                acl->chunks[(c2 << 8) | t] = (uint32_t)(ranges[r].rule + 1);
+                continue;
+            }
+            int64_t c3 = cipv4_acl_new_chunk(acl, &capacity);
+            if (c3 < 0)
+                return -1;
+            acl->chunks[(c2 << 8) | t] = CIPV4_ACL_CHUNK | (uint32_t)c3;
+            for (uint32_t u=0; u<256; ++u){
+                while (ranges[r].addr_end < (lo2 | u))
+                    r++;
+                acl->chunks[(c3 << 8) | u] = (uint32_t)(ranges[r].rule + 1);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+/// @file cipv4_anon.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cipv4_anon.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <wmmintrin.h>
+#define CIPV4_ANON_X86 1
+#endif
+
+
+#define CIPV4_ANON_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void cipv4_anon_tables(cipv4_anon * anon);
+static void cipv4_anon_expand_key(cipv4_anon * anon, const uint8_t * key);
+static uint32_t cipv4_anon_soft_round(const cipv4_anon * anon, uint32_t * s);
+static uint32_t cipv4_anon_msb(const cipv4_anon * anon, uint32_t first);
+static uint32_t cipv4_anon_soft(const cipv4_anon * anon, uint32_t addr);
+#ifdef CIPV4_ANON_X86
+static uint32_t cipv4_anon_msb_aesni(const cipv4_anon * anon, uint32_t first);
+static void cipv4_anon_batch_aesni(const cipv4_anon * anon, const uint32_t * addrs, uint32_t * out, size_t n);
+#endif
+
+
+/**
+ * @brief Create a prefix-preserving anonymizer (Crypto-PAn)
+ * @param key Secret of CIPV4_ANON_KEY_LENGTH (32) bytes: the first half is
+ * the AES-128 key and the second half is encrypted to make the pad.
+ * @return A pointer to the anonymizer or NULL in case of error.
+ *
+ * Two addresses sharing their first k bits are mapped to two addresses
+ * sharing exactly their first k bits, so subnets stay subnets. The same
+ * key always gives the same mapping (compatible with the original
+ * Crypto-PAn implementation). AES-NI is used when the CPU supports it.
+ *
+ * @code
+ *    cipv4_anon * anon = cipv4_anon_new(key);
+ *    uint32_t addr = cipv4_anon_addr(anon, cipv4_str_to_uint("10.1.2.3"));
+ *    cipv4_anon_batch(anon, addrs, addrs, n);     // in place
+ *    cipv4_anon_free(anon);
+ * @endcode
+ */
+cipv4_anon * cipv4_anon_new(const uint8_t * key){
+    if (!key)
+        return NULL;
+    cipv4_anon * anon = (cipv4_anon*) calloc(1, sizeof(cipv4_anon));
+    uint8_t * level = (uint8_t*) malloc(1 << CIPV4_ANON_CACHE_BITS);
+    if (!anon || !level){
+        free(anon);
+        free(level);
+        return NULL;
+    }
+#ifdef CIPV4_ANON_X86
+    anon->aesni = __builtin_cpu_supports("aes") ? 1 : 0;
+#endif
+    cipv4_anon_tables(anon);
+    cipv4_anon_expand_key(anon, key);
+    cipv4_anon_encrypt_block(anon, key + 16, anon->pad);
+    anon->pad32 = (uint32_t)anon->pad[0] << 24 | (uint32_t)anon->pad[1] << 16 | (uint32_t)anon->pad[2] << 8 | anon->pad[3];
+    // bit i of the pad only depends on the first i bits of the address:
+    // level[(1 << i) + prefix] for every prefix of the first 16 bits
+    for (int pos=0; pos<CIPV4_ANON_CACHE_BITS; ++pos){
+        uint32_t keep = pos == 0 ? 0 : 0xFFFFFFFFu << (32 - pos);
+        for (uint32_t v=0; v<(1u << pos); ++v){
+            uint32_t prefix = pos == 0 ? 0 : v << (32 - pos);
+            level[(1u << pos) + v] = (uint8_t)cipv4_anon_msb(anon, prefix | (anon->pad32 & ~keep));
+        }
+    }
+    for (uint32_t p=0; p<(1u << CIPV4_ANON_CACHE_BITS); ++p){
+        uint32_t bits = 0;
+        for (int pos=0; pos<CIPV4_ANON_CACHE_BITS; ++pos)
+            bits |= (uint32_t)level[(1u << pos) + (p >> (CIPV4_ANON_CACHE_BITS - pos))] << (CIPV4_ANON_CACHE_BITS - 1 - pos);
+        anon->cache[p] = (uint16_t)bits;
+    }
+    free(level);
+    return anon;
+}
+
+/**
+ * @brief Free the anonymizer
+ * @param anon The anonymizer returned by cipv4_anon_new() (can be NULL)
+ * @return nothing
+ */
+void cipv4_anon_free(cipv4_anon * anon){
+    free(anon);
+}
+
+/**
+ * @brief Anonymize one address
+ * @param anon The anonymizer returned by cipv4_anon_new()
+ * @param addr IP address in a form of 32-bit integer
+ * @return The anonymized address.
+ */
+uint32_t cipv4_anon_addr(const cipv4_anon * anon, uint32_t addr){
+#ifdef CIPV4_ANON_X86
+    if (anon->aesni){
+        uint32_t out;
+        cipv4_anon_batch_aesni(anon, &addr, &out, 1);
+        return out;
+    }
+#endif
+    return cipv4_anon_soft(anon, addr);
+}
+
+/**
+ * @brief Anonymize an array of addresses
+ * @param anon The anonymizer returned by cipv4_anon_new()
+ * @param addrs Array of IP addresses in a form of 32-bit integer
+ * @param out Output array of n elements (can be the same as addrs)
+ * @param n Number of addresses
+ * @return nothing
+ *
+ * The first 16 bits come from the cache, the remaining 16 bits need
+ * one AES block each. With AES-NI the 16 blocks of an address are
+ * independent and are encrypted in parallel.
+ */
+void cipv4_anon_batch(const cipv4_anon * anon, const uint32_t * addrs, uint32_t * out, size_t n){
+#ifdef CIPV4_ANON_X86
+    if (anon->aesni){
+        cipv4_anon_batch_aesni(anon, addrs, out, n);
+        return;
+    }
+#endif
+    for (size_t i=0; i<n; ++i)
+        out[i] = cipv4_anon_soft(anon, addrs[i]);
+}
+
+/**
+ * @brief Encrypt one block with the AES-128 key of the anonymizer
+ * @param anon The anonymizer returned by cipv4_anon_new()
+ * @param in 16 bytes of plaintext
+ * @param out 16 bytes to receive the ciphertext (can be the same as in)
+ * @return nothing
+ *
+ * Portable implementation, used to derive the pad and as the fallback
+ * when AES-NI is not available.
+ */
+void cipv4_anon_encrypt_block(const cipv4_anon * anon, const uint8_t * in, uint8_t * out){
+    uint32_t s[4];
+    for (int i=0; i<4; ++i)
+        s[i] = ((uint32_t)in[4 * i] << 24 | (uint32_t)in[4 * i + 1] << 16 | (uint32_t)in[4 * i + 2] << 8 | in[4 * i + 3]) ^ anon->rk[i];
+    cipv4_anon_soft_round(anon, s);
+    for (int i=0; i<4; ++i){
+        out[4 * i] = (uint8_t)(s[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(s[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(s[i] >> 8);
+        out[4 * i + 3] = (uint8_t)s[i];
+    }
+}
+
+
+// S-box from the inverse in GF(2^8) and the affine transform, T-table
+// for the combined SubBytes + MixColumns of one column
+static void cipv4_anon_tables(cipv4_anon * anon){
+    uint8_t p = 1, q = 1;
+    do{
+        p = (uint8_t)(p ^ (p << 1) ^ (p & 0x80 ? 0x1B : 0));
+        q ^= (uint8_t)(q << 1);
+        q ^= (uint8_t)(q << 2);
+        q ^= (uint8_t)(q << 4);
+        if (q & 0x80)
+            q ^= 0x09;
+        uint8_t x = (uint8_t)(q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4));
+        anon->sbox[p] = (uint8_t)(x ^ 0x63);
+    }while (p != 1);
+    anon->sbox[0] = 0x63;
+    for (int i=0; i<256; ++i){
+        uint32_t s = anon->sbox[i];
+        uint32_t s2 = ((s << 1) ^ (s & 0x80 ? 0x1B : 0)) & 0xFF;
+        anon->te[i] = s2 << 24 | s << 16 | s << 8 | (s2 ^ s);
+    }
+}
+
+static void cipv4_anon_expand_key(cipv4_anon * anon, const uint8_t * key){
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+    for (int i=0; i<4; ++i)
+        anon->rk[i] = (uint32_t)key[4 * i] << 24 | (uint32_t)key[4 * i + 1] << 16 | (uint32_t)key[4 * i + 2] << 8 | key[4 * i + 3];
+    for (int i=4; i<44; ++i){
+        uint32_t t = anon->rk[i - 1];
+        if (i % 4 == 0){
+            t = (uint32_t)anon->sbox[(t >> 16) & 0xFF] << 24 | (uint32_t)anon->sbox[(t >> 8) & 0xFF] << 16 |
+                (uint32_t)anon->sbox[t & 0xFF] << 8 | anon->sbox[t >> 24];
+            t ^= (uint32_t)rcon[i / 4 - 1] << 24;
+        }
+        anon->rk[i] = anon->rk[i - 4] ^ t;
+    }
+    for (int i=0; i<44; ++i){
+        anon->rk_bytes[4 * i] = (uint8_t)(anon->rk[i] >> 24);
+        anon->rk_bytes[4 * i + 1] = (uint8_t)(anon->rk[i] >> 16);
+        anon->rk_bytes[4 * i + 2] = (uint8_t)(anon->rk[i] >> 8);
+        anon->rk_bytes[4 * i + 3] = (uint8_t)anon->rk[i];
+    }
+}
+
+// rounds 1~10 on a state which already has the first round key,
+// returns the first byte of the ciphertext
+static uint32_t cipv4_anon_soft_round(const cipv4_anon * anon, uint32_t * s){
+    const uint32_t * te = anon->te;
+    const uint8_t * sbox = anon->sbox;
+    uint32_t t[4];
+    for (int r=1; r<10; ++r){
+        for (int c=0; c<4; ++c)
+            t[c] = te[s[c] >> 24] ^ CIPV4_ANON_ROR(te[(s[(c + 1) & 3] >> 16) & 0xFF], 8) ^
+                   CIPV4_ANON_ROR(te[(s[(c + 2) & 3] >> 8) & 0xFF], 16) ^
+                   CIPV4_ANON_ROR(te[s[(c + 3) & 3] & 0xFF], 24) ^ anon->rk[4 * r + c];
+        memcpy(s, t, sizeof(t));
+    }
+    for (int c=0; c<4; ++c)
+        t[c] = ((uint32_t)sbox[s[c] >> 24] << 24 | (uint32_t)sbox[(s[(c + 1) & 3] >> 16) & 0xFF] << 16 |
+                (uint32_t)sbox[(s[(c + 2) & 3] >> 8) & 0xFF] << 8 | sbox[s[(c + 3) & 3] & 0xFF]) ^ anon->rk[40 + c];
+    memcpy(s, t, sizeof(t));
+    return s[0] >> 24;
+}
+
+// first bit of AES(pad with its first 4 bytes replaced by `first`)
+static uint32_t cipv4_anon_msb(const cipv4_anon * anon, uint32_t first){
+#ifdef CIPV4_ANON_X86
+    if (anon->aesni)
+        return cipv4_anon_msb_aesni(anon, first);
+#endif
+    uint32_t s[4];
+    s[0] = first ^ anon->rk[0];
+    for (int i=1; i<4; ++i)
+        s[i] = ((uint32_t)anon->pad[4 * i] << 24 | (uint32_t)anon->pad[4 * i + 1] << 16 |
+                (uint32_t)anon->pad[4 * i + 2] << 8 | anon->pad[4 * i + 3]) ^ anon->rk[i];
+    return cipv4_anon_soft_round(anon, s) >> 7;
+}
+
+static uint32_t cipv4_anon_soft(const cipv4_anon * anon, uint32_t addr){
+    uint32_t bits = 0;
+    for (int pos=CIPV4_ANON_CACHE_BITS; pos<32; ++pos){
+        uint32_t keep = 0xFFFFFFFFu << (32 - pos);
+        bits |= cipv4_anon_msb(anon, (addr & keep) | (anon->pad32 & ~keep)) << (31 - pos);
+    }
+    return addr ^ ((uint32_t)anon->cache[addr >> 16] << 16 | bits);
+}
+
+#ifdef CIPV4_ANON_X86
+
+__attribute__((target("aes,sse2")))
+static uint32_t cipv4_anon_msb_aesni(const cipv4_anon * anon, uint32_t first){
+    __m128i b = _mm_loadu_si128((const __m128i*)anon->pad);
+    b = _mm_and_si128(b, _mm_set_epi32(-1, -1, -1, 0));
+    b = _mm_or_si128(b, _mm_cvtsi32_si128((int)__builtin_bswap32(first)));
+    b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i*)anon->rk_bytes));
+    for (int r=1; r<10; ++r)
+        b = _mm_aesenc_si128(b, _mm_loadu_si128((const __m128i*)(anon->rk_bytes + 16 * r)));
+    b = _mm_aesenclast_si128(b, _mm_loadu_si128((const __m128i*)(anon->rk_bytes + 160)));
+    return (uint32_t)_mm_movemask_epi8(b) & 1;
+}
+
+// 8 blocks in flight hide the latency of aesenc
+__attribute__((target("aes,sse2")))
+static void cipv4_anon_batch_aesni(const cipv4_anon * anon, const uint32_t * addrs, uint32_t * out, size_t n){
+    __m128i rk[11];
+    for (int r=0; r<11; ++r)
+        rk[r] = _mm_loadu_si128((const __m128i*)(anon->rk_bytes + 16 * r));
+    __m128i pad = _mm_and_si128(_mm_loadu_si128((const __m128i*)anon->pad), _mm_set_epi32(-1, -1, -1, 0));
+    for (size_t i=0; i<n; ++i){
+        uint32_t addr = addrs[i];
+        uint32_t bits = 0;
+        for (int half=0; half<2; ++half){
+            __m128i b[8];
+            for (int j=0; j<8; ++j){
+                int pos = CIPV4_ANON_CACHE_BITS + 8 * half + j;
+                uint32_t keep = 0xFFFFFFFFu << (32 - pos);
+                uint32_t first = (addr & keep) | (anon->pad32 & ~keep);
+                b[j] = _mm_xor_si128(_mm_or_si128(pad, _mm_cvtsi32_si128((int)__builtin_bswap32(first))), rk[0]);
+            }
+            for (int r=1; r<10; ++r)
+                for (int j=0; j<8; ++j)
+                    b[j] = _mm_aesenc_si128(b[j], rk[r]);
+            for (int j=0; j<8; ++j){
+                b[j] = _mm_aesenclast_si128(b[j], rk[10]);
+                bits |= ((uint32_t)_mm_movemask_epi8(b[j]) & 1) << (15 - 8 * half - j);
+            }
+        }
+        out[i] = addr ^ ((uint32_t)anon->cache[addr >> 16] << 16 | bits);
+    }
+}
+
+#endif
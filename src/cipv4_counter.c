@@ -0,0 +1,233 @@
+/// @file cipv4_counter.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <cipv4_counter.h>
+
+
+/**
+ * @brief Create the hit counters
+ * @param nkeys Number of keys, valid keys are 0~nkeys-1
+ * @param nshards Number of shards (usually one per thread)
+ * @return A pointer to the counters or NULL in case of error.
+ *
+ * Keys are usually the payload of a lookup table, for example the
+ * rule index returned by cipv4_acl_match().
+ *
+ * @code
+ *    cipv4_counter * counter = cipv4_counter_new(acl->nrules, nthreads);
+ *    // in thread i
+ *    cipv4_counter_shard * shard = cipv4_counter_get_shard(counter, i);
+ *    cipv4_counter_add(shard, cipv4_acl_match(acl, addr), 1);
+ *    // in the reporting thread
+ *    cipv4_counter_totals * totals = cipv4_counter_snapshot(counter);
+ *    uint32_t top[10];
+ *    uint32_t n = cipv4_counter_top(totals, 10, 1, top);
+ *    cipv4_counter_totals_free(totals);
+ * @endcode
+ */
+cipv4_counter * cipv4_counter_new(uint32_t nkeys, int nshards){
+    if (nkeys == 0 || nshards <= 0)
+        return NULL;
+    cipv4_counter * counter = (cipv4_counter*) calloc(1, sizeof(cipv4_counter));
+    if (!counter)
+        return NULL;
+    counter->nkeys = nkeys;
+    counter->shards = (cipv4_counter_shard*) calloc(nshards, sizeof(cipv4_counter_shard));
+    counter->last = (uint64_t*) calloc(nkeys, sizeof(uint64_t));
+    if (!counter->shards || !counter->last){
+        cipv4_counter_free(counter);
+        return NULL;
+    }
+    counter->nshards = nshards;
+    // round up to whole cache lines so two shards never share a line
+    size_t size = (size_t)nkeys * sizeof(uint64_t);
+    size = (size + CIPV4_CACHE_LINE - 1) / CIPV4_CACHE_LINE * CIPV4_CACHE_LINE;
+    for (int i=0; i<nshards; ++i){
+        counter->shards[i].nkeys = nkeys;
+        counter->shards[i].counts = (_Atomic uint64_t*) aligned_alloc(CIPV4_CACHE_LINE, size);
+        if (!counter->shards[i].counts){
+            cipv4_counter_free(counter);
+            return NULL;
+        }
+        for (uint32_t k=0; k<nkeys; ++k)
+            atomic_init(&counter->shards[i].counts[k], 0);
+    }
+    return counter;
+}
+
+/**
+ * @brief Free the memory allocated by cipv4_counter_new()
+ * @param counter The counters (can be NULL)
+ * @return nothing
+ */
+void cipv4_counter_free(cipv4_counter * counter){
+    if (!counter)
+        return;
+    if (counter->shards)
+        for (int i=0; i<counter->nshards; ++i)
+            free(counter->shards[i].counts);
+    free(counter->shards);
+    free(counter->last);
+    free(counter);
+}
+
+/**
+ * @brief Returns the shard of a thread
+ * @param counter The counters returned by cipv4_counter_new()
+ * @param shard Shard number between 0~nshards-1
+ * @return A pointer to the shard or NULL if the number is not valid.
+ *
+ * A shard must only be updated by one thread at a time.
+ */
+cipv4_counter_shard * cipv4_counter_get_shard(cipv4_counter * counter, int shard){
+    if (!counter || shard < 0 || shard >= counter->nshards)
+        return NULL;
+    return &counter->shards[shard];
+}
+
+/**
+ * @brief Add hits to a key
+ * @param shard Shard of the calling thread returned by cipv4_counter_get_shard()
+ * @param key The key, negative keys (no match) and keys >= nkeys are ignored
+ * @param count Number of hits to add
+ * @return nothing
+ *
+ * The shard is owned by the caller so the update is a relaxed load and
+ * store, there is no locked read-modify-write instruction.
+ */
+void cipv4_counter_add(cipv4_counter_shard * shard, int key, uint64_t count){
+    if (key < 0 || (uint32_t)key >= shard->nkeys)
+        return;
+    _Atomic uint64_t * c = &shard->counts[key];
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + count, memory_order_relaxed);
+}
+
+/**
+ * @brief Add one hit to every key of an array
+ * @param shard Shard of the calling thread returned by cipv4_counter_get_shard()
+ * @param keys Array of keys (e.g. results of cipv4_acl_match())
+ * @param n Number of elements in the array
+ * @return nothing
+ */
+void cipv4_counter_add_batch(cipv4_counter_shard * shard, const int * keys, size_t n){
+    for (size_t i=0; i<n; ++i)
+        cipv4_counter_add(shard, keys[i], 1);
+}
+
+/**
+ * @brief Merge all the shards
+ * @param counter The counters returned by cipv4_counter_new()
+ * @return A pointer to the merged counters (must be freed by
+ * cipv4_counter_totals_free()) or NULL in case of error.
+ *
+ * The window counts are the hits since the previous call, so calling
+ * this function periodically gives the per window counts. Only one thread
+ * should take snapshots. Shards are read while they are updated, a hit
+ * which is not visible yet is reported by the next snapshot.
+ */
+cipv4_counter_totals * cipv4_counter_snapshot(cipv4_counter * counter){
+    if (!counter)
+        return NULL;
+    cipv4_counter_totals * totals = (cipv4_counter_totals*) malloc(sizeof(cipv4_counter_totals));
+    if (!totals)
+        return NULL;
+    totals->nkeys = counter->nkeys;
+    totals->total = (uint64_t*) calloc(counter->nkeys, sizeof(uint64_t));
+    totals->window = (uint64_t*) malloc(counter->nkeys * sizeof(uint64_t));
+    if (!totals->total || !totals->window){
+        cipv4_counter_totals_free(totals);
+        return NULL;
+    }
+    for (int i=0; i<counter->nshards; ++i){
+        _Atomic uint64_t * counts = counter->shards[i].counts;
+        for (uint32_t k=0; k<counter->nkeys; ++k)
+            totals->total[k] += atomic_load_explicit(&counts[k], memory_order_relaxed);
+    }
+    for (uint32_t k=0; k<counter->nkeys; ++k){
+        totals->window[k] = totals->total[k] - counter->last[k];
+        counter->last[k] = totals->total[k];
+    }
+    return totals;
+}
+
+/**
+ * @brief Free the memory allocated by cipv4_counter_snapshot()
+ * @param totals The merged counters (can be NULL)
+ * @return nothing
+ */
+void cipv4_counter_totals_free(cipv4_counter_totals * totals){
+    if (!totals)
+        return;
+    free(totals->total);
+    free(totals->window);
+    free(totals);
+}
+
+/**
+ * @brief Find the keys with the most hits
+ * @param totals The merged counters returned by cipv4_counter_snapshot()
+ * @param n Maximum number of keys to return
+ * @param by_window 1 to rank by the window counts, 0 to rank by the totals
+ * @param keys User-provided array of n elements to receive the keys
+ * @return The number of keys written to `keys` (keys without hits are
+ * skipped), sorted by hits in descending order.
+ */
+uint32_t cipv4_counter_top(const cipv4_counter_totals * totals, uint32_t n, int by_window, uint32_t * keys){
+    if (!totals || !keys || n == 0)
+        return 0;
+    const uint64_t * hits = by_window ? totals->window : totals->total;
+    // keys[0..size) is a min-heap on hits, the root is the weakest of the top n
+    uint32_t size = 0;
+    for (uint32_t k=0; k<totals->nkeys; ++k){
+        if (hits[k] == 0)
+            continue;
+        uint32_t pos;
+        if (size < n){
+            pos = size++;
+            while (pos > 0 && hits[keys[(pos - 1) / 2]] > hits[k]){
+                keys[pos] = keys[(pos - 1) / 2];
+                pos = (pos - 1) / 2;
+            }
+            keys[pos] = k;
+            continue;
+        }
+        if (hits[k] <= hits[keys[0]])
+            continue;
+        pos = 0;
+        for (;;){
+            uint32_t child = 2 * pos + 1;
+            if (child >= size)
+                break;
+            if (child + 1 < size && hits[keys[child + 1]] < hits[keys[child]])
+                child++;
+            if (hits[keys[child]] >= hits[k])
+                break;
+            keys[pos] = keys[child];
+            pos = child;
+        }
+        keys[pos] = k;
+    }
+    // heap sort in place: repeatedly move the smallest to the end
+    for (uint32_t end=size; end>1; --end){
+        uint32_t smallest = keys[0];
+        uint32_t last = keys[end - 1];
+        uint32_t pos = 0;
+        for (;;){
+            uint32_t child = 2 * pos + 1;
+            if (child >= end - 1)
+                break;
+            if (child + 1 < end - 1 && hits[keys[child + 1]] < hits[keys[child]])
+                child++;
+            if (hits[keys[child]] >= hits[last])
+                break;
+            keys[pos] = keys[child];
+            pos = child;
+        }
+        keys[pos] = last;
+        keys[end - 1] = smallest;
+    }
+    return size;
+}
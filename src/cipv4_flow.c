@@ -0,0 +1,194 @@
+/// @file cipv4_flow.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cipv4_flow.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CIPV4_FLOW_X86 1
+#endif
+
+
+#define CIPV4_FLOW_ADDR(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+#define CIPV4_FLOW_MASK(prefix) (0xFFFFFFFFu << (32 - (prefix)))
+#define CIPV4_FLOW_RANGES 17
+#define CIPV4_FLOW_PREFETCH 4       // blocks ahead
+
+typedef struct _cipv4_flow_range cipv4_flow_range;
+struct _cipv4_flow_range{
+    uint32_t addr;
+    uint32_t mask;
+    uint32_t classes;
+};
+
+// the private networks which are also in another list of cipv4.c
+#define CIPV4_FLOW_ALSO(a, b, c, d, prefix, a2, b2, c2, d2, prefix2, class) \
+    (CIPV4_FLOW_ADDR(a, b, c, d) == CIPV4_FLOW_ADDR(a2, b2, c2, d2) && (prefix) == (prefix2) ? (class) : 0)
+#define CIPV4_FLOW_PRIVATE(a, b, c, d, prefix)                                          \
+    {CIPV4_FLOW_ADDR(a, b, c, d), CIPV4_FLOW_MASK(prefix), CIPV4_CLASS_PRIVATE |        \
+     CIPV4_FLOW_ALSO(a, b, c, d, prefix, 127, 0, 0, 0, 8, CIPV4_CLASS_LOOPBACK) |       \
+     CIPV4_FLOW_ALSO(a, b, c, d, prefix, 240, 0, 0, 0, 4, CIPV4_CLASS_RESERVED) |       \
+     CIPV4_FLOW_ALSO(a, b, c, d, prefix, 169, 254, 0, 0, 16, CIPV4_CLASS_LINKLOCAL)},
+
+// same networks as the lists of cipv4.c, a network present in several
+// lists is written once with all its classes
+static const cipv4_flow_range _cipv4_flow_ranges[CIPV4_FLOW_RANGES] = {
+    CIPV4_PRIVATE_NETWORKS(CIPV4_FLOW_PRIVATE)
+    {CIPV4_FLOW_ADDR(100, 64, 0, 0), CIPV4_FLOW_MASK(10), CIPV4_CLASS_PUBLIC_NETWORK},
+    {CIPV4_FLOW_ADDR(224, 0, 0, 0), CIPV4_FLOW_MASK(4), CIPV4_CLASS_MULTICAST},
+    {CIPV4_FLOW_ADDR(0, 0, 0, 0), CIPV4_FLOW_MASK(32), CIPV4_CLASS_UNSPECIFIED},
+};
+
+static uint32_t cipv4_flow_load(const unsigned char * p);
+static void cipv4_flow_block_scalar(const unsigned char * base, size_t stride, uint32_t * addrs, uint8_t * classes);
+#ifdef CIPV4_FLOW_X86
+static void cipv4_flow_block_avx2(const unsigned char * base, size_t stride, uint32_t * addrs, uint8_t * classes);
+#endif
+
+
+/**
+ * @brief Classify one address without parsing
+ * @param addr IP address in a form of 32-bit integer (host byte order)
+ * @return CIPV4_CLASS_* bits of every special range containing the address
+ * (CIPV4_CLASS_GLOBAL if neither private nor public network).
+ *
+ * @code
+ *    // prints 9 (CIPV4_CLASS_PRIVATE | CIPV4_CLASS_LOOPBACK)
+ *    fprintf(stdout, "%d\n", cipv4_flow_class(cipv4_str_to_uint("127.0.0.1")));
+ * @endcode
+ */
+uint8_t cipv4_flow_class(uint32_t addr){
+    uint32_t classes = 0;
+    for (int r=0; r<CIPV4_FLOW_RANGES; ++r)
+        if ((addr & _cipv4_flow_ranges[r].mask) == _cipv4_flow_ranges[r].addr)
+            classes |= _cipv4_flow_ranges[r].classes;
+    if (!(classes & (CIPV4_CLASS_PRIVATE | CIPV4_CLASS_PUBLIC_NETWORK)))
+        classes |= CIPV4_CLASS_GLOBAL;
+    return (uint8_t)classes;
+}
+
+/**
+ * @brief List the special networks of some classes
+ * @param classes CIPV4_CLASS_* bits (CIPV4_CLASS_GLOBAL is not a list of
+ * networks and is ignored)
+ * @param nets User-provided array to receive the networks
+ * @param max Size of the array
+ * @return Number of networks written to the array. Every address with
+ * one of the classes is in one of them.
+ */
+int cipv4_flow_ranges(uint8_t classes, cipv4_net * nets, int max){
+    int n = 0;
+    for (int r=0; r<CIPV4_FLOW_RANGES && n<max; ++r){
+        if (!(_cipv4_flow_ranges[r].classes & classes))
+            continue;
+        nets[n].addr_start = _cipv4_flow_ranges[r].addr;
+        nets[n].network_prefix = (uint8_t)(32 - __builtin_popcount(~_cipv4_flow_ranges[r].mask));
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Byte-swap, classify and look up addresses of binary records in one pass
+ * @param base Address of the first field, e.g. &records[0].src_addr
+ * @param stride Distance in bytes between two fields (sizeof(record)),
+ * at least 4. Fields do not need to be aligned.
+ * @param n Number of fields
+ * @param acl Compiled ACL used as the prefix table or NULL
+ * @param addrs Output array of n addresses in host byte order or NULL
+ * @param classes Output array of n CIPV4_CLASS_* bits or NULL
+ * @param rules Output array of n cipv4_acl_match() results or NULL
+ * (ignored if acl is NULL)
+ * @return 0 in case of success or -1 for wrong arguments.
+ *
+ * Fields are 4-byte IPv4 addresses in network byte order, as found in
+ * packet headers and flow records. They are processed in blocks of
+ * CIPV4_FLOW_BLOCK: the block is byte-swapped and compared with every
+ * special range in vector registers (AVX2 when the CPU supports it),
+ * then looked up in the ACL while it is still in L1, so the input is
+ * read once.
+ */
+int cipv4_flow_classify(const void * base, size_t stride, size_t n, const cipv4_acl * acl,
+                        uint32_t * addrs, uint8_t * classes, int * rules){
+    if ((!base && n > 0) || stride < 4)
+        return -1;
+    const unsigned char * p = (const unsigned char*) base;
+#ifdef CIPV4_FLOW_X86
+    int avx2 = __builtin_cpu_supports("avx2");
+#endif
+    uint32_t block[CIPV4_FLOW_BLOCK];
+    uint8_t block_classes[CIPV4_FLOW_BLOCK];
+    for (size_t i=0; i<n; i+=CIPV4_FLOW_BLOCK){
+        size_t count = n - i < CIPV4_FLOW_BLOCK ? n - i : CIPV4_FLOW_BLOCK;
+        const unsigned char * q = p + i * stride;
+        if (i + (CIPV4_FLOW_PREFETCH + 1) * CIPV4_FLOW_BLOCK <= n)
+            __builtin_prefetch(q + CIPV4_FLOW_PREFETCH * CIPV4_FLOW_BLOCK * stride);
+        if (count < CIPV4_FLOW_BLOCK){
+            for (size_t j=0; j<count; ++j){
+                block[j] = cipv4_flow_load(q + j * stride);
+                block_classes[j] = cipv4_flow_class(block[j]);
+            }
+        }
+#ifdef CIPV4_FLOW_X86
+        else if (avx2)
+            cipv4_flow_block_avx2(q, stride, block, block_classes);
+#endif
+        else
+            cipv4_flow_block_scalar(q, stride, block, block_classes);
+        if (addrs)
+            memcpy(addrs + i, block, count * sizeof(uint32_t));
+        if (classes)
+            memcpy(classes + i, block_classes, count);
+        if (acl && rules)
+            for (size_t j=0; j<count; ++j)
+                rules[i + j] = cipv4_acl_match(acl, block[j]);
+    }
+    return 0;
+}
+
+
+// unaligned big-endian load
+static uint32_t cipv4_flow_load(const unsigned char * p){
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void cipv4_flow_block_scalar(const unsigned char * base, size_t stride, uint32_t * addrs, uint8_t * classes){
+    for (int j=0; j<CIPV4_FLOW_BLOCK; ++j){
+        addrs[j] = cipv4_flow_load(base + j * stride);
+        classes[j] = cipv4_flow_class(addrs[j]);
+    }
+}
+
+#ifdef CIPV4_FLOW_X86
+
+__attribute__((target("avx2")))
+static void cipv4_flow_block_avx2(const unsigned char * base, size_t stride, uint32_t * addrs, uint8_t * classes){
+    uint32_t raw[CIPV4_FLOW_BLOCK];
+    for (int j=0; j<CIPV4_FLOW_BLOCK; ++j)
+        memcpy(&raw[j], base + j * stride, sizeof(uint32_t));
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)raw), bswap);
+    _mm256_storeu_si256((__m256i*)addrs, a);
+    __m256i c = _mm256_setzero_si256();
+    for (int r=0; r<CIPV4_FLOW_RANGES; ++r){
+        __m256i in = _mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32((int)_cipv4_flow_ranges[r].mask)),
+                                        _mm256_set1_epi32((int)_cipv4_flow_ranges[r].addr));
+        c = _mm256_or_si256(c, _mm256_and_si256(in, _mm256_set1_epi32((int)_cipv4_flow_ranges[r].classes)));
+    }
+    __m256i special = _mm256_and_si256(c, _mm256_set1_epi32(CIPV4_CLASS_PRIVATE | CIPV4_CLASS_PUBLIC_NETWORK));
+    __m256i global = _mm256_cmpeq_epi32(special, _mm256_setzero_si256());
+    c = _mm256_or_si256(c, _mm256_and_si256(global, _mm256_set1_epi32(CIPV4_CLASS_GLOBAL)));
+    // keep the low byte of every lane
+    const __m256i narrow = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    c = _mm256_shuffle_epi8(c, narrow);
+    uint32_t lo = (uint32_t)_mm256_extract_epi32(c, 0);
+    uint32_t hi = (uint32_t)_mm256_extract_epi32(c, 4);
+    memcpy(classes, &lo, sizeof(uint32_t));
+    memcpy(classes + 4, &hi, sizeof(uint32_t));
+}
+
+#endif
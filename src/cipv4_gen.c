@@ -0,0 +1,446 @@
+/// @file cipv4_gen.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <cipv4_gen.h>
+#include <cipv4_flow.h>
+#include <cipv4_net.h>
+
+
+#define CIPV4_GEN_MAX_THREADS 64
+#define CIPV4_GEN_PARALLEL_MIN 4096     // records per thread
+#define CIPV4_GEN_MAX_EXCLUDED 32
+#define CIPV4_GEN_GOLDEN 0x9E3779B97F4A7C15ULL
+
+typedef struct _cipv4_gen_job cipv4_gen_job;
+struct _cipv4_gen_job{
+    const cipv4_gen * gen;
+    uint64_t first;
+    size_t n;
+    uint32_t * addrs;           // binary output or NULL
+    char * text;                // text output or NULL
+    size_t length;              // bytes of text written
+};
+
+static uint64_t cipv4_gen_mix(uint64_t z);
+static int cipv4_gen_split(uint32_t start, int prefix, const cipv4_net * excluded, int nexcluded,
+                           cipv4_net ** pieces, uint32_t * npieces, uint32_t * capacity);
+static int cipv4_gen_alias(cipv4_gen * gen, const double * weights);
+static uint32_t cipv4_gen_draw(const cipv4_gen * gen, uint64_t record);
+static char * cipv4_gen_format(uint32_t addr, char * p);
+static void * cipv4_gen_worker(void * arg);
+static int cipv4_gen_run(const cipv4_gen * gen, uint64_t first, size_t n, uint32_t * addrs, char * text, size_t * length);
+
+
+/**
+ * @brief Set the default options (uniform, nothing excluded, no malformed
+ * records, seed 1, one thread)
+ * @param config The options to initialize
+ * @return nothing
+ */
+void cipv4_gen_config_init(cipv4_gen_config * config){
+    memset(config, 0, sizeof(cipv4_gen_config));
+    config->distribution = CIPV4_GEN_UNIFORM;
+    config->zipf_s = 1.0;
+    config->seed = 1;
+    config->nthreads = 1;
+}
+
+/**
+ * @brief Create an address stream generator
+ * @param nets Networks to draw addresses from, in rank order for Zipf
+ * @param n Number of networks
+ * @param config Options (NULL for the defaults)
+ * @return A pointer to the generator or NULL in case of error (wrong
+ * option, every address excluded or memory allocation failure).
+ *
+ * Record i of the stream only depends on the seed and i, so the output
+ * does not depend on the number of threads and any part of the stream
+ * can be generated again. With CIPV4_GEN_UNIFORM every address of the
+ * set has the same probability (overlapping and duplicate networks are
+ * merged first, cipv4_net_outermost()), with CIPV4_GEN_ZIPF the network at
+ * index k is drawn with a probability proportional to 1/(k+1)^s and the
+ * address uniformly inside it. The excluded ranges are subtracted from
+ * the networks beforehand, so no draw is ever rejected.
+ *
+ * @code
+ *    cipv4_net all = {0, 0};
+ *    cipv4_gen_config config;
+ *    cipv4_gen_config_init(&config);
+ *    config.exclude = CIPV4_CLASS_PRIVATE;     // ranges of cipv4_is_private()
+ *    config.malformed_rate = 0.01;
+ *    cipv4_gen * gen = cipv4_gen_new(&all, 1, &config);
+ *    char * buffer = malloc(1000 * CIPV4_GEN_MAX_LINE);
+ *    long int length = cipv4_gen_text(gen, 0, 1000, buffer);
+ *    fwrite(buffer, 1, length, stdout);
+ *    free(buffer);
+ *    cipv4_gen_free(gen);
+ * @endcode
+ */
+cipv4_gen * cipv4_gen_new(const cipv4_net * nets, uint32_t n, const cipv4_gen_config * config){
+    cipv4_gen_config defaults;
+    if (!config){
+        cipv4_gen_config_init(&defaults);
+        config = &defaults;
+    }
+    if (!nets || n == 0 || (config->distribution != CIPV4_GEN_UNIFORM && config->distribution != CIPV4_GEN_ZIPF)
+            || !(config->malformed_rate >= 0 && config->malformed_rate <= 1) || !(config->zipf_s >= 0))
+        return NULL;
+    for (uint32_t i=0; i<n; ++i)
+        if (nets[i].network_prefix > 32)
+            return NULL;
+    cipv4_net * outermost = NULL;
+    if (config->distribution == CIPV4_GEN_UNIFORM){
+        // an address inside nested networks must not be drawn once per network
+        outermost = (cipv4_net*) malloc(n * sizeof(cipv4_net));
+        long int m = outermost ? cipv4_net_outermost(nets, n, outermost) : -1;
+        if (m <= 0){
+            free(outermost);
+            return NULL;
+        }
+        nets = outermost;
+        n = (uint32_t)m;
+    }
+    cipv4_gen * gen = (cipv4_gen*) calloc(1, sizeof(cipv4_gen));
+    if (!gen){
+        free(outermost);
+        return NULL;
+    }
+    gen->config = *config;
+    gen->key = cipv4_gen_mix(config->seed);
+    cipv4_net excluded[CIPV4_GEN_MAX_EXCLUDED];
+    int nexcluded = cipv4_flow_ranges(config->exclude, excluded, CIPV4_GEN_MAX_EXCLUDED);
+    uint32_t capacity = 0;
+    double * weights = NULL;
+    uint32_t wcapacity = 0;
+    int ret = 0;
+    for (uint32_t i=0; i<n && ret == 0; ++i){
+        uint32_t mask = nets[i].network_prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - nets[i].network_prefix);
+        uint32_t before = gen->npieces;
+        ret = cipv4_gen_split(nets[i].addr_start & mask, nets[i].network_prefix, excluded, nexcluded,
+                              &gen->pieces, &gen->npieces, &capacity);
+        if (ret != 0 || gen->npieces == before)
+            continue;
+        if (wcapacity < capacity){
+            double * new_memory = (double*) realloc(weights, capacity * sizeof(double));
+            if (!new_memory){
+                ret = -1;
+                break;
+            }
+            weights = new_memory;
+            wcapacity = capacity;
+        }
+        // a network keeps its Zipf weight, shared by its pieces by size
+        double left = 0;
+        for (uint32_t p=before; p<gen->npieces; ++p)
+            left += ldexp(1.0, 32 - gen->pieces[p].network_prefix);
+        for (uint32_t p=before; p<gen->npieces; ++p){
+            double size = ldexp(1.0, 32 - gen->pieces[p].network_prefix);
+            weights[p] = config->distribution == CIPV4_GEN_UNIFORM ? size : pow(i + 1.0, -config->zipf_s) * size / left;
+        }
+    }
+    free(outermost);
+    if (ret != 0 || gen->npieces == 0 || cipv4_gen_alias(gen, weights) != 0){
+        free(weights);
+        cipv4_gen_free(gen);
+        return NULL;
+    }
+    free(weights);
+    return gen;
+}
+
+/**
+ * @brief Free the generator
+ * @param gen The generator returned by cipv4_gen_new() (can be NULL)
+ * @return nothing
+ */
+void cipv4_gen_free(cipv4_gen * gen){
+    if (!gen)
+        return;
+    free(gen->pieces);
+    free(gen->threshold);
+    free(gen->alias);
+    free(gen);
+}
+
+/**
+ * @brief Generate records [first, first + n) of the stream as integers
+ * @param gen The generator returned by cipv4_gen_new()
+ * @param first Index of the first record
+ * @param out User-provided array of n elements
+ * @param n Number of records
+ * @return 0 in case of success or -1 in case of error.
+ *
+ * Malformed records are not possible here, out[k] is the address of
+ * record first + k which is also the address written by cipv4_gen_text()
+ * when that record is not malformed.
+ */
+int cipv4_gen_addrs(const cipv4_gen * gen, uint64_t first, uint32_t * out, size_t n){
+    if (!gen || (!out && n > 0))
+        return -1;
+    return cipv4_gen_run(gen, first, n, out, NULL, NULL);
+}
+
+/**
+ * @brief Generate records [first, first + n) of the stream as text lines
+ * @param gen The generator returned by cipv4_gen_new()
+ * @param first Index of the first record
+ * @param n Number of records
+ * @param buffer User-provided buffer of at least n * CIPV4_GEN_MAX_LINE bytes
+ * @return The number of bytes written (one record per line, not null
+ * terminated) or -1 in case of error.
+ */
+long int cipv4_gen_text(const cipv4_gen * gen, uint64_t first, size_t n, char * buffer){
+    if (!gen || (!buffer && n > 0))
+        return -1;
+    size_t length = 0;
+    if (cipv4_gen_run(gen, first, n, NULL, buffer, &length) != 0)
+        return -1;
+    return (long int)length;
+}
+
+/**
+ * @brief Write a malformed address
+ * @param kind One of enum cipv4_gen_malformed
+ * @param random Random bits choosing the content
+ * @param buffer User-provided buffer (CIPV4_GEN_MAX_LINE bytes is enough)
+ * @return A pointer to the buffer or NULL if kind is wrong.
+ *
+ * The string is rejected by cipv4_is_ip_valid() at the check named by
+ * kind: the checks before it pass.
+ */
+char * cipv4_gen_malformed(int kind, uint64_t random, char * buffer){
+    // octets of 2 or 3 digits keep the length between 7~15
+    uint32_t o[4];
+    for (int i=0; i<4; ++i)
+        o[i] = 10 + (uint32_t)((random >> (8 * i)) & 0xFF) % 246;
+    uint32_t extra = (uint32_t)(random >> 32);
+    switch (kind){
+        case CIPV4_GEN_BAD_SHORT:
+            sprintf(buffer, "%u.%u..%u", o[0] % 10, o[1] % 10, o[2] % 10);
+            break;
+        case CIPV4_GEN_BAD_DOTS:
+            if (extra & 1)
+                sprintf(buffer, "%u.%u.%u", o[0], o[1], o[2]);
+            else
+                sprintf(buffer, "%u.%u.%u.%u.%u", o[0] % 10, o[1] % 10, o[2] % 10, o[3] % 10, extra % 10);
+            break;
+        case CIPV4_GEN_BAD_LONG:
+            sprintf(buffer, "%u.%u.%u.%u", 1000 + extra % 9000, 100 + o[1] % 156, 100 + o[2] % 156, 100 + o[3] % 156);
+            break;
+        case CIPV4_GEN_BAD_CHAR:{
+            static const char bad[] = "xa:- ";
+            sprintf(buffer, "%u.%u.%u.%u", o[0], o[1], o[2], o[3]);
+            size_t len = strlen(buffer);
+            size_t pos = extra % len;
+            while (buffer[pos] == DOT)
+                pos = (pos + 1) % len;
+            buffer[pos] = bad[(extra >> 8) % (sizeof(bad) - 1)];
+            break;
+        }
+        case CIPV4_GEN_BAD_ZERO:
+            o[extra % 4] = o[extra % 4] % 100;
+            sprintf(buffer, extra % 4 == 0 ? "0%u.%u.%u.%u" : extra % 4 == 1 ? "%u.0%u.%u.%u" :
+                    extra % 4 == 2 ? "%u.%u.0%u.%u" : "%u.%u.%u.0%u", o[0], o[1], o[2], o[3]);
+            break;
+        case CIPV4_GEN_BAD_EMPTY:
+            sprintf(buffer, extra % 3 == 0 ? ".%u.%u.%u" : extra % 3 == 1 ? "%u..%u.%u" : "%u.%u..%u", o[0], o[1], o[2]);
+            break;
+        case CIPV4_GEN_BAD_RANGE:
+            o[extra % 4] = 256 + (extra >> 2) % 744;
+            sprintf(buffer, "%u.%u.%u.%u", o[0], o[1], o[2], o[3]);
+            break;
+        default:
+            return NULL;
+    }
+    return buffer;
+}
+
+
+// splitmix64 finalizer
+static uint64_t cipv4_gen_mix(uint64_t z){
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// append the parts of start/prefix outside the excluded networks
+static int cipv4_gen_split(uint32_t start, int prefix, const cipv4_net * excluded, int nexcluded,
+                           cipv4_net ** pieces, uint32_t * npieces, uint32_t * capacity){
+    uint32_t mask = prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - prefix);
+    int overlap = 0;
+    for (int e=0; e<nexcluded; ++e){
+        uint32_t emask = excluded[e].network_prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - excluded[e].network_prefix);
+        if (excluded[e].network_prefix <= prefix && (start & emask) == excluded[e].addr_start)
+            return 0;                       // inside an excluded network
+        if ((excluded[e].addr_start & mask) == start)
+            overlap = 1;                    // contains an excluded network
+    }
+    if (overlap){
+        uint32_t half = 1u << (31 - prefix);
+        if (cipv4_gen_split(start, prefix + 1, excluded, nexcluded, pieces, npieces, capacity) != 0)
+            return -1;
+        return cipv4_gen_split(start | half, prefix + 1, excluded, nexcluded, pieces, npieces, capacity);
+    }
+    if (*npieces == *capacity){
+        uint32_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+        cipv4_net * new_memory = (cipv4_net*) realloc(*pieces, new_capacity * sizeof(cipv4_net));
+        if (!new_memory)
+            return -1;
+        *pieces = new_memory;
+        *capacity = new_capacity;
+    }
+    (*pieces)[*npieces].addr_start = start;
+    (*pieces)[*npieces].network_prefix = (uint8_t)prefix;
+    (*npieces)++;
+    return 0;
+}
+
+// Vose's alias method
+static int cipv4_gen_alias(cipv4_gen * gen, const double * weights){
+    uint32_t n = gen->npieces;
+    double * scaled = (double*) malloc(n * sizeof(double));
+    uint32_t * small = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t * large = (uint32_t*) malloc(n * sizeof(uint32_t));
+    gen->threshold = (uint64_t*) malloc(n * sizeof(uint64_t));
+    gen->alias = (uint32_t*) malloc(n * sizeof(uint32_t));
+    int ret = -1;
+    if (!scaled || !small || !large || !gen->threshold || !gen->alias)
+        goto done;
+    double total = 0;
+    for (uint32_t i=0; i<n; ++i)
+        total += weights[i];
+    uint32_t nsmall = 0, nlarge = 0;
+    for (uint32_t i=0; i<n; ++i){
+        scaled[i] = weights[i] * n / total;
+        if (scaled[i] < 1.0)
+            small[nsmall++] = i;
+        else
+            large[nlarge++] = i;
+    }
+    while (nsmall > 0 && nlarge > 0){
+        uint32_t s = small[--nsmall];
+        uint32_t l = large[--nlarge];
+        gen->threshold[s] = (uint64_t)(scaled[s] * 4294967296.0);
+        gen->alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+            small[nsmall++] = l;
+        else
+            large[nlarge++] = l;
+    }
+    // what is left has a probability of 1 (up to rounding errors)
+    while (nlarge > 0){
+        uint32_t l = large[--nlarge];
+        gen->threshold[l] = 1ULL << 32;
+        gen->alias[l] = l;
+    }
+    while (nsmall > 0){
+        uint32_t s = small[--nsmall];
+        gen->threshold[s] = 1ULL << 32;
+        gen->alias[s] = s;
+    }
+    ret = 0;
+done:
+    free(scaled);
+    free(small);
+    free(large);
+    return ret;
+}
+
+// address of record `record`, every record uses the counters 4 * record + 0~3
+static uint32_t cipv4_gen_draw(const cipv4_gen * gen, uint64_t record){
+    uint64_t r = cipv4_gen_mix(gen->key + (4 * record + 1) * CIPV4_GEN_GOLDEN);
+    uint64_t offset = cipv4_gen_mix(gen->key + (4 * record + 2) * CIPV4_GEN_GOLDEN);
+    uint32_t i = (uint32_t)(((r >> 32) * gen->npieces) >> 32);
+    if ((r & 0xFFFFFFFF) >= gen->threshold[i])
+        i = gen->alias[i];
+    const cipv4_net * piece = &gen->pieces[i];
+    uint32_t hostmask = piece->network_prefix == 0 ? 0xFFFFFFFF : ~(0xFFFFFFFFu << (32 - piece->network_prefix));
+    return piece->addr_start | ((uint32_t)offset & hostmask);
+}
+
+static char * cipv4_gen_format(uint32_t addr, char * p){
+    for (int i=3; i>=0; --i){
+        uint32_t v = (addr >> (8 * i)) & 0xFF;
+        if (v >= 100){
+            *p++ = (char)('0' + v / 100);
+            v %= 100;
+            *p++ = (char)('0' + v / 10);
+        }
+        else if (v >= 10)
+            *p++ = (char)('0' + v / 10);
+        *p++ = (char)('0' + v % 10);
+        *p++ = i ? DOT : '\n';
+    }
+    return p;
+}
+
+static void * cipv4_gen_worker(void * arg){
+    cipv4_gen_job * job = (cipv4_gen_job*) arg;
+    const cipv4_gen * gen = job->gen;
+    if (job->addrs){
+        for (size_t k=0; k<job->n; ++k)
+            job->addrs[k] = cipv4_gen_draw(gen, job->first + k);
+        return NULL;
+    }
+    uint64_t rate = (uint64_t)(gen->config.malformed_rate * 9007199254740992.0);   // 2^53
+    char * p = job->text;
+    for (size_t k=0; k<job->n; ++k){
+        uint64_t record = job->first + k;
+        if (rate && cipv4_gen_mix(gen->key + 4 * record * CIPV4_GEN_GOLDEN) >> 11 < rate){
+            uint64_t random = cipv4_gen_mix(gen->key + (4 * record + 3) * CIPV4_GEN_GOLDEN);
+            cipv4_gen_malformed((int)(random % CIPV4_GEN_BAD_KINDS), random / CIPV4_GEN_BAD_KINDS, p);
+            p += strlen(p);
+            *p++ = '\n';
+            continue;
+        }
+        p = cipv4_gen_format(cipv4_gen_draw(gen, record), p);
+    }
+    job->length = (size_t)(p - job->text);
+    return NULL;
+}
+
+// every thread writes its slice in place, text slices are then packed
+static int cipv4_gen_run(const cipv4_gen * gen, uint64_t first, size_t n, uint32_t * addrs, char * text, size_t * length){
+    int nthreads = gen->config.nthreads;
+    if (nthreads > CIPV4_GEN_MAX_THREADS)
+        nthreads = CIPV4_GEN_MAX_THREADS;
+    if ((size_t)nthreads > n / CIPV4_GEN_PARALLEL_MIN)
+        nthreads = (int)(n / CIPV4_GEN_PARALLEL_MIN);
+    if (nthreads < 1)
+        nthreads = 1;
+    pthread_t threads[CIPV4_GEN_MAX_THREADS];
+    cipv4_gen_job jobs[CIPV4_GEN_MAX_THREADS];
+    int started[CIPV4_GEN_MAX_THREADS] = {0};
+    size_t slice = (n + nthreads - 1) / nthreads;
+    for (int t=0; t<nthreads; ++t){
+        size_t start = slice * t < n ? slice * t : n;
+        jobs[t].gen = gen;
+        jobs[t].first = first + start;
+        jobs[t].n = n - start < slice ? n - start : slice;
+        jobs[t].addrs = addrs ? addrs + start : NULL;
+        jobs[t].text = text ? text + start * CIPV4_GEN_MAX_LINE : NULL;
+        jobs[t].length = 0;
+        if (t > 0 && pthread_create(&threads[t], NULL, cipv4_gen_worker, &jobs[t]) == 0)
+            started[t] = 1;
+    }
+    for (int t=0; t<nthreads; ++t)
+        if (!started[t])
+            cipv4_gen_worker(&jobs[t]);
+    for (int t=1; t<nthreads; ++t)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    if (text){
+        size_t total = 0;
+        for (int t=0; t<nthreads; ++t){
+            memmove(text + total, jobs[t].text, jobs[t].length);
+            total += jobs[t].length;
+        }
+        *length = total;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/// @file cipv4_hhh.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cipv4_hhh.h>
+
+
+static void cipv4_hhh_level_add(const cipv4_hhh * hhh, cipv4_hhh_level * level, uint32_t key, uint64_t w);
+static void cipv4_hhh_level_insert(const cipv4_hhh * hhh, cipv4_hhh_level * level, uint32_t key, uint64_t w);
+static uint64_t cipv4_hhh_sqrt(uint64_t x);
+
+static inline uint32_t cipv4_hhh_mask(uint8_t network_prefix){
+    return network_prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - network_prefix);
+}
+
+
+/**
+ * @brief Create a hierarchical heavy hitter sketch
+ * @param min_prefix The shortest prefix len to track (e.g. 8)
+ * @param step Distance between two tracked prefix lens (1 tracks every
+ * len between min_prefix and 32, 8 tracks /8, /16, /24 and /32)
+ * @param capacity Number of counters per prefix len
+ * @param sampled 0 to update every level for every address, 1 to update
+ * only one randomly selected level per address (RHHH)
+ * @return A pointer to the sketch or NULL in case of error.
+ *
+ * Each level is a Misra-Gries summary, so the error of a count is at most
+ * N/(capacity+1) where N is the number of addresses. In sampled mode the
+ * update costs one hash table access regardless of the number of levels and
+ * the counts are scaled by the number of levels, which adds a statistical
+ * error of about 2*sqrt(N*levels) (reported in cipv4_hhh_item.error).
+ */
+cipv4_hhh * cipv4_hhh_new(uint8_t min_prefix, uint8_t step, uint32_t capacity, int sampled){
+    if (min_prefix > 32 || step == 0 || capacity == 0 || capacity > (1u << 29))
+        return NULL;
+    cipv4_hhh * hhh = (cipv4_hhh*) calloc(1, sizeof(cipv4_hhh));
+    if (!hhh)
+        return NULL;
+    hhh->capacity = capacity;
+    hhh->sampled = sampled ? 1 : 0;
+    hhh->rng = 0x9E3779B97F4A7C15ULL;
+    hhh->table_bits = 1;
+    while ((1u << hhh->table_bits) < 2 * capacity)
+        hhh->table_bits++;
+    for (unsigned int p=min_prefix; p<=32; p+=step){
+        cipv4_hhh_level * level = &hhh->levels[hhh->nlevels++];
+        level->network_prefix = p;
+        level->keys = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+        level->counts = (uint64_t*) malloc(capacity * sizeof(uint64_t));
+        level->slots = (int32_t*) malloc(sizeof(int32_t) << hhh->table_bits);
+        if (!level->keys || !level->counts || !level->slots){
+            cipv4_hhh_free(hhh);
+            return NULL;
+        }
+        memset(level->slots, 0xFF, sizeof(int32_t) << hhh->table_bits);
+    }
+    return hhh;
+}
+
+/**
+ * @brief Free the memory allocated by cipv4_hhh_new()
+ * @param hhh The sketch (can be NULL)
+ * @return nothing
+ */
+void cipv4_hhh_free(cipv4_hhh * hhh){
+    if (!hhh)
+        return;
+    for (int i=0; i<hhh->nlevels; ++i){
+        free(hhh->levels[i].keys);
+        free(hhh->levels[i].counts);
+        free(hhh->levels[i].slots);
+    }
+    free(hhh);
+}
+
+/**
+ * @brief Count one address
+ * @param hhh The sketch returned by cipv4_hhh_new()
+ * @param addr IP address in a form of 32-bit integer
+ * @return nothing
+ */
+void cipv4_hhh_update(cipv4_hhh * hhh, uint32_t addr){
+    hhh->total++;
+    if (hhh->sampled){
+        // xorshift64* picks the level
+        uint64_t x = hhh->rng;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        hhh->rng = x;
+        uint32_t r = (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+        cipv4_hhh_level * level = &hhh->levels[((uint64_t)r * hhh->nlevels) >> 32];
+        cipv4_hhh_level_add(hhh, level, addr & cipv4_hhh_mask(level->network_prefix), 1);
+        return;
+    }
+    for (int i=0; i<hhh->nlevels; ++i)
+        cipv4_hhh_level_add(hhh, &hhh->levels[i], addr & cipv4_hhh_mask(hhh->levels[i].network_prefix), 1);
+}
+
+/**
+ * @brief Count an array of addresses
+ * @param hhh The sketch returned by cipv4_hhh_new()
+ * @param addrs Array of IP addresses in a form of 32-bit integer
+ * @param n Number of elements in the array
+ * @return nothing
+ */
+void cipv4_hhh_update_batch(cipv4_hhh * hhh, const uint32_t * addrs, size_t n){
+    for (size_t i=0; i<n; ++i)
+        cipv4_hhh_update(hhh, addrs[i]);
+}
+
+/**
+ * @brief Find the hierarchical heavy hitters
+ * @param hhh The sketch returned by cipv4_hhh_new()
+ * @param phi Threshold as a fraction of all the addresses (e.g. 0.05)
+ * @param items User-provided array to receive the heavy hitters
+ * @param max_items Number of elements in the array
+ * @return The number of heavy hitters written to `items`.
+ *
+ * A prefix is reported when its count, after removing the counts of
+ * the longer prefixes already reported inside it, may be above
+ * phi * N. Longer prefixes are reported first.
+ */
+uint32_t cipv4_hhh_query(const cipv4_hhh * hhh, double phi, cipv4_hhh_item * items, uint32_t max_items){
+    if (!hhh || !items || max_items == 0 || phi <= 0)
+        return 0;
+    uint64_t scale = hhh->sampled ? (uint64_t)hhh->nlevels : 1;
+    uint64_t threshold = (uint64_t)(phi * (double)hhh->total);
+    uint64_t noise = hhh->sampled ? 2 * cipv4_hhh_sqrt(hhh->total * scale) : 0;
+    uint32_t count = 0;
+    for (int l=hhh->nlevels - 1; l>=0; --l){
+        const cipv4_hhh_level * level = &hhh->levels[l];
+        uint32_t mask = cipv4_hhh_mask(level->network_prefix);
+        uint64_t stored = 0;
+        for (uint32_t i=0; i<level->used; ++i)
+            stored += level->counts[i];
+        uint64_t error = (level->total - stored) / (hhh->capacity + 1) * scale + noise;
+        uint32_t reported = count;     // only longer prefixes are subtracted
+        for (uint32_t i=0; i<level->used; ++i){
+            uint64_t estimate = level->counts[i] * scale;
+            uint64_t sub = 0;
+            for (uint32_t j=0; j<reported; ++j)
+                if ((items[j].addr & mask) == level->keys[i])
+                    sub += items[j].conditioned;
+            uint64_t conditioned = estimate > sub ? estimate - sub : 0;
+            if (conditioned + error < threshold || (conditioned == 0 && threshold == 0))
+                continue;
+            items[count].addr = level->keys[i];
+            items[count].network_prefix = level->network_prefix;
+            items[count].count = estimate;
+            items[count].conditioned = conditioned;
+            items[count].error = error;
+            if (++count == max_items)
+                return count;
+        }
+    }
+    return count;
+}
+
+
+static void cipv4_hhh_level_insert(const cipv4_hhh * hhh, cipv4_hhh_level * level, uint32_t key, uint64_t w){
+    uint32_t mask = (1u << hhh->table_bits) - 1;
+    uint32_t h = (key * 0x9E3779B1u) >> (32 - hhh->table_bits);
+    while (level->slots[h] >= 0)
+        h = (h + 1) & mask;
+    level->keys[level->used] = key;
+    level->counts[level->used] = w;
+    level->slots[h] = (int32_t)level->used++;
+}
+
+static void cipv4_hhh_level_add(const cipv4_hhh * hhh, cipv4_hhh_level * level, uint32_t key, uint64_t w){
+    uint32_t mask = (1u << hhh->table_bits) - 1;
+    uint32_t h = (key * 0x9E3779B1u) >> (32 - hhh->table_bits);
+    int32_t idx;
+    level->total += w;
+    while ((idx = level->slots[h]) >= 0){
+        if (level->keys[idx] == key){
+            level->counts[idx] += w;
+            return;
+        }
+        h = (h + 1) & mask;
+    }
+    if (level->used < hhh->capacity){
+        level->keys[level->used] = key;
+        level->counts[level->used] = w;
+        level->slots[h] = (int32_t)level->used++;
+        return;
+    }
+    // table is full: decrement everything by the smallest count, which
+    // frees at least one counter (amortized O(1) per update)
+    uint64_t m = w;
+    for (uint32_t i=0; i<level->used; ++i)
+        if (level->counts[i] < m)
+            m = level->counts[i];
+    w -= m;
+    uint32_t kept = 0;
+    for (uint32_t i=0; i<level->used; ++i){
+        if (level->counts[i] > m){
+            level->keys[kept] = level->keys[i];
+            level->counts[kept++] = level->counts[i] - m;
+        }
+    }
+    uint32_t n = kept;
+    level->used = 0;
+    memset(level->slots, 0xFF, sizeof(int32_t) << hhh->table_bits);
+    for (uint32_t i=0; i<n; ++i)
+        cipv4_hhh_level_insert(hhh, level, level->keys[i], level->counts[i]);
+    if (w > 0)
+        cipv4_hhh_level_insert(hhh, level, key, w);
+}
+
+static uint64_t cipv4_hhh_sqrt(uint64_t x){
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > x)
+        bit >>= 2;
+    while (bit){
+        if (x >= r + bit){
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }else{
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
@@ -0,0 +1,383 @@
+/// @file cipv4_hist.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <cipv4_counter.h>
+#include <cipv4_hist.h>
+
+
+#define CIPV4_HIST_BLOCK 256                // keys computed before they are counted
+#define CIPV4_HIST_MERGE_BLOCK 512          // buckets summed while they are in L1
+#define CIPV4_HIST_PARALLEL_MIN (1 << 16)   // least addresses or buckets of a thread
+#define CIPV4_HIST_LANES 4                  // copies of the small histograms
+#define CIPV4_HIST_LANE_PREFIX 12           // largest prefix with lanes (128KB a shard)
+
+/**
+* @details Type definition of the struct _cipv4_hist_job
+*
+* cipv4_hist_job: work of one thread of cipv4_hist_count() or cipv4_hist_merge()
+*/
+typedef struct _cipv4_hist_job cipv4_hist_job;
+
+struct _cipv4_hist_job{
+    cipv4_hist * hist;
+    cipv4_hist_shard * shard;   ///< shard to update (count)
+    const uint32_t * addrs;     ///< addresses to count
+    size_t n;                   ///< number of addresses (count) or first bucket (merge)
+    size_t end;                 ///< last bucket + 1 (merge)
+    uint64_t hits;              ///< sum of the buckets (merge)
+    uint32_t nonzero;           ///< non-zero buckets (merge)
+};
+
+static void * cipv4_hist_count_worker(void * arg);
+static void * cipv4_hist_merge_worker(void * arg);
+static void cipv4_hist_run(cipv4_hist_job * jobs, int njobs, void * (*worker)(void*));
+static uint64_t * cipv4_hist_alloc(size_t n);
+static void cipv4_hist_release(uint64_t * counts, size_t n);
+static inline void cipv4_hist_to_net(const cipv4_hist * hist, uint32_t bucket, cipv4_net * net);
+
+
+/**
+ * @brief Create a histogram of addresses by network
+ * @param network_prefix Size of the buckets, 1~CIPV4_HIST_MAX_PREFIX (e.g. 16 for /16 buckets)
+ * @param nshards Number of shards (usually one per thread)
+ * @return A pointer to the histogram or NULL in case of error.
+ *
+ * Every shard has one 64-bit counter per bucket (128MB for /24), in
+ * huge pages when the system allows it. The memory is only touched when
+ * it is used. Up to /12, a shard has CIPV4_HIST_LANES copies of the
+ * buckets so that a run of addresses of the same network does not wait
+ * for the previous increment of the same counter.
+ *
+ * @code
+ *    cipv4_hist * hist = cipv4_hist_new(24, nthreads);
+ *    // in thread i
+ *    cipv4_hist_add_batch(cipv4_hist_get_shard(hist, i), addrs, n);
+ *    // once all the threads are done
+ *    cipv4_hist_merge(hist, nthreads);
+ *    cipv4_net nets[10];
+ *    uint64_t counts[10];
+ *    uint32_t k = cipv4_hist_top(hist, 10, nets, counts);
+ *    cipv4_hist_free(hist);
+ * @endcode
+ */
+cipv4_hist * cipv4_hist_new(uint8_t network_prefix, int nshards){
+    if (network_prefix < 1 || network_prefix > CIPV4_HIST_MAX_PREFIX || nshards <= 0)
+        return NULL;
+    cipv4_hist * hist = (cipv4_hist*) calloc(1, sizeof(cipv4_hist));
+    if (!hist)
+        return NULL;
+    hist->network_prefix = network_prefix;
+    hist->nbuckets = 1U << network_prefix;
+    hist->shards = (cipv4_hist_shard*) calloc(nshards, sizeof(cipv4_hist_shard));
+    hist->total = cipv4_hist_alloc(hist->nbuckets);
+    if (!hist->shards || !hist->total){
+        cipv4_hist_free(hist);
+        return NULL;
+    }
+    hist->nshards = nshards;
+    uint32_t lanes = network_prefix <= CIPV4_HIST_LANE_PREFIX ? CIPV4_HIST_LANES : 1;
+    for (int i=0; i<nshards; ++i){
+        hist->shards[i].shift = 32 - network_prefix;
+        hist->shards[i].lanes = lanes;
+        hist->shards[i].counts = cipv4_hist_alloc((size_t)hist->nbuckets * lanes);
+        if (!hist->shards[i].counts){
+            cipv4_hist_free(hist);
+            return NULL;
+        }
+    }
+    return hist;
+}
+
+/**
+ * @brief Free the memory allocated by cipv4_hist_new()
+ * @param hist The histogram (can be NULL)
+ * @return nothing
+ */
+void cipv4_hist_free(cipv4_hist * hist){
+    if (!hist)
+        return;
+    if (hist->shards)
+        for (int i=0; i<hist->nshards; ++i)
+            cipv4_hist_release(hist->shards[i].counts, (size_t)hist->nbuckets * hist->shards[i].lanes);
+    free(hist->shards);
+    cipv4_hist_release(hist->total, hist->nbuckets);
+    free(hist);
+}
+
+/**
+ * @brief Returns the shard of a thread
+ * @param hist The histogram returned by cipv4_hist_new()
+ * @param shard Shard number between 0~nshards-1
+ * @return A pointer to the shard or NULL if the number is not valid.
+ *
+ * A shard must only be updated by one thread at a time.
+ */
+cipv4_hist_shard * cipv4_hist_get_shard(cipv4_hist * hist, int shard){
+    if (!hist || shard < 0 || shard >= hist->nshards)
+        return NULL;
+    return &hist->shards[shard];
+}
+
+/**
+ * @brief Count an address
+ * @param shard Shard of the calling thread returned by cipv4_hist_get_shard()
+ * @param addr The address (host order)
+ * @param count Number of hits to add
+ * @return nothing
+ */
+void cipv4_hist_add(cipv4_hist_shard * shard, uint32_t addr, uint64_t count){
+    shard->counts[addr >> shard->shift] += count;
+}
+
+/**
+ * @brief Count every address of an array
+ * @param shard Shard of the calling thread returned by cipv4_hist_get_shard()
+ * @param addrs Array of addresses (host order, e.g. the addrs output of cipv4_flow_classify())
+ * @param n Number of elements in the array
+ * @return nothing
+ *
+ * The counter numbers of a block of addresses (bucket and lane) are
+ * computed first in a loop without dependency, vectorized by the
+ * compiler, then counted.
+ */
+void cipv4_hist_add_batch(cipv4_hist_shard * shard, const uint32_t * addrs, size_t n){
+    uint32_t keys[CIPV4_HIST_BLOCK];
+    uint64_t * counts = shard->counts;
+    uint32_t shift = shard->shift;
+    uint32_t lane_mask = shard->lanes - 1;
+    uint32_t lane_shift = 32 - shift;
+    size_t i = 0;
+    // whole blocks, the constant trip count lets -O2 vectorize the first loop
+    for (; i + CIPV4_HIST_BLOCK <= n; i+=CIPV4_HIST_BLOCK){
+        const uint32_t * block = addrs + i;
+        for (uint32_t j=0; j<CIPV4_HIST_BLOCK; ++j)
+            keys[j] = (block[j] >> shift) | ((j & lane_mask) << lane_shift);
+        for (uint32_t j=0; j<CIPV4_HIST_BLOCK; ++j)
+            counts[keys[j]]++;
+    }
+    for (uint32_t j=0; i<n; ++i, ++j)
+        counts[(addrs[i] >> shift) | ((j & lane_mask) << lane_shift)]++;
+}
+
+/**
+ * @brief Count an array of addresses with one thread per shard
+ * @param hist The histogram returned by cipv4_hist_new()
+ * @param addrs Array of addresses (host order)
+ * @param n Number of elements in the array
+ * @return 0 on success or -1 in case of error.
+ *
+ * Thread i counts the i-th slice of the array into shard i (at most
+ * CIPV4_HIST_MAX_THREADS threads, fewer for small arrays). No other
+ * thread must update the shards at the same time.
+ */
+int cipv4_hist_count(cipv4_hist * hist, const uint32_t * addrs, size_t n){
+    if (!hist || (!addrs && n > 0))
+        return -1;
+    if (n == 0)
+        return 0;
+    int nthreads = hist->nshards < CIPV4_HIST_MAX_THREADS ? hist->nshards : CIPV4_HIST_MAX_THREADS;
+    if ((size_t)nthreads > n / CIPV4_HIST_PARALLEL_MIN)
+        nthreads = (int)(n / CIPV4_HIST_PARALLEL_MIN);
+    if (nthreads < 1)
+        nthreads = 1;
+    cipv4_hist_job jobs[CIPV4_HIST_MAX_THREADS];
+    size_t slice = (n + nthreads - 1) / nthreads;
+    for (int t=0; t<nthreads; ++t){
+        size_t start = slice * t < n ? slice * t : n;
+        jobs[t].hist = hist;
+        jobs[t].shard = &hist->shards[t];
+        jobs[t].addrs = addrs + start;
+        jobs[t].n = n - start < slice ? n - start : slice;
+    }
+    cipv4_hist_run(jobs, nthreads, cipv4_hist_count_worker);
+    return 0;
+}
+
+/**
+ * @brief Sum all the shards into hist->total
+ * @param hist The histogram returned by cipv4_hist_new()
+ * @param nthreads Number of threads summing disjoint ranges of buckets
+ * (at most CIPV4_HIST_MAX_THREADS)
+ * @return 0 on success or -1 in case of error.
+ *
+ * The shards are kept, so the totals keep growing until cipv4_hist_clear().
+ * The shards must not be updated during the merge. Also sets hist->hits
+ * and hist->nonzero.
+ */
+int cipv4_hist_merge(cipv4_hist * hist, int nthreads){
+    if (!hist)
+        return -1;
+    size_t nbuckets = hist->nbuckets;
+    if (nthreads > CIPV4_HIST_MAX_THREADS)
+        nthreads = CIPV4_HIST_MAX_THREADS;
+    if (nthreads > 1 && (size_t)nthreads > nbuckets / CIPV4_HIST_PARALLEL_MIN)
+        nthreads = (int)(nbuckets / CIPV4_HIST_PARALLEL_MIN);
+    if (nthreads < 1)
+        nthreads = 1;
+    cipv4_hist_job jobs[CIPV4_HIST_MAX_THREADS];
+    // slices of whole merge blocks (nbuckets is a power of 2)
+    size_t slice = (nbuckets / nthreads + CIPV4_HIST_MERGE_BLOCK - 1) / CIPV4_HIST_MERGE_BLOCK * CIPV4_HIST_MERGE_BLOCK;
+    for (int t=0; t<nthreads; ++t){
+        jobs[t].hist = hist;
+        jobs[t].n = slice * t < nbuckets ? slice * t : nbuckets;
+        jobs[t].end = slice * (t + 1) < nbuckets ? slice * (t + 1) : nbuckets;
+        jobs[t].hits = 0;
+        jobs[t].nonzero = 0;
+    }
+    cipv4_hist_run(jobs, nthreads, cipv4_hist_merge_worker);
+    hist->hits = 0;
+    hist->nonzero = 0;
+    for (int t=0; t<nthreads; ++t){
+        hist->hits += jobs[t].hits;
+        hist->nonzero += jobs[t].nonzero;
+    }
+    return 0;
+}
+
+/**
+ * @brief Set every bucket of the shards and of the totals to 0
+ * @param hist The histogram returned by cipv4_hist_new()
+ * @return nothing
+ */
+void cipv4_hist_clear(cipv4_hist * hist){
+    if (!hist)
+        return;
+    for (int i=0; i<hist->nshards; ++i)
+        memset(hist->shards[i].counts, 0, (size_t)hist->nbuckets * hist->shards[i].lanes * sizeof(uint64_t));
+    memset(hist->total, 0, (size_t)hist->nbuckets * sizeof(uint64_t));
+    hist->hits = 0;
+    hist->nonzero = 0;
+}
+
+/**
+ * @brief Find the buckets with the most hits
+ * @param hist The histogram merged by cipv4_hist_merge()
+ * @param k Maximum number of buckets to return
+ * @param nets User-provided array of k elements to receive the networks
+ * @param counts User-provided array of k elements to receive the hits (can be NULL)
+ * @return The number of buckets written (buckets without hits are
+ * skipped), sorted by hits in descending order.
+ */
+uint32_t cipv4_hist_top(const cipv4_hist * hist, uint32_t k, cipv4_net * nets, uint64_t * counts){
+    if (!hist || !nets || k == 0)
+        return 0;
+    uint32_t * keys = (uint32_t*) malloc((size_t)k * sizeof(uint32_t));
+    if (!keys)
+        return 0;
+    cipv4_counter_totals totals = {hist->nbuckets, hist->total, hist->total};
+    uint32_t n = cipv4_counter_top(&totals, k, 0, keys);
+    for (uint32_t i=0; i<n; ++i){
+        cipv4_hist_to_net(hist, keys[i], &nets[i]);
+        if (counts)
+            counts[i] = hist->total[keys[i]];
+    }
+    free(keys);
+    return n;
+}
+
+/**
+ * @brief Export the non-zero buckets in address order
+ * @param hist The histogram merged by cipv4_hist_merge()
+ * @param first First bucket to look at (0 for the start of the address space)
+ * @param nets User-provided array of max elements to receive the networks
+ * @param counts User-provided array of max elements to receive the hits (can be NULL)
+ * @param max Size of the arrays (hist->nonzero exports everything at once)
+ * @return The number of buckets written.
+ *
+ * @code
+ *    // page by page
+ *    uint32_t first = 0, n;
+ *    while ((n = cipv4_hist_export(hist, first, nets, counts, 1024)) > 0){
+ *        // ...
+ *        first = (nets[n - 1].addr_start >> (32 - hist->network_prefix)) + 1;
+ *    }
+ * @endcode
+ */
+uint32_t cipv4_hist_export(const cipv4_hist * hist, uint32_t first, cipv4_net * nets, uint64_t * counts, uint32_t max){
+    if (!hist || !nets)
+        return 0;
+    uint32_t n = 0;
+    for (uint32_t b=first; b<hist->nbuckets && n<max; ++b){
+        if (hist->total[b] == 0)
+            continue;
+        cipv4_hist_to_net(hist, b, &nets[n]);
+        if (counts)
+            counts[n] = hist->total[b];
+        n++;
+    }
+    return n;
+}
+
+
+static void * cipv4_hist_count_worker(void * arg){
+    cipv4_hist_job * job = (cipv4_hist_job*) arg;
+    cipv4_hist_add_batch(job->shard, job->addrs, job->n);
+    return NULL;
+}
+
+// one block of buckets at a time: lane 0 of shard 0 is copied, the others are added
+static void * cipv4_hist_merge_worker(void * arg){
+    cipv4_hist_job * job = (cipv4_hist_job*) arg;
+    const cipv4_hist * hist = job->hist;
+    uint64_t hits = 0;
+    uint32_t nonzero = 0;
+    for (size_t start=job->n; start<job->end; start+=CIPV4_HIST_MERGE_BLOCK){
+        size_t m = job->end - start < CIPV4_HIST_MERGE_BLOCK ? job->end - start : CIPV4_HIST_MERGE_BLOCK;
+        uint64_t * total = hist->total + start;
+        memcpy(total, hist->shards[0].counts + start, m * sizeof(uint64_t));
+        for (int s=0; s<hist->nshards; ++s){
+            for (uint32_t lane=(s == 0); lane<hist->shards[s].lanes; ++lane){
+                const uint64_t * counts = hist->shards[s].counts + (size_t)lane * hist->nbuckets + start;
+                for (size_t j=0; j<m; ++j)
+                    total[j] += counts[j];
+            }
+        }
+        for (size_t j=0; j<m; ++j){
+            hits += total[j];
+            nonzero += total[j] != 0;
+        }
+    }
+    job->hits = hits;
+    job->nonzero = nonzero;
+    return NULL;
+}
+
+// job 0 runs in the calling thread, as do the jobs whose thread can not be created
+static void cipv4_hist_run(cipv4_hist_job * jobs, int njobs, void * (*worker)(void*)){
+    pthread_t threads[CIPV4_HIST_MAX_THREADS];
+    int started[CIPV4_HIST_MAX_THREADS] = {0};
+    for (int t=1; t<njobs; ++t)
+        if (pthread_create(&threads[t], NULL, worker, &jobs[t]) == 0)
+            started[t] = 1;
+    for (int t=0; t<njobs; ++t)
+        if (!started[t])
+            worker(&jobs[t]);
+    for (int t=1; t<njobs; ++t)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+}
+
+// zeroed pages from the kernel, huge pages for the large histograms
+static uint64_t * cipv4_hist_alloc(size_t n){
+    void * p = mmap(NULL, n * sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(p, n * sizeof(uint64_t), MADV_HUGEPAGE);
+#endif
+    return (uint64_t*) p;
+}
+
+static void cipv4_hist_release(uint64_t * counts, size_t n){
+    if (counts)
+        munmap(counts, n * sizeof(uint64_t));
+}
+
+static inline void cipv4_hist_to_net(const cipv4_hist * hist, uint32_t bucket, cipv4_net * net){
+    net->addr_start = bucket << (32 - hist->network_prefix);
+    net->network_prefix = hist->network_prefix;
+}
@@ -0,0 +1,279 @@
+/// @file cipv4_ingest.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cipv4_ingest.h>
+
+
+#define CIPV4_INGEST_INITIAL 1024
+#define CIPV4_INGEST_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r')
+
+static const char * cipv4_ingest_addr(const char * p, const char * end, uint32_t * addr);
+static int cipv4_ingest_range(uint32_t start, uint32_t end, cipv4_net * out);
+static int cipv4_ingest_reserve(cipv4_ingest * ingest, size_t n);
+
+
+/**
+ * @brief Create an empty set of networks
+ * @return A pointer to the set or NULL if the memory allocation fails.
+ */
+cipv4_ingest * cipv4_ingest_new(void){
+    return (cipv4_ingest*) calloc(1, sizeof(cipv4_ingest));
+}
+
+/**
+ * @brief Free the memory allocated by cipv4_ingest_new() and the loaders
+ * @param ingest The set of networks (can be NULL)
+ * @return nothing
+ */
+void cipv4_ingest_free(cipv4_ingest * ingest){
+    if (!ingest)
+        return;
+    free(ingest->nets);
+    free(ingest);
+}
+
+/**
+ * @brief Parse one record in any of the supported notations
+ * @param text The record (not null-terminated)
+ * @param len Length of the record
+ * @param out User-provided array of CIPV4_INGEST_MAX_NETS elements
+ * @param form If not NULL, receives the notation (CIPV4_INGEST_CIDR, ...)
+ * @return The number of networks written to out, 0 for a blank or
+ * comment-only record and -1 if the record is not valid.
+ *
+ * Addresses follow the rules of cipv4_is_ip_valid(). Surrounding spaces
+ * and a trailing "# comment" are ignored, host bits of the address are
+ * cleared (10.1.2.3/8 is 10.0.0.0/8) and a mask is read as a netmask
+ * first, as in Python's ipaddress (0.0.0.0 is /0). Masks which are
+ * neither a netmask nor a hostmask (255.0.255.0) are rejected. A range
+ * "start-end" is split into the smallest list of networks covering it.
+ *
+ * @code
+ *    cipv4_net out[CIPV4_INGEST_MAX_NETS];
+ *    int n = cipv4_ingest_record("10.0.0.0-10.0.2.255", 19, out, NULL);
+ *    // 2: 10.0.0.0/23, 10.0.2.0/24
+ * @endcode
+ */
+int cipv4_ingest_record(const char * text, size_t len, cipv4_net * out, int * form){
+    if (!text || !out)
+        return -1;
+    const char * p = text;
+    const char * end = text + len;
+    const char * comment = memchr(text, '#', len);
+    if (comment)
+        end = comment;
+    while (p < end && CIPV4_INGEST_SPACE(*p))
+        p++;
+    while (end > p && CIPV4_INGEST_SPACE(end[-1]))
+        end--;
+    if (p == end)
+        return 0;
+    uint32_t addr;
+    p = cipv4_ingest_addr(p, end, &addr);
+    if (!p)
+        return -1;
+    while (p < end && CIPV4_INGEST_SPACE(*p))
+        p++;
+    int kind;
+    uint32_t prefix = 32;
+    if (p == end)
+        kind = CIPV4_INGEST_ADDRESS;
+    else if (*p == '-'){
+        uint32_t last;
+        p++;
+        while (p < end && CIPV4_INGEST_SPACE(*p))
+            p++;
+        p = cipv4_ingest_addr(p, end, &last);
+        if (!p || p != end || last < addr)
+            return -1;
+        if (form)
+            *form = CIPV4_INGEST_RANGE;
+        return cipv4_ingest_range(addr, last, out);
+    }
+    else if (*p == '/'){
+        p++;
+        while (p < end && CIPV4_INGEST_SPACE(*p))
+            p++;
+        if (memchr(p, DOT, end - p)){
+            uint32_t mask;
+            p = cipv4_ingest_addr(p, end, &mask);
+            if (!p || p != end)
+                return -1;
+            if ((~mask & (~mask + 1)) == 0){
+                kind = CIPV4_INGEST_NETMASK;        // ones then zeros
+                prefix = (uint32_t)__builtin_popcount(mask);
+            }
+            else if ((mask & (mask + 1)) == 0){
+                kind = CIPV4_INGEST_HOSTMASK;       // zeros then ones
+                prefix = 32 - (uint32_t)__builtin_popcount(mask);
+            }
+            else
+                return -1;
+        }
+        else{
+            // 0~32 without leading zero
+            kind = CIPV4_INGEST_CIDR;
+            if (p == end || end - p > 2 || (end - p == 2 && *p == '0'))
+                return -1;
+            prefix = 0;
+            for (; p < end; ++p){
+                if (*p < '0' || *p > '9')
+                    return -1;
+                prefix = prefix * 10 + (uint32_t)(*p - '0');
+            }
+            if (prefix > 32)
+                return -1;
+        }
+    }
+    else
+        return -1;
+    if (form)
+        *form = kind;
+    out[0].addr_start = prefix == 0 ? 0 : addr & (0xFFFFFFFFu << (32 - prefix));
+    out[0].network_prefix = (uint8_t)prefix;
+    return 1;
+}
+
+/**
+ * @brief Load every line of a buffer in one pass
+ * @param ingest The set returned by cipv4_ingest_new(), networks are appended
+ * @param buffer One record per line (\n or \r\n), the last line does not
+ * need a newline
+ * @param size Size of the buffer in bytes
+ * @return The number of networks added or -1 in case of error (NULL
+ * argument or memory allocation failure).
+ *
+ * Invalid lines are counted in ingest->errors and skipped, blank lines
+ * and lines starting with # are only counted in ingest->lines.
+ *
+ * @code
+ *    cipv4_ingest * ingest = cipv4_ingest_new();
+ *    cipv4_ingest_file(ingest, "feed.txt");
+ *    cipv4_gen * gen = cipv4_gen_new(ingest->nets, ingest->count, NULL);
+ *    cipv4_ingest_free(ingest);
+ * @endcode
+ */
+long int cipv4_ingest_buffer(cipv4_ingest * ingest, const char * buffer, size_t size){
+    if (!ingest || (!buffer && size > 0))
+        return -1;
+    size_t before = ingest->count;
+    const char * p = buffer;
+    const char * end = buffer + size;
+    while (p < end){
+        const char * eol = memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        if (cipv4_ingest_reserve(ingest, CIPV4_INGEST_MAX_NETS) != 0)
+            return -1;
+        int form = 0;
+        int n = cipv4_ingest_record(p, eol - p, ingest->nets + ingest->count, &form);
+        ingest->lines++;
+        if (n < 0){
+            if (ingest->errors++ == 0)
+                ingest->first_error = ingest->lines;
+        }
+        else if (n > 0){
+            ingest->count += n;
+            ingest->forms[form]++;
+        }
+        p = eol + 1;
+    }
+    return (long int)(ingest->count - before);
+}
+
+/**
+ * @brief Load every line of a file in one pass (the file is mapped, not copied)
+ * @param ingest The set returned by cipv4_ingest_new(), networks are appended
+ * @param path Path of the file
+ * @return The number of networks added or -1 in case of error (the file
+ * can not be read or memory allocation failure).
+ */
+long int cipv4_ingest_file(cipv4_ingest * ingest, const char * path){
+    if (!ingest || !path)
+        return -1;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0){
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0){
+        close(fd);
+        return 0;
+    }
+    void * data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    long int ret = cipv4_ingest_buffer(ingest, (const char*) data, (size_t)st.st_size);
+    munmap(data, (size_t)st.st_size);
+    return ret;
+}
+
+
+// dotted quad with the rules of cipv4_is_ip_valid(), returns the end of it
+static const char * cipv4_ingest_addr(const char * p, const char * end, uint32_t * addr){
+    uint32_t result = 0;
+    for (int i=0; i<4; ++i){
+        if (i > 0){
+            if (p == end || *p != DOT)
+                return NULL;
+            p++;
+        }
+        uint32_t part = 0;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9'){
+            if (digits == 3 || (digits == 1 && part == 0))
+                return NULL;
+            part = part * 10 + (uint32_t)(*p - '0');
+            digits++;
+            p++;
+        }
+        if (digits == 0 || part > 255)
+            return NULL;
+        result = (result << 8) | part;
+    }
+    if (p < end && *p == DOT)
+        return NULL;
+    *addr = result;
+    return p;
+}
+
+// largest aligned network at every step, at most 62 networks
+static int cipv4_ingest_range(uint32_t start, uint32_t end, cipv4_net * out){
+    int n = 0;
+    uint64_t first = start;
+    while (first <= end){
+        int size = first == 0 ? 32 : __builtin_ctz((uint32_t)first);
+        while (first + (1ULL << size) - 1 > end)
+            size--;
+        out[n].addr_start = (uint32_t)first;
+        out[n].network_prefix = (uint8_t)(32 - size);
+        n++;
+        first += 1ULL << size;
+    }
+    return n;
+}
+
+static int cipv4_ingest_reserve(cipv4_ingest * ingest, size_t n){
+    if (ingest->count + n <= ingest->capacity)
+        return 0;
+    size_t capacity = ingest->capacity ? ingest->capacity : CIPV4_INGEST_INITIAL;
+    while (capacity < ingest->count + n)
+        capacity *= 2;
+    cipv4_net * new_memory = (cipv4_net*) realloc(ingest->nets, capacity * sizeof(cipv4_net));
+    if (!new_memory)
+        return -1;
+    ingest->nets = new_memory;
+    ingest->capacity = capacity;
+    return 0;
+}
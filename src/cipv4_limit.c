@@ -0,0 +1,316 @@
+/// @file cipv4_limit.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <cipv4_limit.h>
+
+
+#define CIPV4_LIMIT_EMPTY 0
+#define CIPV4_LIMIT_EVICTED 1
+#define CIPV4_LIMIT_BUSY UINT64_MAX   // tat of a slot without a bucket
+#define CIPV4_LIMIT_MAX_CAPACITY (1u << 30)
+#define CIPV4_LIMIT_BLOCK 16
+#define CIPV4_LIMIT_CACHE_LINE 64
+
+static uint64_t cipv4_limit_key(const cipv4_limit * limit, uint32_t addr);
+static uint64_t cipv4_limit_hash(uint64_t key);
+static cipv4_limit_slot * cipv4_limit_find(cipv4_limit * limit, uint64_t key, uint64_t hash, uint64_t now, int insert);
+static int cipv4_limit_evict_slot(cipv4_limit * limit, cipv4_limit_slot * slot, uint64_t now);
+static int cipv4_limit_charge(cipv4_limit * limit, uint64_t key, uint64_t hash, uint32_t cost, uint64_t now);
+
+
+/**
+ * @brief Set the default options (100 requests per second with bursts of
+ * 100 per /24, 65536 buckets, admit when the table is full)
+ * @param config The options to initialize
+ * @return nothing
+ */
+void cipv4_limit_config_init(cipv4_limit_config * config){
+    memset(config, 0, sizeof(cipv4_limit_config));
+    config->rate = 100;
+    config->burst = 100;
+    config->acl = NULL;
+    config->network_prefix = 24;
+    config->capacity = 1 << 16;
+    config->overflow_action = CIPV4_LIMIT_ADMIT;
+}
+
+/**
+ * @brief Create a rate limiter with one token bucket per client network
+ * @param config Options (NULL for the defaults)
+ * @return A pointer to the rate limiter or NULL in case of error (wrong
+ * option or memory allocation failure).
+ *
+ * An address is charged to the bucket of the rule of config->acl it
+ * matches (the longest prefix with cipv4_acl_compile_lpm()) or else to
+ * the bucket of its /network_prefix. The state of a bucket is a single
+ * 64-bit timestamp (generic cell rate algorithm, the same decisions as a
+ * token bucket) updated with one compare-and-swap, so threads only
+ * contend when they hit the same bucket. A bucket which is full again is
+ * the same as no bucket at all: it can be evicted at any time to make
+ * room, the memory never grows beyond config->capacity buckets.
+ *
+ * @code
+ *    cipv4_limit_config config;
+ *    cipv4_limit_config_init(&config);
+ *    config.rate = 10;                         // 10 requests per second
+ *    config.burst = 50;
+ *    config.acl = cipv4_acl_compile_lpm(rules, nrules, CIPV4_ACL_DENY);
+ *    cipv4_limit * limit = cipv4_limit_new(&config);
+ *    if (cipv4_limit_take(limit, cipv4_str_to_uint("8.8.8.8"), 1, cipv4_limit_now()) == CIPV4_LIMIT_ADMIT)
+ *        serve();
+ * @endcode
+ */
+cipv4_limit * cipv4_limit_new(const cipv4_limit_config * config){
+    cipv4_limit_config defaults;
+    if (!config){
+        cipv4_limit_config_init(&defaults);
+        config = &defaults;
+    }
+    if (!(config->rate > 0) || !(config->burst >= 1) || config->network_prefix > 32 || config->capacity == 0 ||
+            (config->overflow_action != CIPV4_LIMIT_ADMIT && config->overflow_action != CIPV4_LIMIT_DENY))
+        return NULL;
+    double interval = 1e9 / config->rate;
+    if (interval * config->burst >= 9e18)
+        return NULL;
+    cipv4_limit * limit = (cipv4_limit*) calloc(1, sizeof(cipv4_limit));
+    if (!limit)
+        return NULL;
+    limit->config = *config;
+    limit->interval = interval < 1 ? 1 : (uint64_t)(interval + 0.5);
+    limit->tolerance = (uint64_t)(limit->interval * config->burst);
+    uint32_t capacity = CIPV4_LIMIT_PROBES;
+    while (capacity < config->capacity && capacity < CIPV4_LIMIT_MAX_CAPACITY)
+        capacity <<= 1;
+    limit->mask = capacity - 1;
+    limit->slots = (cipv4_limit_slot*) aligned_alloc(CIPV4_LIMIT_CACHE_LINE, (size_t)capacity * sizeof(cipv4_limit_slot));
+    if (!limit->slots){
+        free(limit);
+        return NULL;
+    }
+    for (uint32_t i=0; i<capacity; ++i){
+        atomic_init(&limit->slots[i].key, CIPV4_LIMIT_EMPTY);
+        atomic_init(&limit->slots[i].tat, CIPV4_LIMIT_BUSY);
+    }
+    atomic_init(&limit->evictions, 0);
+    atomic_init(&limit->overflows, 0);
+    return limit;
+}
+
+/**
+ * @brief Free the rate limiter (not the ACL of its options)
+ * @param limit The rate limiter returned by cipv4_limit_new() (can be NULL)
+ * @return nothing
+ */
+void cipv4_limit_free(cipv4_limit * limit){
+    if (!limit)
+        return;
+    free(limit->slots);
+    free(limit);
+}
+
+/**
+ * @brief Current time for the now argument of the other functions
+ * @return Nanoseconds of CLOCK_MONOTONIC.
+ */
+uint64_t cipv4_limit_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Take cost tokens from the bucket of an address
+ * @param limit The rate limiter
+ * @param addr The address in a form of 32-bit integer
+ * @param cost Number of tokens (1 for one request)
+ * @param now Current time in ns (cipv4_limit_now())
+ * @return CIPV4_LIMIT_ADMIT if the tokens were taken, CIPV4_LIMIT_DENY
+ * otherwise (nothing is taken) or config->overflow_action if the table
+ * has no room for a new bucket.
+ */
+int cipv4_limit_take(cipv4_limit * limit, uint32_t addr, uint32_t cost, uint64_t now){
+    uint64_t key = cipv4_limit_key(limit, addr);
+    return cipv4_limit_charge(limit, key, cipv4_limit_hash(key), cost, now);
+}
+
+/**
+ * @brief Take one token for every address of a batch
+ * @param limit The rate limiter
+ * @param addrs Array of addresses in a form of 32-bit integer
+ * @param n Number of addresses
+ * @param now Current time in ns (cipv4_limit_now())
+ * @param admitted User-provided array of n elements which receives
+ * CIPV4_LIMIT_ADMIT or CIPV4_LIMIT_DENY for every address
+ * @return The number of admitted addresses or -1 in case of error.
+ *
+ * Keys of a block of addresses are resolved first and their slots
+ * prefetched, then the buckets are charged in order, same decisions as
+ * calling cipv4_limit_take() for every address.
+ */
+long int cipv4_limit_admit(cipv4_limit * limit, const uint32_t * addrs, size_t n, uint64_t now, uint8_t * admitted){
+    if (!limit || ((!addrs || !admitted) && n > 0))
+        return -1;
+    uint64_t keys[CIPV4_LIMIT_BLOCK];
+    uint64_t hashes[CIPV4_LIMIT_BLOCK];
+    long int count = 0;
+    for (size_t i=0; i<n; i+=CIPV4_LIMIT_BLOCK){
+        size_t block = n - i < CIPV4_LIMIT_BLOCK ? n - i : CIPV4_LIMIT_BLOCK;
+        for (size_t k=0; k<block; ++k){
+            keys[k] = cipv4_limit_key(limit, addrs[i + k]);
+            hashes[k] = cipv4_limit_hash(keys[k]);
+            __builtin_prefetch(&limit->slots[hashes[k] & limit->mask], 1);
+        }
+        for (size_t k=0; k<block; ++k){
+            admitted[i + k] = (uint8_t)cipv4_limit_charge(limit, keys[k], hashes[k], 1, now);
+            count += admitted[i + k];
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Tokens left in the bucket of an address
+ * @param limit The rate limiter
+ * @param addr The address in a form of 32-bit integer
+ * @param now Current time in ns
+ * @return The number of tokens (config->burst when the address has no
+ * bucket) or -1 in case of error.
+ */
+double cipv4_limit_tokens(cipv4_limit * limit, uint32_t addr, uint64_t now){
+    if (!limit)
+        return -1;
+    uint64_t key = cipv4_limit_key(limit, addr);
+    cipv4_limit_slot * slot = cipv4_limit_find(limit, key, cipv4_limit_hash(key), now, 0);
+    uint64_t tat = slot ? atomic_load_explicit(&slot->tat, memory_order_acquire) : CIPV4_LIMIT_BUSY;
+    if (tat == CIPV4_LIMIT_BUSY || tat <= now)
+        return limit->config.burst;
+    uint64_t used = tat - now;
+    if (used >= limit->tolerance)
+        return 0;
+    return (double)(limit->tolerance - used) / limit->interval;
+}
+
+/**
+ * @brief Remove every bucket which is full again
+ * @param limit The rate limiter
+ * @param now Current time in ns
+ * @return The number of evicted buckets.
+ *
+ * Not needed for correctness, buckets are also evicted on demand when a
+ * new bucket finds no room, but it keeps the probe sequences short.
+ * Safe to call while other threads take tokens.
+ */
+uint64_t cipv4_limit_evict(cipv4_limit * limit, uint64_t now){
+    if (!limit)
+        return 0;
+    uint64_t count = 0;
+    for (uint64_t i=0; i<=limit->mask; ++i)
+        count += cipv4_limit_evict_slot(limit, &limit->slots[i], now);
+    return count;
+}
+
+
+// rule index (even) or network of the fixed prefix (odd), never 0 or 1
+static uint64_t cipv4_limit_key(const cipv4_limit * limit, uint32_t addr){
+    if (limit->config.acl){
+        int rule = cipv4_acl_match(limit->config.acl, addr);
+        if (rule >= 0)
+            return 2 + ((uint64_t)rule << 1);
+    }
+    uint8_t prefix = limit->config.network_prefix;
+    uint32_t network = prefix == 0 ? 0 : addr & (0xFFFFFFFFu << (32 - prefix));
+    return 2 + (((uint64_t)network << 1) | 1);
+}
+
+// splitmix64 finalizer
+static uint64_t cipv4_limit_hash(uint64_t key){
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+/*
+ * Linear probing over CIPV4_LIMIT_PROBES slots. A new bucket takes the
+ * first empty or evicted slot, or evicts an idle bucket of its probe
+ * sequence. Two threads placing the same key while another bucket of the
+ * sequence is evicted can rarely create it twice; the copy which is not
+ * found first is idle and evicted later.
+ */
+static cipv4_limit_slot * cipv4_limit_find(cipv4_limit * limit, uint64_t key, uint64_t hash, uint64_t now, int insert){
+    for (;;){
+        cipv4_limit_slot * free_slot = NULL;
+        uint64_t free_key = CIPV4_LIMIT_EMPTY;
+        for (int i=0; i<CIPV4_LIMIT_PROBES; ++i){
+            cipv4_limit_slot * slot = &limit->slots[(hash + i) & limit->mask];
+            uint64_t k = atomic_load_explicit(&slot->key, memory_order_acquire);
+            if (k == key)
+                return slot;
+            if (k <= CIPV4_LIMIT_EVICTED && !free_slot){
+                free_slot = slot;
+                free_key = k;
+            }
+            if (k == CIPV4_LIMIT_EMPTY)
+                break;
+        }
+        if (!insert)
+            return NULL;
+        for (int i=0; i<CIPV4_LIMIT_PROBES && !free_slot; ++i){
+            cipv4_limit_slot * slot = &limit->slots[(hash + i) & limit->mask];
+            if (cipv4_limit_evict_slot(limit, slot, now)){
+                free_slot = slot;
+                free_key = CIPV4_LIMIT_EVICTED;
+            }
+        }
+        if (!free_slot)
+            return NULL;
+        if (atomic_compare_exchange_strong_explicit(&free_slot->key, &free_key, key,
+                                                    memory_order_acq_rel, memory_order_relaxed)){
+            // a full bucket; tat is BUSY until here so nobody charged it
+            atomic_store_explicit(&free_slot->tat, now, memory_order_release);
+            return free_slot;
+        }
+    }
+}
+
+static int cipv4_limit_evict_slot(cipv4_limit * limit, cipv4_limit_slot * slot, uint64_t now){
+    uint64_t tat = atomic_load_explicit(&slot->tat, memory_order_acquire);
+    if (tat == CIPV4_LIMIT_BUSY || tat > now)
+        return 0;
+    if (atomic_load_explicit(&slot->key, memory_order_acquire) <= CIPV4_LIMIT_EVICTED)
+        return 0;
+    // charging threads fail their CAS and look the key up again
+    if (!atomic_compare_exchange_strong_explicit(&slot->tat, &tat, CIPV4_LIMIT_BUSY,
+                                                 memory_order_acq_rel, memory_order_relaxed))
+        return 0;
+    atomic_store_explicit(&slot->key, CIPV4_LIMIT_EVICTED, memory_order_release);
+    atomic_fetch_add_explicit(&limit->evictions, 1, memory_order_relaxed);
+    return 1;
+}
+
+static int cipv4_limit_charge(cipv4_limit * limit, uint64_t key, uint64_t hash, uint32_t cost, uint64_t now){
+    uint64_t need = cost * limit->interval;
+    if (cost > 0 && (need / cost != limit->interval || need > limit->tolerance))
+        return CIPV4_LIMIT_DENY;        // more than a full bucket
+    for (;;){
+        cipv4_limit_slot * slot = cipv4_limit_find(limit, key, hash, now, 1);
+        if (!slot){
+            atomic_fetch_add_explicit(&limit->overflows, 1, memory_order_relaxed);
+            return limit->config.overflow_action;
+        }
+        for (;;){
+            uint64_t tat = atomic_load_explicit(&slot->tat, memory_order_acquire);
+            if (tat == CIPV4_LIMIT_BUSY || atomic_load_explicit(&slot->key, memory_order_acquire) != key)
+                break;          // evicted or being placed: look it up again
+            uint64_t next = (tat > now ? tat : now) + need;
+            if (next - now > limit->tolerance)
+                return CIPV4_LIMIT_DENY;
+            if (atomic_compare_exchange_weak_explicit(&slot->tat, &tat, next,
+                                                      memory_order_acq_rel, memory_order_relaxed))
+                return CIPV4_LIMIT_ADMIT;
+        }
+    }
+}
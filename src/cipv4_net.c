@@ -0,0 +1,379 @@
+/// @file cipv4_net.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cipv4_net.h>
+
+
+/*
+ * Two CIDR networks either are disjoint or one contains the other, so
+ * after sorting by (start, prefix) the networks which are not inside an
+ * earlier one form disjoint blocks and every relation to a set is one
+ * binary search among them.
+ */
+
+#define CIPV4_NET_KEY(start, prefix) (((uint64_t)(start) << 8) | (prefix))
+#define CIPV4_NET_KEY_START(key) ((uint32_t)((key) >> 8))
+#define CIPV4_NET_KEY_PREFIX(key) ((uint8_t)((key) & 0xFF))
+
+static int cipv4_net_bounds(const cipv4_net * net, uint32_t * start, uint32_t * end);
+static uint64_t * cipv4_net_keys(const cipv4_net * nets, size_t n, uint32_t ** index);
+static int cipv4_net_sort(uint64_t * keys, uint32_t * index, size_t n);
+static size_t cipv4_net_upper_bound(const uint64_t * keys, size_t n, uint64_t key);
+static size_t cipv4_net_upper_bound32(const uint32_t * values, size_t n, uint32_t value);
+
+
+/**
+ * @brief Test if two networks share at least one address
+ * @param a First network
+ * @param b Second network
+ * @return 1 if they overlap, 0 otherwise and -1 in case of error (NULL
+ * or prefix above 32).
+ */
+int cipv4_net_overlaps(const cipv4_net * a, const cipv4_net * b){
+    uint32_t as, ae, bs, be;
+    if (cipv4_net_bounds(a, &as, &ae) != 0 || cipv4_net_bounds(b, &bs, &be) != 0)
+        return -1;
+    return as <= be && bs <= ae;
+}
+
+/**
+ * @brief Test if a is inside b (a network is a subnet of itself)
+ * @param a The network tested
+ * @param b The bigger network
+ * @return 1 if every address of a is in b, 0 otherwise and -1 in case of error.
+ */
+int cipv4_net_subnet_of(const cipv4_net * a, const cipv4_net * b){
+    uint32_t as, ae, bs, be;
+    if (cipv4_net_bounds(a, &as, &ae) != 0 || cipv4_net_bounds(b, &bs, &be) != 0)
+        return -1;
+    return bs <= as && ae <= be;
+}
+
+/**
+ * @brief Test if b is inside a (a network is a supernet of itself)
+ * @param a The network tested
+ * @param b The smaller network
+ * @return 1 if every address of b is in a, 0 otherwise and -1 in case of error.
+ */
+int cipv4_net_supernet_of(const cipv4_net * a, const cipv4_net * b){
+    return cipv4_net_subnet_of(b, a);
+}
+
+/**
+ * @brief Split a network around a hole
+ * @param net The network
+ * @param hole A subnet of net
+ * @param out User-provided array of CIPV4_NET_MAX_EXCLUDE elements
+ * @return The number of networks written to out (0 if the hole is the
+ * whole network) or -1 if hole is not a subnet of net.
+ *
+ * The networks cover net minus hole, from the largest to the smallest
+ * as in Python's address_exclude().
+ *
+ * @code
+ *    cipv4_net net = {cipv4_str_to_uint("192.0.2.0"), 28};
+ *    cipv4_net hole = {cipv4_str_to_uint("192.0.2.1"), 32};
+ *    cipv4_net out[CIPV4_NET_MAX_EXCLUDE];
+ *    int n = cipv4_net_exclude(&net, &hole, out);
+ *    // 4: 192.0.2.8/29, 192.0.2.4/30, 192.0.2.2/31, 192.0.2.0/32
+ * @endcode
+ */
+int cipv4_net_exclude(const cipv4_net * net, const cipv4_net * hole, cipv4_net * out){
+    if (!out || cipv4_net_subnet_of(hole, net) != 1)
+        return -1;
+    int n = 0;
+    for (int p=net->network_prefix + 1; p<=hole->network_prefix; ++p){
+        uint32_t bit = 1u << (32 - p);
+        uint32_t mask = 0xFFFFFFFFu << (32 - p);
+        out[n].addr_start = (hole->addr_start & mask) ^ bit;
+        out[n].network_prefix = (uint8_t)p;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief For every network of a, test if it is in relation with any network of b
+ * @param a Networks tested
+ * @param n Number of networks in a
+ * @param b The other set
+ * @param m Number of networks in b
+ * @param relation CIPV4_NET_OVERLAPS, CIPV4_NET_SUBNET_OF (a[i] is inside a
+ * network of b) or CIPV4_NET_SUPERNET_OF (a[i] contains a network of b)
+ * @param flags User-provided array of n elements, flags[i] is set to 1 or 0
+ * @return The number of networks of a in relation with b or -1 in case of
+ * error (NULL array, wrong relation, prefix above 32 or memory allocation failure).
+ *
+ * b is sorted once (radix sort) and every network of a is a binary
+ * search, O(m + n log m) instead of n * m pair tests.
+ *
+ * @code
+ *    uint8_t * flags = malloc(n);
+ *    long int count = cipv4_net_match_any(inventory, n, allocated, m, CIPV4_NET_OVERLAPS, flags);
+ * @endcode
+ */
+long int cipv4_net_match_any(const cipv4_net * a, size_t n, const cipv4_net * b, size_t m,
+                             int relation, uint8_t * flags){
+    if ((!a || !flags) && n > 0)
+        return -1;
+    if ((!b && m > 0) || relation < CIPV4_NET_OVERLAPS || relation > CIPV4_NET_SUPERNET_OF)
+        return -1;
+    uint64_t * keys = m ? cipv4_net_keys(b, m, NULL) : NULL;
+    if (m && !keys)
+        return -1;
+    // first-level blocks of b for the overlap and subnet tests
+    uint32_t * bstart = NULL;
+    uint32_t * bend = NULL;
+    size_t nblocks = 0;
+    if (m && relation != CIPV4_NET_SUPERNET_OF){
+        bstart = (uint32_t*) malloc(m * sizeof(uint32_t));
+        bend = (uint32_t*) malloc(m * sizeof(uint32_t));
+        if (!bstart || !bend){
+            free(bstart);
+            free(bend);
+            free(keys);
+            return -1;
+        }
+        for (size_t j=0; j<m; ++j){
+            uint32_t start = CIPV4_NET_KEY_START(keys[j]);
+            uint8_t prefix = CIPV4_NET_KEY_PREFIX(keys[j]);
+            if (nblocks > 0 && start <= bend[nblocks - 1])
+                continue;       // inside the previous block
+            bstart[nblocks] = start;
+            bend[nblocks] = prefix == 0 ? 0xFFFFFFFF : start | ~(0xFFFFFFFFu << (32 - prefix));
+            nblocks++;
+        }
+    }
+    long int count = 0;
+    for (size_t i=0; i<n; ++i){
+        uint32_t start, end;
+        if (cipv4_net_bounds(&a[i], &start, &end) != 0){
+            count = -1;
+            break;
+        }
+        int hit = 0;
+        if (relation == CIPV4_NET_SUPERNET_OF){
+            // the longest prefix at the same start, then anything starting inside
+            size_t j = cipv4_net_upper_bound(keys, m, CIPV4_NET_KEY(start, 0xFF));
+            if (j > 0 && CIPV4_NET_KEY_START(keys[j - 1]) == start &&
+                    CIPV4_NET_KEY_PREFIX(keys[j - 1]) >= a[i].network_prefix)
+                hit = 1;
+            else if (j < m && CIPV4_NET_KEY_START(keys[j]) <= end)
+                hit = 1;
+        }
+        else{
+            size_t j = cipv4_net_upper_bound32(bstart, nblocks, relation == CIPV4_NET_OVERLAPS ? end : start);
+            if (j > 0)
+                hit = relation == CIPV4_NET_OVERLAPS ? bend[j - 1] >= start : bend[j - 1] >= end;
+        }
+        flags[i] = (uint8_t)hit;
+        count += hit;
+    }
+    free(bstart);
+    free(bend);
+    free(keys);
+    return count;
+}
+
+/**
+ * @brief Find the networks of a set which overlap another network of the same set
+ * @param nets Array of networks (e.g. an address inventory)
+ * @param n Number of networks
+ * @param flags User-provided array of n elements, flags[i] is set to 1 if
+ * nets[i] overlaps (contains, is inside or equals) another entry
+ * @return The number of overlapping networks or -1 in case of error.
+ *
+ * One radix sort and one sweep, O(n).
+ */
+long int cipv4_net_overlaps_within(const cipv4_net * nets, size_t n, uint8_t * flags){
+    if ((!nets || !flags) && n > 0)
+        return -1;
+    if (n == 0)
+        return 0;
+    uint32_t * index = NULL;
+    uint64_t * keys = cipv4_net_keys(nets, n, &index);
+    if (!keys)
+        return -1;
+    memset(flags, 0, n);
+    long int count = 0;
+    size_t top = 0;
+    uint32_t top_end = 0;
+    for (size_t j=0; j<n; ++j){
+        uint32_t start = CIPV4_NET_KEY_START(keys[j]);
+        uint8_t prefix = CIPV4_NET_KEY_PREFIX(keys[j]);
+        if (j > 0 && start <= top_end){
+            // inside the current first-level network: both overlap
+            count += !flags[index[top]] + !flags[index[j]];
+            flags[index[top]] = 1;
+            flags[index[j]] = 1;
+            continue;
+        }
+        top = j;
+        top_end = prefix == 0 ? 0xFFFFFFFF : start | ~(0xFFFFFFFFu << (32 - prefix));
+    }
+    free(keys);
+    free(index);
+    return count;
+}
+
+/**
+ * @brief Remove the networks which are inside another network of the set
+ * @param nets Array of networks
+ * @param n Number of networks
+ * @param out User-provided array of n elements (can be nets itself)
+ * @return The number of networks written to out or -1 in case of error.
+ *
+ * The result covers the same addresses as the input without any
+ * overlap: the first-level networks sorted by address, host bits cleared
+ * and duplicates kept once. One radix sort and one sweep, O(n).
+ *
+ * @code
+ *    // 10.0.0.0/8, 10.1.0.0/16, 10.0.0.0/8, 8.8.8.0/24 -> 8.8.8.0/24, 10.0.0.0/8
+ *    long int m = cipv4_net_outermost(nets, 4, nets);
+ * @endcode
+ */
+long int cipv4_net_outermost(const cipv4_net * nets, size_t n, cipv4_net * out){
+    if ((!nets || !out) && n > 0)
+        return -1;
+    if (n == 0)
+        return 0;
+    uint64_t * keys = cipv4_net_keys(nets, n, NULL);
+    if (!keys)
+        return -1;
+    long int count = 0;
+    uint32_t top_end = 0;
+    for (size_t j=0; j<n; ++j){
+        uint32_t start = CIPV4_NET_KEY_START(keys[j]);
+        uint8_t prefix = CIPV4_NET_KEY_PREFIX(keys[j]);
+        if (j > 0 && start <= top_end)
+            continue;       // inside the current first-level network
+        out[count].addr_start = start;
+        out[count].network_prefix = prefix;
+        count++;
+        top_end = prefix == 0 ? 0xFFFFFFFF : start | ~(0xFFFFFFFFu << (32 - prefix));
+    }
+    free(keys);
+    return count;
+}
+
+
+static int cipv4_net_bounds(const cipv4_net * net, uint32_t * start, uint32_t * end){
+    if (!net || net->network_prefix > 32)
+        return -1;
+    uint32_t mask = net->network_prefix == 0 ? 0 : 0xFFFFFFFFu << (32 - net->network_prefix);
+    *start = net->addr_start & mask;
+    *end = *start | ~mask;
+    return 0;
+}
+
+// sorted (start, prefix) keys of the networks and, if index is not NULL, their positions
+static uint64_t * cipv4_net_keys(const cipv4_net * nets, size_t n, uint32_t ** index){
+    if (n > UINT32_MAX)
+        return NULL;
+    uint64_t * keys = (uint64_t*) malloc(n * sizeof(uint64_t));
+    uint32_t * positions = index ? (uint32_t*) malloc(n * sizeof(uint32_t)) : NULL;
+    if (!keys || (index && !positions)){
+        free(keys);
+        free(positions);
+        return NULL;
+    }
+    for (size_t i=0; i<n; ++i){
+        uint32_t start, end;
+        if (cipv4_net_bounds(&nets[i], &start, &end) != 0){
+            free(keys);
+            free(positions);
+            return NULL;
+        }
+        keys[i] = CIPV4_NET_KEY(start, nets[i].network_prefix);
+        if (positions)
+            positions[i] = (uint32_t)i;
+    }
+    if (cipv4_net_sort(keys, positions, n) != 0){
+        free(keys);
+        free(positions);
+        return NULL;
+    }
+    if (index)
+        *index = positions;
+    return keys;
+}
+
+// LSD radix sort of the 40-bit keys (as cipv4_sort()), index follows the keys
+static int cipv4_net_sort(uint64_t * keys, uint32_t * index, size_t n){
+    if (n < 2)
+        return 0;
+    uint64_t * tmp = (uint64_t*) malloc(n * sizeof(uint64_t));
+    uint32_t * tmp_index = index ? (uint32_t*) malloc(n * sizeof(uint32_t)) : NULL;
+    if (!tmp || (index && !tmp_index)){
+        free(tmp);
+        free(tmp_index);
+        return -1;
+    }
+    size_t counts[5][256] = {{0}};
+    for (size_t i=0; i<n; ++i)
+        for (int pass=0; pass<5; ++pass)
+            counts[pass][(keys[i] >> (8 * pass)) & 0xFF]++;
+    uint64_t * src = keys;
+    uint64_t * dst = tmp;
+    uint32_t * isrc = index;
+    uint32_t * idst = tmp_index;
+    for (int pass=0; pass<5; ++pass){
+        size_t * c = counts[pass];
+        int shift = 8 * pass;
+        if (c[(src[0] >> shift) & 0xFF] == n)
+            continue;       // every key has the same byte here
+        size_t offset = 0;
+        for (int d=0; d<256; ++d){
+            size_t cnt = c[d];
+            c[d] = offset;
+            offset += cnt;
+        }
+        for (size_t i=0; i<n; ++i){
+            size_t to = c[(src[i] >> shift) & 0xFF]++;
+            dst[to] = src[i];
+            if (isrc)
+                idst[to] = isrc[i];
+        }
+        uint64_t * swap = src;
+        src = dst;
+        dst = swap;
+        uint32_t * iswap = isrc;
+        isrc = idst;
+        idst = iswap;
+    }
+    if (src != keys){
+        memcpy(keys, src, n * sizeof(uint64_t));
+        if (index)
+            memcpy(index, isrc, n * sizeof(uint32_t));
+    }
+    free(tmp);
+    free(tmp_index);
+    return 0;
+}
+
+// first position with a key above key
+static size_t cipv4_net_upper_bound(const uint64_t * keys, size_t n, uint64_t key){
+    size_t lo = 0, hi = n;
+    while (lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static size_t cipv4_net_upper_bound32(const uint32_t * values, size_t n, uint32_t value){
+    size_t lo = 0, hi = n;
+    while (lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] <= value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,364 @@
+/// @file cipv4_pcap.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cipv4_pcap.h>
+#include <cipv4_flow.h>
+
+
+#define CIPV4_PCAP_HEADER 24
+#define CIPV4_PCAP_RECORD 16
+#define CIPV4_PCAP_MAX_THREADS 64
+#define CIPV4_PCAP_MIN_CHUNK (1 << 14)
+#define CIPV4_PCAP_MAX_PACKET (1 << 18)
+#define CIPV4_PCAP_SYNC 8           // records checked to find a record boundary
+#define CIPV4_PCAP_SYNC_SECONDS 3600 // maximum time between them
+#define CIPV4_PCAP_BATCH 128        // packets classified together
+
+typedef struct _cipv4_pcap_job cipv4_pcap_job;
+struct _cipv4_pcap_job{
+    const cipv4_pcap * pcap;
+    const cipv4_acl * acl;
+    size_t start;
+    size_t end;
+    size_t stop;                    // offset where the walk stopped
+    cipv4_pcap_totals * totals;
+};
+
+static uint32_t cipv4_pcap_u32(const cipv4_pcap * pcap, const unsigned char * p);
+static int cipv4_pcap_plausible(const cipv4_pcap * pcap, size_t offset);
+static size_t cipv4_pcap_sync(const cipv4_pcap * pcap, size_t offset);
+static const unsigned char * cipv4_pcap_ipv4(const cipv4_pcap * pcap, const unsigned char * p, uint32_t caplen);
+static cipv4_pcap_totals * cipv4_pcap_totals_new(uint32_t nrules);
+static void cipv4_pcap_totals_add(cipv4_pcap_totals * totals, const cipv4_pcap_totals * part);
+static void cipv4_pcap_flush(const cipv4_acl * acl, cipv4_pcap_totals * totals, const uint32_t * fields,
+                             const uint32_t * lengths, uint32_t count);
+static void * cipv4_pcap_worker(void * arg);
+
+
+/**
+ * @brief Map a classic pcap file
+ * @param path Path of the file
+ * @return A pointer to the mapped file or NULL in case of error
+ * (can not open the file or not a pcap file).
+ *
+ * Both byte orders and the micro/nanosecond variants are accepted.
+ * The file is mapped read-only and never copied.
+ */
+cipv4_pcap * cipv4_pcap_open(const char * path){
+    if (!path)
+        return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < CIPV4_PCAP_HEADER){
+        close(fd);
+        return NULL;
+    }
+    void * data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    cipv4_pcap * pcap = (cipv4_pcap*) calloc(1, sizeof(cipv4_pcap));
+    if (!pcap){
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+    pcap->data = (const unsigned char*) data;
+    pcap->size = (size_t)st.st_size;
+    uint32_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    switch (magic){
+        case 0xA1B2C3D4: break;
+        case 0xD4C3B2A1: pcap->swapped = 1; break;
+        case 0xA1B23C4D: pcap->nanosecond = 1; break;
+        case 0x4D3CB2A1: pcap->swapped = 1; pcap->nanosecond = 1; break;
+        default:
+            cipv4_pcap_close(pcap);
+            return NULL;
+    }
+    pcap->snaplen = cipv4_pcap_u32(pcap, pcap->data + 16);
+    pcap->linktype = cipv4_pcap_u32(pcap, pcap->data + 20) & 0xFFFF;
+    madvise(data, pcap->size, MADV_SEQUENTIAL);
+    return pcap;
+}
+
+/**
+ * @brief Unmap the file
+ * @param pcap The file returned by cipv4_pcap_open() (can be NULL)
+ * @return nothing
+ */
+void cipv4_pcap_close(cipv4_pcap * pcap){
+    if (!pcap)
+        return;
+    munmap((void*)pcap->data, pcap->size);
+    free(pcap);
+}
+
+/**
+ * @brief Classify and look up the IPv4 source and destination of every packet
+ * @param pcap The file returned by cipv4_pcap_open()
+ * @param acl Compiled ACL (e.g. cipv4_acl_compile_lpm() of a CIDR database) or NULL
+ * @param nthreads Number of threads
+ * @return The totals (free with cipv4_pcap_totals_free()) or NULL in case
+ * of error.
+ *
+ * The file is split into chunks of about the same size, the first record
+ * of a chunk is found by checking that several record headers chain
+ * correctly. If a chunk does not end exactly where the next one starts
+ * the whole file is walked again by one thread, so the totals never
+ * depend on the number of threads. The walk stops at the first truncated
+ * record. Ethernet (with VLAN tags), Linux cooked, BSD loopback and raw
+ * IPv4 link types are supported, other packets are only counted in
+ * totals->packets.
+ */
+cipv4_pcap_totals * cipv4_pcap_analyze(const cipv4_pcap * pcap, const cipv4_acl * acl, int nthreads){
+    if (!pcap)
+        return NULL;
+    uint32_t nrules = acl ? acl->nrules : 0;
+    size_t body = pcap->size - CIPV4_PCAP_HEADER;
+    if (nthreads > CIPV4_PCAP_MAX_THREADS)
+        nthreads = CIPV4_PCAP_MAX_THREADS;
+    if ((size_t)nthreads > body / CIPV4_PCAP_MIN_CHUNK)
+        nthreads = (int)(body / CIPV4_PCAP_MIN_CHUNK);
+    if (nthreads < 1)
+        nthreads = 1;
+    pthread_t threads[CIPV4_PCAP_MAX_THREADS];
+    cipv4_pcap_job jobs[CIPV4_PCAP_MAX_THREADS];
+    int started[CIPV4_PCAP_MAX_THREADS] = {0};
+    int failed = 0;
+    size_t start = CIPV4_PCAP_HEADER;
+    for (int t=0; t<nthreads; ++t){
+        jobs[t].pcap = pcap;
+        jobs[t].acl = acl;
+        jobs[t].start = start;
+        if (t + 1 < nthreads){
+            size_t guess = CIPV4_PCAP_HEADER + body / nthreads * (t + 1);
+            jobs[t].end = cipv4_pcap_sync(pcap, guess > start ? guess : start);
+        }
+        else
+            jobs[t].end = pcap->size;
+        start = jobs[t].end;
+        jobs[t].totals = cipv4_pcap_totals_new(nrules);
+        if (!jobs[t].totals)
+            failed = 1;
+    }
+    for (int t=1; t<nthreads && !failed; ++t)
+        if (pthread_create(&threads[t], NULL, cipv4_pcap_worker, &jobs[t]) == 0)
+            started[t] = 1;
+    for (int t=0; t<nthreads && !failed; ++t)
+        if (!started[t])
+            cipv4_pcap_worker(&jobs[t]);
+    for (int t=1; t<nthreads; ++t)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    cipv4_pcap_totals * totals = failed ? NULL : cipv4_pcap_totals_new(nrules);
+    int aligned = 1;
+    for (int t=0; t + 1<nthreads; ++t)
+        if (jobs[t].stop != jobs[t].end)
+            aligned = 0;
+    if (totals && aligned){
+        for (int t=0; t<nthreads; ++t)
+            cipv4_pcap_totals_add(totals, jobs[t].totals);
+    }
+    else if (totals){
+        // a chunk started at a wrong boundary
+        cipv4_pcap_job job = {pcap, acl, CIPV4_PCAP_HEADER, pcap->size, 0, totals};
+        cipv4_pcap_worker(&job);
+    }
+    for (int t=0; t<nthreads; ++t)
+        cipv4_pcap_totals_free(jobs[t].totals);
+    return totals;
+}
+
+/**
+ * @brief Free the totals returned by cipv4_pcap_analyze()
+ * @param totals The totals (can be NULL)
+ * @return nothing
+ */
+void cipv4_pcap_totals_free(cipv4_pcap_totals * totals){
+    if (!totals)
+        return;
+    for (int d=0; d<2; ++d){
+        free(totals->rule_packets[d]);
+        free(totals->rule_bytes[d]);
+    }
+    free(totals);
+}
+
+
+static uint32_t cipv4_pcap_u32(const cipv4_pcap * pcap, const unsigned char * p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return pcap->swapped ? __builtin_bswap32(v) : v;
+}
+
+// CIPV4_PCAP_SYNC record headers starting at offset chain correctly
+static int cipv4_pcap_plausible(const cipv4_pcap * pcap, size_t offset){
+    uint32_t max_fraction = pcap->nanosecond ? 1000000000 : 1000000;
+    uint32_t snaplen = pcap->snaplen ? pcap->snaplen : CIPV4_PCAP_MAX_PACKET;
+    uint32_t first_second = 0;
+    for (int i=0; i<CIPV4_PCAP_SYNC; ++i){
+        if (offset == pcap->size)
+            return 1;
+        if (pcap->size - offset < CIPV4_PCAP_RECORD)
+            return 0;
+        const unsigned char * h = pcap->data + offset;
+        uint32_t second = cipv4_pcap_u32(pcap, h);
+        uint32_t fraction = cipv4_pcap_u32(pcap, h + 4);
+        uint32_t caplen = cipv4_pcap_u32(pcap, h + 8);
+        uint32_t origlen = cipv4_pcap_u32(pcap, h + 12);
+        if (i == 0)
+            first_second = second;
+        // runs of zeros inside packets must not look like empty records
+        if (origlen == 0 || second - first_second + CIPV4_PCAP_SYNC_SECONDS > 2 * CIPV4_PCAP_SYNC_SECONDS
+                || fraction >= max_fraction || caplen > snaplen || caplen > origlen || origlen > CIPV4_PCAP_MAX_PACKET
+                || caplen > pcap->size - offset - CIPV4_PCAP_RECORD)
+            return 0;
+        offset += CIPV4_PCAP_RECORD + caplen;
+    }
+    return 1;
+}
+
+// first offset at or after `offset` which looks like a record boundary
+static size_t cipv4_pcap_sync(const cipv4_pcap * pcap, size_t offset){
+    for (; offset + CIPV4_PCAP_RECORD <= pcap->size; ++offset)
+        if (cipv4_pcap_plausible(pcap, offset))
+            return offset;
+    return pcap->size;
+}
+
+// IPv4 header of a packet or NULL
+static const unsigned char * cipv4_pcap_ipv4(const cipv4_pcap * pcap, const unsigned char * p, uint32_t caplen){
+    uint32_t offset = 0;
+    uint32_t type = 0x0800;
+    switch (pcap->linktype){
+        case CIPV4_PCAP_LINKTYPE_ETHERNET:
+            if (caplen < 14)
+                return NULL;
+            type = (uint32_t)p[12] << 8 | p[13];
+            offset = 14;
+            while ((type == 0x8100 || type == 0x88A8) && offset + 4 <= caplen){
+                type = (uint32_t)p[offset + 2] << 8 | p[offset + 3];
+                offset += 4;
+            }
+            break;
+        case CIPV4_PCAP_LINKTYPE_LINUX_SLL:
+            if (caplen < 16)
+                return NULL;
+            type = (uint32_t)p[14] << 8 | p[15];
+            offset = 16;
+            break;
+        case CIPV4_PCAP_LINKTYPE_NULL:
+            // AF_INET in the byte order of the capturing host
+            if (caplen < 4 || !((p[0] == 2 && !p[1] && !p[2] && !p[3]) || (!p[0] && !p[1] && !p[2] && p[3] == 2)))
+                return NULL;
+            offset = 4;
+            break;
+        case CIPV4_PCAP_LINKTYPE_RAW:
+        case CIPV4_PCAP_LINKTYPE_IPV4:
+            break;
+        default:
+            return NULL;
+    }
+    if (type != 0x0800 || caplen < offset + 20 || (p[offset] >> 4) != 4 || (p[offset] & 0x0F) < 5)
+        return NULL;
+    return p + offset;
+}
+
+static cipv4_pcap_totals * cipv4_pcap_totals_new(uint32_t nrules){
+    cipv4_pcap_totals * totals = (cipv4_pcap_totals*) calloc(1, sizeof(cipv4_pcap_totals));
+    if (!totals)
+        return NULL;
+    totals->nrules = nrules;
+    for (int d=0; d<2; ++d){
+        totals->rule_packets[d] = (uint64_t*) calloc(nrules + 1, sizeof(uint64_t));
+        totals->rule_bytes[d] = (uint64_t*) calloc(nrules + 1, sizeof(uint64_t));
+        if (!totals->rule_packets[d] || !totals->rule_bytes[d]){
+            cipv4_pcap_totals_free(totals);
+            return NULL;
+        }
+    }
+    return totals;
+}
+
+static void cipv4_pcap_totals_add(cipv4_pcap_totals * totals, const cipv4_pcap_totals * part){
+    totals->packets += part->packets;
+    totals->bytes += part->bytes;
+    totals->ipv4_packets += part->ipv4_packets;
+    totals->ipv4_bytes += part->ipv4_bytes;
+    for (int d=0; d<2; ++d){
+        for (uint32_t r=0; r<=totals->nrules; ++r){
+            totals->rule_packets[d][r] += part->rule_packets[d][r];
+            totals->rule_bytes[d][r] += part->rule_bytes[d][r];
+        }
+        for (int c=0; c<CIPV4_PCAP_CLASSES; ++c){
+            totals->class_packets[d][c] += part->class_packets[d][c];
+            totals->class_bytes[d][c] += part->class_bytes[d][c];
+        }
+    }
+}
+
+// fields holds the network-order source and destination of count packets
+static void cipv4_pcap_flush(const cipv4_acl * acl, cipv4_pcap_totals * totals, const uint32_t * fields,
+                             const uint32_t * lengths, uint32_t count){
+    uint8_t classes[2 * CIPV4_PCAP_BATCH];
+    int rules[2 * CIPV4_PCAP_BATCH];
+    cipv4_flow_classify(fields, sizeof(uint32_t), 2 * count, acl, NULL, classes, rules);
+    for (uint32_t k=0; k<count; ++k){
+        for (int d=0; d<2; ++d){
+            uint32_t r = acl && rules[2 * k + d] >= 0 ? (uint32_t)rules[2 * k + d] : totals->nrules;
+            totals->rule_packets[d][r]++;
+            totals->rule_bytes[d][r] += lengths[k];
+            for (uint32_t bits=classes[2 * k + d]; bits; bits&=bits - 1){
+                int c = __builtin_ctz(bits);
+                totals->class_packets[d][c]++;
+                totals->class_bytes[d][c] += lengths[k];
+            }
+        }
+    }
+}
+
+// walk the records starting in [start, end)
+static void * cipv4_pcap_worker(void * arg){
+    cipv4_pcap_job * job = (cipv4_pcap_job*) arg;
+    const cipv4_pcap * pcap = job->pcap;
+    cipv4_pcap_totals * totals = job->totals;
+    uint32_t fields[2 * CIPV4_PCAP_BATCH];
+    uint32_t lengths[CIPV4_PCAP_BATCH];
+    uint32_t count = 0;
+    size_t offset = job->start;
+    while (offset < job->end){
+        if (pcap->size - offset < CIPV4_PCAP_RECORD)
+            break;
+        const unsigned char * h = pcap->data + offset;
+        uint32_t caplen = cipv4_pcap_u32(pcap, h + 8);
+        uint32_t origlen = cipv4_pcap_u32(pcap, h + 12);
+        if (caplen > pcap->size - offset - CIPV4_PCAP_RECORD)
+            break;
+        totals->packets++;
+        totals->bytes += origlen;
+        const unsigned char * ip = cipv4_pcap_ipv4(pcap, h + CIPV4_PCAP_RECORD, caplen);
+        if (ip){
+            totals->ipv4_packets++;
+            totals->ipv4_bytes += origlen;
+            memcpy(&fields[2 * count], ip + 12, 2 * sizeof(uint32_t));
+            lengths[count++] = origlen;
+            if (count == CIPV4_PCAP_BATCH){
+                cipv4_pcap_flush(job->acl, totals, fields, lengths, count);
+                count = 0;
+            }
+        }
+        offset += CIPV4_PCAP_RECORD + caplen;
+    }
+    cipv4_pcap_flush(job->acl, totals, fields, lengths, count);
+    job->stop = offset < job->end ? pcap->size : offset;
+    return NULL;
+}
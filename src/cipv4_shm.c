@@ -0,0 +1,329 @@
+/// @file cipv4_shm.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cipv4_shm.h>
+
+
+#define CIPV4_SHM_ALIGN 64
+#define CIPV4_SHM_RETRIES 16
+
+typedef struct _cipv4_shm_control cipv4_shm_control;
+struct _cipv4_shm_control{
+    uint64_t magic;
+    _Atomic uint64_t generation;        // last published table, 0 if none
+};
+
+typedef struct _cipv4_shm_header cipv4_shm_header;
+struct _cipv4_shm_header{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t nrules;
+    uint64_t generation;
+    uint64_t size;                      // size of the whole segment
+    int32_t default_action;
+    uint32_t nchunks;
+    uint32_t nranges;
+    uint32_t nshadowed;
+    uint64_t off_tbl16;
+    uint64_t off_chunks;
+    uint64_t off_actions;
+    uint64_t off_ranges;
+    uint64_t off_shadowed;
+};
+
+static int cipv4_shm_data_name(const char * name, uint64_t generation, char * buffer);
+static void * cipv4_shm_map(const char * name, int writable, size_t * size);
+static size_t cipv4_shm_place(size_t * offset, size_t bytes);
+static int cipv4_shm_check(const cipv4_shm_header * h, uint64_t generation, size_t size);
+
+
+/**
+ * @brief Publish a compiled ACL in shared memory
+ * @param name Name of the table, as for shm_open() ("/name", no other slash)
+ * @param acl The compiled ACL returned by cipv4_acl_compile()
+ * @return The generation of the published table or -1 in case of error.
+ *
+ * The table is copied into a new segment "/name.<generation>" (usually
+ * under /dev/shm) and the generation stored in the control segment "/name"
+ * is then increased atomically. Readers see either the previous or the new
+ * table, never a partial one. The segment of the previous generation is
+ * unlinked: processes which still map it keep using it until they call
+ * cipv4_shm_refresh(). Only one process should publish a given name.
+ *
+ * @code
+ *    // loader
+ *    cipv4_acl * acl = cipv4_acl_compile(rules, nrules, CIPV4_ACL_DENY);
+ *    cipv4_shm_publish("/blocklist", acl);
+ *    cipv4_acl_free(acl);
+ *
+ *    // worker
+ *    cipv4_shm_reader * reader = cipv4_shm_open("/blocklist");
+ *    for (;;){
+ *        cipv4_shm_refresh(reader);  // switch to the newest table if any
+ *        int action = cipv4_acl_lookup(&reader->acl, addr);
+ *        ...
+ *    }
+ * @endcode
+ */
+int64_t cipv4_shm_publish(const char * name, const cipv4_acl * acl){
+    char data_name[CIPV4_SHM_NAME_LENGTH + 24];
+    if (!acl || cipv4_shm_data_name(name, 0, data_name) != 0)
+        return -1;
+    size_t control_size = sizeof(cipv4_shm_control);
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < control_size && ftruncate(fd, control_size) != 0)){
+        close(fd);
+        return -1;
+    }
+    cipv4_shm_control * control = (cipv4_shm_control*) mmap(NULL, control_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (control == MAP_FAILED)
+        return -1;
+    if (control->magic != CIPV4_SHM_MAGIC){
+        if (control->magic != 0){
+            munmap(control, control_size);
+            return -1;
+        }
+        control->magic = CIPV4_SHM_MAGIC;
+    }
+    uint64_t generation = atomic_load_explicit(&control->generation, memory_order_relaxed) + 1;
+
+    size_t offset = sizeof(cipv4_shm_header);
+    cipv4_shm_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = CIPV4_SHM_MAGIC;
+    h.version = CIPV4_SHM_VERSION;
+    h.nrules = acl->nrules;
+    h.generation = generation;
+    h.default_action = acl->default_action;
+    h.nchunks = acl->nchunks;
+    h.nranges = acl->nranges;
+    h.nshadowed = acl->nshadowed;
+    h.off_tbl16 = cipv4_shm_place(&offset, 65536 * sizeof(uint32_t));
+    h.off_chunks = cipv4_shm_place(&offset, (size_t)acl->nchunks * 256 * sizeof(uint32_t));
+    h.off_actions = cipv4_shm_place(&offset, (size_t)acl->nrules * sizeof(int));
+    h.off_ranges = cipv4_shm_place(&offset, (size_t)acl->nranges * sizeof(cipv4_acl_range));
+    h.off_shadowed = cipv4_shm_place(&offset, (size_t)acl->nshadowed * sizeof(uint32_t));
+    h.size = offset;
+
+    // a leftover of an interrupted publish is never read, replace it
+    cipv4_shm_data_name(name, generation, data_name);
+    shm_unlink(data_name);
+    fd = shm_open(data_name, O_RDWR | O_CREAT | O_EXCL, 0444);
+    if (fd < 0 || ftruncate(fd, h.size) != 0){
+        if (fd >= 0){
+            close(fd);
+            shm_unlink(data_name);
+        }
+        munmap(control, control_size);
+        return -1;
+    }
+    unsigned char * data = (unsigned char*) mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED){
+        shm_unlink(data_name);
+        munmap(control, control_size);
+        return -1;
+    }
+    memcpy(data, &h, sizeof(h));
+    memcpy(data + h.off_tbl16, acl->tbl16, 65536 * sizeof(uint32_t));
+    if (acl->nchunks)
+        memcpy(data + h.off_chunks, acl->chunks, (size_t)acl->nchunks * 256 * sizeof(uint32_t));
+    if (acl->nrules)
+        memcpy(data + h.off_actions, acl->actions, (size_t)acl->nrules * sizeof(int));
+    if (acl->nranges)
+        memcpy(data + h.off_ranges, acl->ranges, (size_t)acl->nranges * sizeof(cipv4_acl_range));
+    if (acl->nshadowed)
+        memcpy(data + h.off_shadowed, acl->shadowed, (size_t)acl->nshadowed * sizeof(uint32_t));
+    munmap(data, h.size);
+
+    // the release store makes the whole table visible before the generation
+    atomic_store_explicit(&control->generation, generation, memory_order_release);
+    munmap(control, control_size);
+    if (generation > 1){
+        cipv4_shm_data_name(name, generation - 1, data_name);
+        shm_unlink(data_name);
+    }
+    return (int64_t)generation;
+}
+
+/**
+ * @brief Remove a table published by cipv4_shm_publish()
+ * @param name Name of the table
+ * @return 0 in case of success or -1 if the table does not exist.
+ *
+ * Processes which map the table keep their current version.
+ */
+int cipv4_shm_unlink(const char * name){
+    char data_name[CIPV4_SHM_NAME_LENGTH + 24];
+    if (cipv4_shm_data_name(name, 0, data_name) != 0)
+        return -1;
+    size_t size = 0;
+    cipv4_shm_control * control = (cipv4_shm_control*) cipv4_shm_map(name, 0, &size);
+    if (control){
+        if (size >= sizeof(cipv4_shm_control) && control->magic == CIPV4_SHM_MAGIC){
+            cipv4_shm_data_name(name, atomic_load_explicit(&control->generation, memory_order_acquire), data_name);
+            shm_unlink(data_name);
+        }
+        munmap(control, size);
+    }
+    return shm_unlink(name) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Map the newest version of a published table (read-only)
+ * @param name Name of the table
+ * @return A pointer to the reader or NULL in case of error (nothing
+ * published yet or memory allocation failure).
+ *
+ * Nothing is copied or rebuilt, reader->acl can be passed to
+ * cipv4_acl_match() and cipv4_acl_lookup() right away. It must not be
+ * freed with cipv4_acl_free(), use cipv4_shm_close() instead.
+ */
+cipv4_shm_reader * cipv4_shm_open(const char * name){
+    char data_name[CIPV4_SHM_NAME_LENGTH + 24];
+    if (cipv4_shm_data_name(name, 0, data_name) != 0)
+        return NULL;
+    cipv4_shm_reader * reader = (cipv4_shm_reader*) calloc(1, sizeof(cipv4_shm_reader));
+    if (!reader)
+        return NULL;
+    strcpy(reader->name, name);
+    size_t size = 0;
+    reader->control = cipv4_shm_map(name, 0, &size);
+    if (!reader->control || size < sizeof(cipv4_shm_control)
+            || ((cipv4_shm_control*)reader->control)->magic != CIPV4_SHM_MAGIC
+            || cipv4_shm_refresh(reader) != 1){
+        cipv4_shm_close(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+/**
+ * @brief Switch to the newest published version of the table
+ * @param reader The reader returned by cipv4_shm_open()
+ * @return 1 if a newer version is mapped, 0 if the reader is up to date
+ * or -1 in case of error (the current version stays mapped).
+ *
+ * When nothing changed the cost is one atomic load, so workers can call
+ * it before every batch of lookups. The pointers of reader->acl are
+ * invalid after a switch.
+ */
+int cipv4_shm_refresh(cipv4_shm_reader * reader){
+    char data_name[CIPV4_SHM_NAME_LENGTH + 24];
+    cipv4_shm_control * control = (cipv4_shm_control*) reader->control;
+    for (int attempt=0; attempt<CIPV4_SHM_RETRIES; ++attempt){
+        uint64_t generation = atomic_load_explicit(&control->generation, memory_order_acquire);
+        if (generation == reader->generation)
+            return 0;
+        if (generation == 0)
+            return -1;
+        cipv4_shm_data_name(reader->name, generation, data_name);
+        size_t size = 0;
+        errno = 0;
+        unsigned char * data = (unsigned char*) cipv4_shm_map(data_name, 0, &size);
+        if (!data){
+            // replaced by a newer generation in the meantime
+            if (errno == ENOENT)
+                continue;
+            return -1;
+        }
+        const cipv4_shm_header * h = (const cipv4_shm_header*) data;
+        if (cipv4_shm_check(h, generation, size) != 0){
+            munmap(data, size);
+            return -1;
+        }
+        if (reader->data)
+            munmap(reader->data, reader->data_size);
+        reader->data = data;
+        reader->data_size = size;
+        reader->generation = generation;
+        reader->acl.tbl16 = (uint32_t*)(data + h->off_tbl16);
+        reader->acl.chunks = (uint32_t*)(data + h->off_chunks);
+        reader->acl.nchunks = h->nchunks;
+        reader->acl.actions = (int*)(data + h->off_actions);
+        reader->acl.nrules = h->nrules;
+        reader->acl.default_action = h->default_action;
+        reader->acl.ranges = (cipv4_acl_range*)(data + h->off_ranges);
+        reader->acl.nranges = h->nranges;
+        reader->acl.shadowed = (uint32_t*)(data + h->off_shadowed);
+        reader->acl.nshadowed = h->nshadowed;
+        return 1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Unmap the table and free the reader
+ * @param reader The reader returned by cipv4_shm_open() (can be NULL)
+ * @return nothing
+ */
+void cipv4_shm_close(cipv4_shm_reader * reader){
+    if (!reader)
+        return;
+    if (reader->data)
+        munmap(reader->data, reader->data_size);
+    if (reader->control)
+        munmap(reader->control, sizeof(cipv4_shm_control));
+    free(reader);
+}
+
+
+// "/name" -> "/name.<generation>", checks that name is usable by shm_open()
+static int cipv4_shm_data_name(const char * name, uint64_t generation, char * buffer){
+    if (!name || name[0] != '/' || name[1] == '\0' || strlen(name) >= CIPV4_SHM_NAME_LENGTH || strchr(name + 1, '/'))
+        return -1;
+    sprintf(buffer, "%s.%llu", name, (unsigned long long)generation);
+    return 0;
+}
+
+// map a whole segment, returns NULL and keeps errno on failure
+static void * cipv4_shm_map(const char * name, int writable, size_t * size){
+    int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void * p = mmap(NULL, (size_t)st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+    *size = (size_t)st.st_size;
+    return p;
+}
+
+// reserve an aligned array in the segment and return its offset
+static size_t cipv4_shm_place(size_t * offset, size_t bytes){
+    size_t start = (*offset + CIPV4_SHM_ALIGN - 1) & ~(size_t)(CIPV4_SHM_ALIGN - 1);
+    *offset = start + bytes;
+    return start;
+}
+
+// the header must describe arrays inside the segment
+static int cipv4_shm_check(const cipv4_shm_header * h, uint64_t generation, size_t size){
+    if (size < sizeof(cipv4_shm_header) || h->magic != CIPV4_SHM_MAGIC || h->version != CIPV4_SHM_VERSION
+            || h->generation != generation || h->size != size)
+        return -1;
+    if (h->off_tbl16 > size || size - h->off_tbl16 < 65536 * sizeof(uint32_t)
+            || h->off_chunks > size || (size - h->off_chunks) / (256 * sizeof(uint32_t)) < h->nchunks
+            || h->off_actions > size || (size - h->off_actions) / sizeof(int) < h->nrules
+            || h->off_ranges > size || (size - h->off_ranges) / sizeof(cipv4_acl_range) < h->nranges
+            || h->off_shadowed > size || (size - h->off_shadowed) / sizeof(uint32_t) < h->nshadowed)
+        return -1;
+    return 0;
+}
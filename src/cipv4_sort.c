@@ -0,0 +1,296 @@
+/// @file cipv4_sort.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cipv4_sort.h>
+
+
+#define CIPV4_SORT_SMALL 64
+#define CIPV4_SORT_MAX_THREADS 64
+#define CIPV4_SORT_PARALLEL_MIN (1 << 16)
+
+typedef struct _cipv4_sort_shared cipv4_sort_shared;
+struct _cipv4_sort_shared{
+    uint32_t * addrs;
+    uint32_t * tmp;
+    size_t n;
+    int nthreads;                 // threads actually running, set before go
+    int skip;                     // every address has the same byte in this pass
+    int go;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_barrier_t barrier;
+    size_t counts[CIPV4_SORT_MAX_THREADS][256];
+};
+
+typedef struct _cipv4_sort_job cipv4_sort_job;
+struct _cipv4_sort_job{
+    cipv4_sort_shared * shared;
+    int id;
+};
+
+static void cipv4_sort_insertion(uint32_t * addrs, size_t n);
+static void * cipv4_sort_worker(void * arg);
+static uint32_t * cipv4_sort_passes(cipv4_sort_shared * shared, int id);
+static void cipv4_sort_offsets(cipv4_sort_shared * shared);
+
+
+/**
+ * @brief Sort an array of IP addresses (LSD radix sort)
+ * @param addrs Array of IP addresses in a form of 32-bit integer
+ * @param n Number of elements in the array
+ * @return 0 in case of success or -1 in case of failure
+ * (NULL array or memory allocation failure).
+ *
+ * The function allocates a temporary buffer of the same size as the
+ * input. Passes where all the addresses share the same byte are skipped.
+ */
+int cipv4_sort(uint32_t * addrs, size_t n){
+    if (!addrs)
+        return -1;
+    if (n < CIPV4_SORT_SMALL){
+        cipv4_sort_insertion(addrs, n);
+        return 0;
+    }
+    uint32_t * tmp = (uint32_t*) malloc(n * sizeof(uint32_t));
+    if (!tmp)
+        return -1;
+    static const int shifts[4] = {0, 8, 16, 24};
+    size_t counts[4][256] = {{0}};
+    for (size_t i=0; i<n; ++i){
+        uint32_t v = addrs[i];
+        counts[0][v & 0xFF]++;
+        counts[1][(v >> 8) & 0xFF]++;
+        counts[2][(v >> 16) & 0xFF]++;
+        counts[3][v >> 24]++;
+    }
+    uint32_t * src = addrs;
+    uint32_t * dst = tmp;
+    for (int pass=0; pass<4; ++pass){
+        size_t * c = counts[pass];
+        int shift = shifts[pass];
+        if (c[(src[0] >> shift) & 0xFF] == n)
+            continue;       // every address has the same byte here
+        size_t offset = 0;
+        for (int d=0; d<256; ++d){
+            size_t cnt = c[d];
+            c[d] = offset;
+            offset += cnt;
+        }
+        for (size_t i=0; i<n; ++i){
+            uint32_t v = src[i];
+            dst[c[(v >> shift) & 0xFF]++] = v;
+        }
+        uint32_t * swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != addrs)
+        memcpy(addrs, src, n * sizeof(uint32_t));
+    free(tmp);
+    return 0;
+}
+
+/**
+ * @brief Multi-threaded version of cipv4_sort()
+ * @param addrs Array of IP addresses in a form of 32-bit integer
+ * @param n Number of elements in the array
+ * @param nthreads Number of threads to use (at most 64)
+ * @return 0 in case of success or -1 in case of failure.
+ *
+ * The threads are created once and run the four passes together, a
+ * barrier separates the histogram and scatter phases. Every thread builds
+ * the histogram of its own slice and scatters it to the offsets reserved
+ * for it, so no locking is needed. If a thread can not be created the
+ * slices are shared by the threads already running. Small arrays or
+ * nthreads <= 1 fall back to cipv4_sort().
+ */
+int cipv4_sort_parallel(uint32_t * addrs, size_t n, int nthreads){
+    if (!addrs)
+        return -1;
+    if (nthreads > CIPV4_SORT_MAX_THREADS)
+        nthreads = CIPV4_SORT_MAX_THREADS;
+    if (nthreads <= 1 || n < CIPV4_SORT_PARALLEL_MIN)
+        return cipv4_sort(addrs, n);
+    cipv4_sort_shared * shared = (cipv4_sort_shared*) malloc(sizeof(cipv4_sort_shared));
+    uint32_t * tmp = (uint32_t*) malloc(n * sizeof(uint32_t));
+    if (!shared || !tmp){
+        free(shared);
+        free(tmp);
+        return -1;
+    }
+    shared->addrs = addrs;
+    shared->tmp = tmp;
+    shared->n = n;
+    shared->go = 0;
+    pthread_mutex_init(&shared->lock, NULL);
+    pthread_cond_init(&shared->start, NULL);
+    pthread_t threads[CIPV4_SORT_MAX_THREADS];
+    cipv4_sort_job jobs[CIPV4_SORT_MAX_THREADS];
+    int running = 1;                // the calling thread is thread 0
+    for (int t=1; t<nthreads; ++t){
+        jobs[t].shared = shared;
+        jobs[t].id = t;
+        if (pthread_create(&threads[t], NULL, cipv4_sort_worker, &jobs[t]) != 0)
+            break;
+        running++;
+    }
+    // the slices and the barrier depend on the number of threads running
+    shared->nthreads = running;
+    pthread_barrier_init(&shared->barrier, NULL, (unsigned int)running);
+    pthread_mutex_lock(&shared->lock);
+    shared->go = 1;
+    pthread_cond_broadcast(&shared->start);
+    pthread_mutex_unlock(&shared->lock);
+    uint32_t * sorted = cipv4_sort_passes(shared, 0);
+    for (int t=1; t<running; ++t)
+        pthread_join(threads[t], NULL);
+    if (sorted != addrs)
+        memcpy(addrs, sorted, n * sizeof(uint32_t));
+    pthread_barrier_destroy(&shared->barrier);
+    pthread_cond_destroy(&shared->start);
+    pthread_mutex_destroy(&shared->lock);
+    free(tmp);
+    free(shared);
+    return 0;
+}
+
+/**
+ * @brief Remove the duplicate addresses from a sorted array
+ * @param addrs Sorted array of IP addresses (e.g. by cipv4_sort())
+ * @param n Number of elements in the array
+ * @return The number of unique addresses kept at the beginning of the array.
+ */
+size_t cipv4_dedup(uint32_t * addrs, size_t n){
+    if (!addrs || n == 0)
+        return 0;
+    size_t j = 1;
+    for (size_t i=1; i<n; ++i)
+        if (addrs[i] != addrs[j - 1])
+            addrs[j++] = addrs[i];
+    return j;
+}
+
+/**
+ * @brief Counts the number of distinct networks with the given prefix
+ * @param addrs Sorted array of IP addresses (e.g. by cipv4_sort())
+ * @param n Number of elements in the array
+ * @param network_prefix prefix len between 0~32 (24 counts unique /24s)
+ * @return The number of distinct networks (0 for an empty or NULL array).
+ */
+size_t cipv4_count_distinct(const uint32_t * addrs, size_t n, uint8_t network_prefix){
+    if (!addrs || n == 0)
+        return 0;
+    if (network_prefix == 0)
+        return 1;
+    if (network_prefix > 32)
+        network_prefix = 32;
+    int shift = 32 - network_prefix;
+    size_t count = 1;
+    for (size_t i=1; i<n; ++i)
+        count += (addrs[i] >> shift) != (addrs[i - 1] >> shift);
+    return count;
+}
+
+/**
+ * @brief Counts the number of distinct networks for every prefix len in one pass
+ * @param addrs Sorted array of IP addresses (e.g. by cipv4_sort())
+ * @param n Number of elements in the array
+ * @param counts User-provided array of 33 elements, counts[p] receives the
+ * number of distinct /p networks.
+ * @return nothing
+ */
+void cipv4_count_distinct_all(const uint32_t * addrs, size_t n, size_t * counts){
+    if (!counts)
+        return;
+    for (int p=0; p<=32; ++p)
+        counts[p] = 0;
+    if (!addrs || n == 0)
+        return;
+    // two neighbours sharing exactly l leading bits differ at every prefix > l
+    size_t common[33] = {0};
+    for (size_t i=1; i<n; ++i){
+        uint32_t diff = addrs[i] ^ addrs[i - 1];
+        common[diff ? __builtin_clz(diff) : 32]++;
+    }
+    size_t running = 1;
+    for (int p=0; p<=32; ++p){
+        counts[p] = running;
+        if (p < 32)
+            running += common[p];
+    }
+}
+
+
+static void cipv4_sort_insertion(uint32_t * addrs, size_t n){
+    for (size_t i=1; i<n; ++i){
+        uint32_t v = addrs[i];
+        size_t j = i;
+        while (j > 0 && addrs[j - 1] > v){
+            addrs[j] = addrs[j - 1];
+            j--;
+        }
+        addrs[j] = v;
+    }
+}
+
+static void * cipv4_sort_worker(void * arg){
+    cipv4_sort_job * job = (cipv4_sort_job*) arg;
+    cipv4_sort_shared * shared = job->shared;
+    pthread_mutex_lock(&shared->lock);
+    while (!shared->go)
+        pthread_cond_wait(&shared->start, &shared->lock);
+    pthread_mutex_unlock(&shared->lock);
+    cipv4_sort_passes(shared, job->id);
+    return NULL;
+}
+
+// the four passes on the slice of one thread, returns the buffer holding
+// the sorted addresses (the same for all the threads)
+static uint32_t * cipv4_sort_passes(cipv4_sort_shared * shared, int id){
+    size_t begin = shared->n / shared->nthreads * id;
+    size_t end = id == shared->nthreads - 1 ? shared->n : begin + shared->n / shared->nthreads;
+    size_t * c = shared->counts[id];
+    uint32_t * src = shared->addrs;
+    uint32_t * dst = shared->tmp;
+    for (int pass=0; pass<4; ++pass){
+        int shift = pass * 8;
+        memset(c, 0, 256 * sizeof(size_t));
+        for (size_t i=begin; i<end; ++i)
+            c[(src[i] >> shift) & 0xFF]++;
+        if (pthread_barrier_wait(&shared->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+            cipv4_sort_offsets(shared);
+        pthread_barrier_wait(&shared->barrier);
+        if (shared->skip)
+            continue;       // same decision on every thread
+        for (size_t i=begin; i<end; ++i){
+            uint32_t v = src[i];
+            dst[c[(v >> shift) & 0xFF]++] = v;
+        }
+        // the next histogram reads what the other threads wrote
+        pthread_barrier_wait(&shared->barrier);
+        uint32_t * swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return src;
+}
+
+// turn the per-thread histograms into per-thread offsets
+static void cipv4_sort_offsets(cipv4_sort_shared * shared){
+    size_t offset = 0;
+    shared->skip = 0;
+    for (int d=0; d<256; ++d){
+        size_t total = 0;
+        for (int t=0; t<shared->nthreads; ++t){
+            size_t cnt = shared->counts[t][d];
+            shared->counts[t][d] = offset;
+            offset += cnt;
+            total += cnt;
+        }
+        if (total == shared->n)
+            shared->skip = 1;
+    }
+}
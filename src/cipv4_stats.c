@@ -0,0 +1,147 @@
+/// @file cipv4_stats.c
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <cipv4_stats.h>
+
+
+#ifdef CIPV4_STATS
+
+_Thread_local cipv4_stats_block * _cipv4_stats_tls = NULL;
+_Atomic uint32_t _cipv4_stats_sample_every = 0;
+
+static pthread_mutex_t _cipv4_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t _cipv4_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _cipv4_stats_key;
+static cipv4_stats_block * _cipv4_stats_blocks = NULL;     // blocks of the live threads
+static cipv4_stats_block _cipv4_stats_fallback = {.shared = 1};  // used if a block can not be allocated
+static cipv4_stats _cipv4_stats_retired;                   // counters of the exited threads
+static _Atomic int64_t _cipv4_stats_table_bytes[CIPV4_STATS_TABLE_LEVELS];
+
+static void cipv4_stats_add_block(cipv4_stats * stats, cipv4_stats_block * b){
+    stats->parse_ok += atomic_load_explicit(&b->parse_ok, memory_order_relaxed);
+    for (int i=0; i<4; ++i)
+        stats->parse_error[i] += atomic_load_explicit(&b->parse_error[i], memory_order_relaxed);
+    for (int i=0; i<CIPV4_STATS_CLASSIFIERS; ++i)
+        stats->classifier_calls[i] += atomic_load_explicit(&b->classifier_calls[i], memory_order_relaxed);
+    for (int i=0; i<CIPV4_STATS_TABLE_LEVELS; ++i)
+        stats->lookup_depth[i] += atomic_load_explicit(&b->lookup_depth[i], memory_order_relaxed);
+    for (int o=0; o<CIPV4_STATS_OPERATIONS; ++o)
+        for (int i=0; i<CIPV4_STATS_LATENCY_BUCKETS; ++i)
+            stats->latency[o][i] += atomic_load_explicit(&b->latency[o][i], memory_order_relaxed);
+}
+
+// thread exit: keep the counters and release the block
+static void cipv4_stats_retire(void * arg){
+    cipv4_stats_block * b = (cipv4_stats_block*) arg;
+    pthread_mutex_lock(&_cipv4_stats_lock);
+    cipv4_stats_block ** p = &_cipv4_stats_blocks;
+    while (*p && *p != b)
+        p = &(*p)->next;
+    if (*p)
+        *p = b->next;
+    cipv4_stats_add_block(&_cipv4_stats_retired, b);
+    pthread_mutex_unlock(&_cipv4_stats_lock);
+    free(b);
+}
+
+static void cipv4_stats_init_key(void){
+    pthread_key_create(&_cipv4_stats_key, cipv4_stats_retire);
+}
+
+cipv4_stats_block * _cipv4_stats_register(void){
+    pthread_once(&_cipv4_stats_once, cipv4_stats_init_key);
+    cipv4_stats_block * b = (cipv4_stats_block*) calloc(1, sizeof(cipv4_stats_block));
+    if (!b){
+        _cipv4_stats_tls = &_cipv4_stats_fallback;
+        return _cipv4_stats_tls;
+    }
+    pthread_mutex_lock(&_cipv4_stats_lock);
+    b->next = _cipv4_stats_blocks;
+    _cipv4_stats_blocks = b;
+    pthread_mutex_unlock(&_cipv4_stats_lock);
+    pthread_setspecific(_cipv4_stats_key, b);
+    _cipv4_stats_tls = b;
+    return b;
+}
+
+uint64_t _cipv4_stats_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void _cipv4_stats_latency(int operation, uint64_t start){
+    uint64_t elapsed = _cipv4_stats_now() - start;
+    int bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+    if (bucket >= CIPV4_STATS_LATENCY_BUCKETS)
+        bucket = CIPV4_STATS_LATENCY_BUCKETS - 1;
+    _CIPV4_STATS_ADD(_CIPV4_STATS_BLOCK(), latency[operation][bucket], 1);
+}
+
+// tables are built and freed rarely, so a shared atomic is fine here
+void _cipv4_stats_table(int level, int64_t bytes){
+    atomic_fetch_add_explicit(&_cipv4_stats_table_bytes[level], bytes, memory_order_relaxed);
+}
+
+#endif
+
+
+/**
+ * @brief Test if the library is compiled with the statistics (make STATS=1)
+ * @return 1 if the statistics are collected, 0 otherwise.
+ */
+int cipv4_stats_enabled(void){
+#ifdef CIPV4_STATS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Sum the statistics of all the threads
+ * @param stats User-provided structure to receive the counters
+ * @return 0 in case of success or -1 if the library is compiled without
+ * statistics (the structure is filled with zeros).
+ *
+ * Counters are updated by their threads without locking, a value which
+ * is not visible yet is reported by the next snapshot.
+ */
+int cipv4_stats_snapshot(cipv4_stats * stats){
+    if (!stats)
+        return -1;
+    memset(stats, 0, sizeof(cipv4_stats));
+#ifdef CIPV4_STATS
+    pthread_mutex_lock(&_cipv4_stats_lock);
+    *stats = _cipv4_stats_retired;
+    for (cipv4_stats_block * b = _cipv4_stats_blocks; b; b = b->next)
+        cipv4_stats_add_block(stats, b);
+    pthread_mutex_unlock(&_cipv4_stats_lock);
+    cipv4_stats_add_block(stats, &_cipv4_stats_fallback);
+    for (int i=0; i<CIPV4_STATS_TABLE_LEVELS; ++i)
+        stats->table_bytes[i] = (uint64_t)atomic_load_explicit(&_cipv4_stats_table_bytes[i], memory_order_relaxed);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Enable the latency histogram
+ * @param every Measure one call out of `every` calls (0 disables it)
+ * @return nothing
+ *
+ * Has no effect if the library is compiled without statistics.
+ */
+void cipv4_stats_set_sampling(uint32_t every){
+#ifdef CIPV4_STATS
+    atomic_store_explicit(&_cipv4_stats_sample_every, every, memory_order_relaxed);
+#else
+    (void) every;
+#endif
+}
@@ -0,0 +1,111 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cipv4.hpp>
+
+extern "C" {
+#include <cipv4_flow.h>
+}
+
+using namespace cipv4::literals;
+
+// everything below is checked by the compiler
+constexpr auto net = "10.20.30.40/24"_net;
+static_assert(net.prefix() == 24);
+static_assert(net.addr().value() == 169090600);
+static_assert(net.mask() == 0xFFFFFF00u);
+static_assert(net.first().value() == 169090560);
+static_assert(net.last() == "10.20.30.255"_ip);
+static_assert(net.size() == 256);
+static_assert(net.contains("10.20.30.0"_ip));
+static_assert(!net.contains("10.20.31.25"_ip));
+static_assert("10.0.0.0/8"_net.contains(net));
+static_assert(!net.contains("10.0.0.0/8"_net));
+static_assert("192.168.1.1"_ip.is_private());
+static_assert("127.0.0.1"_ip.is_loopback());
+static_assert("224.0.0.1"_ip.is_multicast());
+static_assert("169.254.3.4"_ip.is_linklocal());
+static_assert("241.0.0.5"_ip.is_reserved());
+static_assert("0.0.0.0"_ip.is_unspecified());
+static_assert("100.64.0.1"_ip.is_public_network());
+static_assert("8.8.8.8"_ip.is_global());
+static_assert(!cipv4::address::parse("123.36.58.0203"));
+static_assert(!cipv4::address::parse("1.2.333.1"));
+static_assert(!cipv4::address::parse("123.36..203"));
+static_assert(!cipv4::network::parse("10.0.0.0/0"));
+static_assert(!cipv4::network::parse("10.0.0.0/33"));
+static_assert(!cipv4::network::parse("10.0.0.0/08"));
+static_assert(cipv4::network::parse("10.0.0.1")->prefix() == 32);
+static_assert(cipv4::network("10.0.0.0"_ip, 0).mask() == 0);
+
+int main(){
+    // the same answers as the C library at run time
+    const char * samples[] = {"10.1.2.3", "172.31.255.255", "100.127.0.1", "8.8.4.4",
+                              "255.255.255.255", "169.254.0.1", "239.1.1.1", "0.0.0.0"};
+    char buffer[20];
+    for (const char * s : samples){
+        auto a = cipv4::address::parse(s);
+        assert(a && a->value() == cipv4_str_to_uint(s));
+        assert(a->is_private() == (cipv4_is_private_from_string(s) == 1));
+        assert(a->is_public_network() == (cipv4_is_public_network_from_string(s) == 1));
+        assert(a->is_global() == (cipv4_is_global_from_string(s) == 1));
+        assert(a->is_multicast() == (cipv4_is_multicast_from_string(s) == 1));
+        assert(a->is_linklocal() == (cipv4_is_linklocal_from_string(s) == 1));
+        assert(std::strcmp(a->to_string(buffer), s) == 0);
+    }
+    // the special networks of cipv4.hpp, cipv4_flow.c and cipv4.c are the same
+    cipv4_net nets[32];
+    assert(cipv4_flow_ranges(CIPV4_CLASS_PRIVATE, nets, 32) == CIPV4_PRAVATE_ARRAY_LENGTH);
+    for (int i=0; i<CIPV4_PRAVATE_ARRAY_LENGTH; ++i){
+        cipv4::network n = cipv4::detail::private_networks[i];
+        assert(nets[i].addr_start == n.addr().value() && nets[i].network_prefix == n.prefix());
+        // both ends of the network and the addresses around it, as in cipv4.c
+        uint32_t edges[] = {n.first().value() - 1, n.first().value(), n.last().value(), n.last().value() + 1};
+        for (uint32_t e : edges){
+            cipv4::address a(e);
+            a.to_string(buffer);
+            assert(a.is_private() == (cipv4_is_private_from_string(buffer) == 1));
+            assert(a.is_global() == (cipv4_is_global_from_string(buffer) == 1));
+            assert(a.is_private() == ((cipv4_flow_class(e) & CIPV4_CLASS_PRIVATE) != 0));
+        }
+    }
+    const struct { uint8_t cls; cipv4::network net; int (*c)(const char *); } single[] = {
+        {CIPV4_CLASS_PUBLIC_NETWORK, cipv4::detail::public_network, cipv4_is_public_network_from_string},
+        {CIPV4_CLASS_LOOPBACK, cipv4::detail::loopback, cipv4_is_loopback_from_string},
+        {CIPV4_CLASS_MULTICAST, cipv4::detail::multicast, cipv4_is_multicast_from_string},
+        {CIPV4_CLASS_LINKLOCAL, cipv4::detail::linklocal, cipv4_is_linklocal_from_string},
+        {CIPV4_CLASS_RESERVED, cipv4::detail::reserved, cipv4_is_reserved_from_string},
+    };
+    for (const auto & r : single){
+        assert(cipv4_flow_ranges(r.cls, nets, 32) == 1);
+        assert(nets[0].addr_start == r.net.addr().value() && nets[0].network_prefix == r.net.prefix());
+        uint32_t edges[] = {r.net.first().value() - 1, r.net.first().value(), r.net.last().value(), r.net.last().value() + 1};
+        for (uint32_t e : edges){
+            cipv4::address(e).to_string(buffer);
+            assert(r.net.contains(cipv4::address(e)) == (r.c(buffer) == 1));
+        }
+    }
+    assert(cipv4_flow_ranges(CIPV4_CLASS_UNSPECIFIED, nets, 32) == 1 && nets[0].addr_start == 0 && nets[0].network_prefix == 32);
+    cipv4_ctx * ctx = cipv4_parse_ip("10.20.30.40/24");
+    assert(cipv4::network::from_ctx(*ctx) == net);
+    assert(cipv4::network::from_ctx(*ctx).first().value() == ctx->addr_start);
+    cipv4_free(ctx);
+    bool thrown = false;
+    try{
+        cipv4::network n = cipv4::literals::operator""_net("10.0.0.0/40", 11);
+        (void) n;
+    }catch (const std::invalid_argument &){
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try{
+        cipv4::network n("10.0.0.0"_ip, 33);
+        (void) n;
+    }catch (const std::invalid_argument &){
+        thrown = true;
+    }
+    assert(thrown);
+    fprintf(stdout, "** All C++ tests done successfully!\n");
+    return 0;
+}
@@ -2,7 +2,26 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <cipv4.h>
+#include <cipv4_acl.h>
+#include <cipv4_sort.h>
+#include <cipv4_counter.h>
+#include <cipv4_hhh.h>
+#include <cipv4_stats.h>
+#include <cipv4_shm.h>
+#include <cipv4_anon.h>
+#include <cipv4_flow.h>
+#include <cipv4_pcap.h>
+#include <cipv4_gen.h>
+#include <cipv4_net.h>
+#include <cipv4_limit.h>
+#include <cipv4_ingest.h>
+#include <cipv4_hist.h>
+#include <pthread.h>
+#include <util_string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 int test_if_ip_valid(){
     assert(cipv4_is_ip_valid("123.36.58.203") == 1);
@@ -78,11 +97,1086 @@ int test_general(){
     return 0;
 }
 
+int test_acl(){
+    cipv4_acl_rule rules[5] = {
+        {cipv4_str_to_uint("10.1.2.0"), 24, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("10.1.0.0"), 16, CIPV4_ACL_DENY},
+        {cipv4_str_to_uint("10.1.2.128"), 25, CIPV4_ACL_DENY},   // shadowed by rule 0
+        {cipv4_str_to_uint("10.0.0.0"), 8, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("10.1.2.3"), 32, CIPV4_ACL_DENY},     // shadowed by rule 0
+    };
+    cipv4_acl * acl = cipv4_acl_compile(rules, 5, CIPV4_ACL_DENY);
+    assert(acl != NULL);
+    assert(cipv4_acl_match(acl, cipv4_str_to_uint("10.1.2.3")) == 0);
+    assert(cipv4_acl_lookup(acl, cipv4_str_to_uint("10.1.2.200")) == CIPV4_ACL_PERMIT);
+    assert(cipv4_acl_lookup(acl, cipv4_str_to_uint("10.1.3.1")) == CIPV4_ACL_DENY);
+    assert(cipv4_acl_lookup(acl, cipv4_str_to_uint("10.200.3.1")) == CIPV4_ACL_PERMIT);
+    assert(cipv4_acl_match(acl, cipv4_str_to_uint("11.0.0.0")) == -1);
+    assert(acl->nshadowed == 2 && acl->shadowed[0] == 2 && acl->shadowed[1] == 4);
+    assert(acl->nranges == 7);
+    assert(acl->ranges[0].addr_start == 0 && acl->ranges[acl->nranges - 1].addr_end == 0xFFFFFFFF);
+    cipv4_acl_free(acl);
+    // compare against the linear first-match walk
+    cipv4_acl_rule random_rules[200];
+    srand(1);
+    for (int i=0; i<200; ++i){
+        random_rules[i].addr = (uint32_t)rand() << 8 ^ (uint32_t)rand();
+        random_rules[i].network_prefix = 8 + rand() % 25;
+        random_rules[i].addr &= 0xFF00FFFF | (rand() % 4) << 16;
+        random_rules[i].action = i;
+    }
+    acl = cipv4_acl_compile(random_rules, 200, -1);
+    assert(acl != NULL);
+    for (int i=0; i<100000; ++i){
+        uint32_t addr = random_rules[rand() % 200].addr ^ (rand() % 1024);
+        int expected = -1;
+        for (int j=0; j<200 && expected < 0; ++j){
+            uint32_t mask = 0xFFFFFFFFu << (32 - random_rules[j].network_prefix);
+            if ((addr & mask) == (random_rules[j].addr & mask))
+                expected = j;
+        }
+        assert(cipv4_acl_lookup(acl, addr) == expected);
+    }
+    cipv4_acl_free(acl);
+    // longest-prefix match against the same linear walk
+    acl = cipv4_acl_compile_lpm(random_rules, 200, -1);
+    assert(acl != NULL);
+    for (int i=0; i<100000; ++i){
+        uint32_t addr = random_rules[rand() % 200].addr ^ (rand() % 1024);
+        int expected = -1;
+        for (int j=0; j<200; ++j){
+            uint32_t mask = 0xFFFFFFFFu << (32 - random_rules[j].network_prefix);
+            if ((addr & mask) == (random_rules[j].addr & mask) &&
+                    (expected < 0 || random_rules[j].network_prefix > random_rules[expected].network_prefix))
+                expected = j;
+        }
+        assert(cipv4_acl_match(acl, addr) == expected);
+        assert(cipv4_acl_lookup(acl, addr) == expected);
+    }
+    cipv4_acl_free(acl);
+    acl = cipv4_acl_compile_lpm(rules, 5, CIPV4_ACL_DENY);
+    assert(cipv4_acl_match(acl, cipv4_str_to_uint("10.1.2.3")) == 4);
+    assert(cipv4_acl_match(acl, cipv4_str_to_uint("10.1.2.200")) == 2);
+    assert(cipv4_acl_match(acl, cipv4_str_to_uint("10.1.3.1")) == 1);
+    assert(acl->nshadowed == 0);
+    cipv4_acl_free(acl);
+    acl = cipv4_acl_compile(rules, 0, CIPV4_ACL_PERMIT);
+    assert(acl != NULL && acl->nranges == 1);
+    assert(cipv4_acl_lookup(acl, 12345) == CIPV4_ACL_PERMIT);
+    cipv4_acl_free(acl);
+    rules[0].network_prefix = 33;
+    assert(cipv4_acl_compile(rules, 1, CIPV4_ACL_PERMIT) == NULL);
+    return 0;
+}
+
+static int cmp_uint(const void * a, const void * b){
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+int test_sort(){
+    size_t n = 300000;
+    uint32_t * a = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t * b = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t * c = (uint32_t*) malloc(n * sizeof(uint32_t));
+    srand(2);
+    for (size_t i=0; i<n; ++i)
+        a[i] = b[i] = c[i] = ((uint32_t)rand() << 16 ^ (uint32_t)rand()) & 0xC0FFFF0F;
+    qsort(a, n, sizeof(uint32_t), cmp_uint);
+    assert(cipv4_sort(b, n) == 0);
+    assert(cipv4_sort_parallel(c, n, 4) == 0);
+    assert(memcmp(a, b, n * sizeof(uint32_t)) == 0);
+    assert(memcmp(a, c, n * sizeof(uint32_t)) == 0);
+    size_t counts[33];
+    cipv4_count_distinct_all(a, n, counts);
+    assert(counts[0] == 1);
+    assert(counts[2] == 4);
+    for (int p=0; p<=32; ++p)
+        assert(counts[p] == cipv4_count_distinct(a, n, p));
+    size_t unique = cipv4_dedup(b, n);
+    assert(unique == counts[32]);
+    for (size_t i=1; i<unique; ++i)
+        assert(b[i - 1] < b[i]);
+    uint32_t small[5] = {5, 1, 5, 0xFFFFFFFF, 1};
+    assert(cipv4_sort(small, 5) == 0);
+    assert(small[0] == 1 && small[2] == 5 && small[4] == 0xFFFFFFFF);
+    assert(cipv4_dedup(small, 5) == 3);
+    assert(cipv4_count_distinct(small, 0, 24) == 0);
+    free(a);
+    free(b);
+    free(c);
+    return 0;
+}
+
+int test_counter(){
+    cipv4_counter * counter = cipv4_counter_new(10, 3);
+    assert(counter != NULL);
+    assert(cipv4_counter_get_shard(counter, 3) == NULL);
+    cipv4_counter_shard * s0 = cipv4_counter_get_shard(counter, 0);
+    cipv4_counter_shard * s2 = cipv4_counter_get_shard(counter, 2);
+    assert(((uintptr_t)s0->counts % CIPV4_CACHE_LINE) == 0);
+    int keys[8] = {1, 1, 7, -1, 3, 1, 10, 7};
+    cipv4_counter_add_batch(s0, keys, 8);
+    cipv4_counter_add(s2, 3, 5);
+    cipv4_counter_totals * totals = cipv4_counter_snapshot(counter);
+    assert(totals->total[1] == 3 && totals->total[3] == 6 && totals->total[7] == 2);
+    assert(totals->window[3] == 6);
+    uint32_t top[5];
+    assert(cipv4_counter_top(totals, 2, 0, top) == 2);
+    assert(top[0] == 3 && top[1] == 1);
+    assert(cipv4_counter_top(totals, 5, 0, top) == 3);
+    assert(top[0] == 3 && top[1] == 1 && top[2] == 7);
+    cipv4_counter_totals_free(totals);
+    cipv4_counter_add(s2, 7, 4);
+    totals = cipv4_counter_snapshot(counter);
+    assert(totals->total[7] == 6 && totals->window[7] == 4 && totals->window[3] == 0);
+    assert(cipv4_counter_top(totals, 5, 1, top) == 1 && top[0] == 7);
+    cipv4_counter_totals_free(totals);
+    cipv4_counter_free(counter);
+    return 0;
+}
+
+static int hhh_find(cipv4_hhh_item * items, uint32_t n, const char * ip, uint8_t prefix){
+    for (uint32_t i=0; i<n; ++i)
+        if (items[i].addr == cipv4_str_to_uint(ip) && items[i].network_prefix == prefix)
+            return 1;
+    return 0;
+}
+
+int test_hhh(){
+    size_t n = 200000;
+    uint32_t * addrs = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t host = cipv4_str_to_uint("10.1.2.3");
+    uint32_t net = cipv4_str_to_uint("192.168.0.0");
+    uint64_t host_count = 0;
+    srand(4);
+    for (size_t i=0; i<n; ++i){
+        int r = rand() % 10;
+        uint32_t random = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+        addrs[i] = r < 3 ? host : r < 5 ? net | (random & 0xFFFF) : random;
+        host_count += addrs[i] == host;
+    }
+    for (int sampled=0; sampled<2; ++sampled){
+        cipv4_hhh * hhh = cipv4_hhh_new(8, 1, 512, sampled);
+        assert(hhh != NULL && hhh->nlevels == 25);
+        cipv4_hhh_update_batch(hhh, addrs, n);
+        cipv4_hhh_item items[64];
+        uint32_t found = cipv4_hhh_query(hhh, 0.15, items, 64);
+        assert(hhh_find(items, found, "10.1.2.3", 32));
+        assert(hhh_find(items, found, "192.168.0.0", 16));
+        assert(!hhh_find(items, found, "10.0.0.0", 8));     // only 10.1.2.3 inside
+        assert(items[0].network_prefix == 32);
+        for (uint32_t i=0; i<found; ++i){
+            if (items[i].addr != host || items[i].network_prefix != 32)
+                continue;
+            assert(items[i].count <= host_count + items[i].error);
+            assert(host_count <= items[i].count + items[i].error);
+            if (!sampled)
+                assert(items[i].count <= host_count);
+        }
+        cipv4_hhh_free(hhh);
+    }
+    assert(cipv4_hhh_new(33, 1, 10, 0) == NULL);
+    free(addrs);
+    return 0;
+}
+
+int test_arena(){
+    cipv4_arena * arena = cipv4_arena_new(256);     // force many blocks
+    assert(arena != NULL);
+    cipv4_ctx * first = NULL;
+    char buffer[20];
+    for (int round=0; round<2; ++round){
+        for (int i=0; i<100; ++i){
+            sprintf(buffer, "10.0.%d.1/24", i);
+            cipv4_ctx * ctx = cipv4_parse_ip_arena(arena, buffer);
+            assert(ctx != NULL && ctx->error == 0 && ctx->arena == arena);
+            assert(strcmp(ctx->raw, buffer) == 0);
+            assert(ctx->addr_start == (cipv4_str_to_uint("10.0.0.0") | i << 8));
+            if (i == 0 && round == 0)
+                first = ctx;
+            else if (i == 0)
+                assert(ctx == first);   // memory reused after reset
+            cipv4_free(ctx);            // no-op for arena contexts
+        }
+        cipv4_ctx * ctx = cipv4_parse_ip_arena(arena, "10.0.0.1/33");
+        assert(ctx != NULL && ctx->error == 2);
+        cipv4_arena_reset(arena);
+    }
+    cipv4_arena_free(arena);
+    cipv4_ctx * ctx = cipv4_parse_ip_arena(NULL, "1.2.3.4/8");
+    assert(ctx != NULL && ctx->arena == NULL && ctx->addr_start == cipv4_str_to_uint("1.0.0.0"));
+    cipv4_free(ctx);
+    return 0;
+}
+
+int test_stats(){
+    cipv4_stats before, after;
+    if (!cipv4_stats_enabled()){
+        assert(cipv4_stats_snapshot(&after) == -1);
+        assert(after.parse_ok == 0);
+        return 0;
+    }
+    cipv4_stats_set_sampling(1);
+    assert(cipv4_stats_snapshot(&before) == 0);
+    cipv4_free(cipv4_parse_ip("10.0.0.1/8"));
+    cipv4_free(cipv4_parse_ip("10.0.0.300"));
+    cipv4_free(cipv4_parse_ip("10.0.0.1/40"));
+    assert(cipv4_parse_ip("10.0.0.1/8 is much too long") == NULL);
+    cipv4_is_loopback_from_string("127.0.0.1");
+    cipv4_is_global_from_string("8.8.8.8");
+    cipv4_acl_rule rule = {cipv4_str_to_uint("10.1.2.3"), 32, CIPV4_ACL_PERMIT};
+    cipv4_acl * acl = cipv4_acl_compile(&rule, 1, CIPV4_ACL_DENY);
+    cipv4_acl_lookup(acl, cipv4_str_to_uint("10.1.2.3"));
+    cipv4_acl_lookup(acl, cipv4_str_to_uint("10.1.3.3"));
+    cipv4_acl_lookup(acl, cipv4_str_to_uint("11.1.2.3"));
+    assert(cipv4_stats_snapshot(&after) == 0);
+    assert(after.parse_ok - before.parse_ok == 1);
+    assert(after.parse_error[0] - before.parse_error[0] == 1);
+    assert(after.parse_error[1] - before.parse_error[1] == 1);
+    assert(after.parse_error[2] - before.parse_error[2] == 1);
+    assert(after.classifier_calls[CIPV4_STATS_IS_LOOPBACK_FROM_STRING] -
+           before.classifier_calls[CIPV4_STATS_IS_LOOPBACK_FROM_STRING] == 1);
+    // one call of cipv4_is_global*() is one classifier call
+    uint64_t calls = 0;
+    for (int i=0; i<CIPV4_STATS_CLASSIFIERS; ++i)
+        calls += after.classifier_calls[i] - before.classifier_calls[i];
+    assert(calls == 2);
+    for (int i=0; i<3; ++i)
+        assert(after.lookup_depth[i] - before.lookup_depth[i] == 1);
+    assert(after.table_bytes[0] - before.table_bytes[0] == 65536 * sizeof(uint32_t));
+    assert(after.table_bytes[2] - before.table_bytes[2] == 256 * sizeof(uint32_t));
+    uint64_t sampled = 0;
+    for (int i=0; i<CIPV4_STATS_LATENCY_BUCKETS; ++i)
+        sampled += after.latency[CIPV4_STATS_ACL_MATCH][i] - before.latency[CIPV4_STATS_ACL_MATCH][i];
+    assert(sampled == 3);
+    cipv4_acl_free(acl);
+    cipv4_stats_snapshot(&after);
+    assert(after.table_bytes[0] == before.table_bytes[0]);
+    cipv4_stats_set_sampling(0);
+    return 0;
+}
+
+int test_shm(){
+    char name[64];
+    sprintf(name, "/cipv4_test_%d", (int)getpid());
+    cipv4_shm_unlink(name);
+    assert(cipv4_shm_open(name) == NULL);
+    assert(cipv4_shm_publish("no_slash", NULL) == -1);
+    cipv4_acl_rule rules[2] = {
+        {cipv4_str_to_uint("10.1.2.0"), 24, CIPV4_ACL_DENY},
+        {cipv4_str_to_uint("10.0.0.0"), 8, CIPV4_ACL_PERMIT},
+    };
+    cipv4_acl * acl = cipv4_acl_compile(rules, 2, CIPV4_ACL_DENY);
+    assert(cipv4_shm_publish(name, acl) == 1);
+    cipv4_acl_free(acl);
+    cipv4_shm_reader * reader = cipv4_shm_open(name);
+    assert(reader != NULL && reader->generation == 1);
+    assert(cipv4_shm_refresh(reader) == 0);
+    assert(cipv4_acl_match(&reader->acl, cipv4_str_to_uint("10.1.2.3")) == 0);
+    assert(cipv4_acl_lookup(&reader->acl, cipv4_str_to_uint("10.9.2.3")) == CIPV4_ACL_PERMIT);
+    assert(cipv4_acl_lookup(&reader->acl, cipv4_str_to_uint("11.1.2.3")) == CIPV4_ACL_DENY);
+    assert(reader->acl.nranges == 5 && reader->acl.nshadowed == 0);
+    // another process maps the same table
+    pid_t pid = fork();
+    if (pid == 0){
+        cipv4_shm_reader * child = cipv4_shm_open(name);
+        int ok = child && child->generation == 1 && cipv4_acl_match(&child->acl, cipv4_str_to_uint("10.1.2.3")) == 0;
+        cipv4_shm_close(child);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 1;
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    rules[0].action = CIPV4_ACL_PERMIT;
+    acl = cipv4_acl_compile(rules, 1, CIPV4_ACL_DENY);
+    assert(cipv4_shm_publish(name, acl) == 2);
+    cipv4_acl_free(acl);
+    // the old version stays usable until the refresh
+    assert(cipv4_acl_match(&reader->acl, cipv4_str_to_uint("10.9.2.3")) == 1);
+    assert(cipv4_shm_refresh(reader) == 1);
+    assert(reader->generation == 2);
+    assert(cipv4_acl_lookup(&reader->acl, cipv4_str_to_uint("10.1.2.3")) == CIPV4_ACL_PERMIT);
+    assert(cipv4_acl_match(&reader->acl, cipv4_str_to_uint("10.9.2.3")) == -1);
+    assert(cipv4_shm_unlink(name) == 0);
+    assert(cipv4_shm_refresh(reader) == 0);
+    cipv4_shm_close(reader);
+    assert(cipv4_shm_open(name) == NULL);
+    return 0;
+}
+
+int test_anon(){
+    // FIPS-197 appendix C.1
+    uint8_t key[CIPV4_ANON_KEY_LENGTH] = {0};
+    uint8_t block[16];
+    for (int i=0; i<16; ++i){
+        key[i] = (uint8_t)i;
+        block[i] = (uint8_t)(i * 0x11);
+    }
+    cipv4_anon * anon = cipv4_anon_new(key);
+    assert(anon != NULL);
+    cipv4_anon_encrypt_block(anon, block, block);
+    assert(block[0] == 0x69 && block[1] == 0xc4 && block[14] == 0xc5 && block[15] == 0x5a);
+    cipv4_anon_free(anon);
+    assert(cipv4_anon_new(NULL) == NULL);
+    // sample key and results of the reference Crypto-PAn implementation
+    uint8_t sample[CIPV4_ANON_KEY_LENGTH] = {21, 34, 23, 141, 51, 164, 207, 128, 19, 10, 91, 22, 73, 144, 125, 16,
+                                             216, 152, 143, 131, 121, 121, 101, 39, 98, 87, 76, 45, 42, 132, 34, 2};
+    anon = cipv4_anon_new(sample);
+    assert(cipv4_anon_addr(anon, cipv4_str_to_uint("128.11.68.132")) == cipv4_str_to_uint("135.242.180.132"));
+    assert(cipv4_anon_addr(anon, cipv4_str_to_uint("141.223.7.43")) == cipv4_str_to_uint("141.167.8.160"));
+    assert(cipv4_anon_addr(anon, cipv4_str_to_uint("192.102.249.13")) == cipv4_str_to_uint("252.138.62.131"));
+    uint32_t addrs[1000], out[1000];
+    for (int i=0; i<1000; ++i)
+        addrs[i] = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+    cipv4_anon_batch(anon, addrs, out, 1000);
+    for (int i=0; i<1000; ++i){
+        assert(out[i] == cipv4_anon_addr(anon, addrs[i]));
+        // the length of the common prefix is preserved
+        uint32_t x = addrs[i] ^ addrs[(i + 1) % 1000];
+        uint32_t y = out[i] ^ out[(i + 1) % 1000];
+        assert((x ? __builtin_clz(x) : 32) == (y ? __builtin_clz(y) : 32));
+    }
+    // the portable fallback gives the same results
+    anon->aesni = 0;
+    cipv4_anon_batch(anon, addrs, addrs, 1000);
+    assert(memcmp(addrs, out, sizeof(out)) == 0);
+    cipv4_anon_free(anon);
+    return 0;
+}
+
+int test_flow(){
+    static const char * edges[] = {"0.0.0.0", "0.0.0.1", "1.0.0.0", "9.255.255.255", "10.0.0.0", "100.63.255.255",
+                                   "100.64.0.0", "100.127.255.255", "127.0.0.1", "169.254.1.1", "169.255.0.0",
+                                   "172.31.255.255", "172.32.0.0", "192.0.0.7", "192.0.0.8", "192.0.0.170",
+                                   "192.0.0.171", "192.0.0.172", "192.0.2.9", "192.168.1.1", "198.19.0.1",
+                                   "198.51.100.7", "203.0.113.255", "223.255.255.255", "224.0.0.1",
+                                   "239.1.1.1", "240.0.0.1", "255.255.255.255", "8.8.8.8"};
+    const int nedges = sizeof(edges) / sizeof(edges[0]);
+    // packed records with unaligned fields
+    const size_t stride = 7;
+    const size_t n = 1000;
+    unsigned char * records = (unsigned char*) malloc(n * stride);
+    uint32_t expected[1000], addrs[1000];
+    uint8_t classes[1000];
+    int rules[1000];
+    for (size_t i=0; i<n; ++i){
+        expected[i] = i < (size_t)nedges ? cipv4_str_to_uint(edges[i]) : (uint32_t)rand() << 16 ^ (uint32_t)rand();
+        unsigned char * field = records + i * stride + 3;
+        field[0] = (unsigned char)(expected[i] >> 24);
+        field[1] = (unsigned char)(expected[i] >> 16);
+        field[2] = (unsigned char)(expected[i] >> 8);
+        field[3] = (unsigned char)expected[i];
+    }
+    cipv4_acl_rule rules_in[2] = {
+        {cipv4_str_to_uint("192.0.0.0"), 24, CIPV4_ACL_DENY},
+        {cipv4_str_to_uint("128.0.0.0"), 1, CIPV4_ACL_PERMIT},
+    };
+    cipv4_acl * acl = cipv4_acl_compile(rules_in, 2, CIPV4_ACL_DENY);
+    assert(cipv4_flow_classify(NULL, stride, 1, acl, addrs, classes, rules) == -1);
+    assert(cipv4_flow_classify(records + 3, 2, n, acl, addrs, classes, rules) == -1);
+    assert(cipv4_flow_classify(records + 3, stride, n, acl, addrs, classes, rules) == 0);
+    char buffer[20];
+    for (size_t i=0; i<n; ++i){
+        assert(addrs[i] == expected[i]);
+        assert(rules[i] == cipv4_acl_match(acl, expected[i]));
+        assert(classes[i] == cipv4_flow_class(expected[i]));
+        if (i >= 200)
+            continue;
+        // same answers as the string classifiers
+        cipv4_ctx * ctx = cipv4_parse_ip(cipv4_uint_to_str(expected[i], buffer));
+        assert(!!(classes[i] & CIPV4_CLASS_PRIVATE) == cipv4_is_private(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_PUBLIC_NETWORK) == cipv4_is_public_network(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_GLOBAL) == cipv4_is_global(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_LOOPBACK) == cipv4_is_loopback(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_MULTICAST) == cipv4_is_multicast(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_UNSPECIFIED) == cipv4_is_unspecified(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_LINKLOCAL) == cipv4_is_linklocal(ctx));
+        assert(!!(classes[i] & CIPV4_CLASS_RESERVED) == cipv4_is_reserved(ctx));
+        cipv4_free(ctx);
+    }
+    // outputs are optional
+    memset(classes, 0, sizeof(classes));
+    assert(cipv4_flow_classify(records + 3, stride, 13, NULL, NULL, classes, NULL) == 0);
+    assert(classes[0] == (CIPV4_CLASS_PRIVATE | CIPV4_CLASS_UNSPECIFIED) && classes[13] == 0);
+    cipv4_acl_free(acl);
+    free(records);
+    return 0;
+}
+
+static void write_u32(FILE * f, uint32_t v, int swapped){
+    if (swapped)
+        v = __builtin_bswap32(v);
+    fwrite(&v, sizeof(v), 1, f);
+}
+
+// pcap fixture with IPv4 (some with a VLAN tag), ARP and IPv6 packets and
+// a truncated last record. Expected totals are computed while writing.
+static void write_pcap_fixture(const char * path, uint32_t linktype, int swapped, int npackets,
+                               const cipv4_acl * acl, cipv4_pcap_totals * expected){
+    static const char * pool[] = {"10.1.2.3", "10.1.9.9", "10.9.9.9", "8.8.8.8", "1.1.1.1", "127.0.0.1",
+                                  "224.0.0.5", "0.0.0.0", "100.64.1.1", "169.254.3.3", "192.168.7.7"};
+    FILE * f = fopen(path, "wb");
+    write_u32(f, 0xA1B2C3D4, swapped);
+    write_u32(f, 0x00040002, swapped);      // version 2.4 (two 16-bit fields, not checked)
+    write_u32(f, 0, swapped);
+    write_u32(f, 0, swapped);
+    write_u32(f, 96, swapped);
+    write_u32(f, linktype, swapped);
+    unsigned char packet[96];
+    for (int i=0; i<npackets + 1; ++i){
+        memset(packet, 0, sizeof(packet));
+        uint32_t origlen = 60 + rand() % 1400;
+        uint32_t caplen = 96;
+        int kind = linktype == CIPV4_PCAP_LINKTYPE_ETHERNET ? rand() % 5 : 0;
+        uint32_t src = cipv4_str_to_uint(pool[rand() % 11]);
+        uint32_t dst = cipv4_str_to_uint(pool[rand() % 11]);
+        unsigned char * ip = packet;
+        if (linktype == CIPV4_PCAP_LINKTYPE_ETHERNET){
+            uint32_t type = kind == 3 ? 0x0806 : kind == 4 ? 0x86DD : 0x0800;
+            ip = packet + 14;
+            if (kind == 1){
+                packet[12] = 0x81;
+                ip += 4;
+            }
+            ip[-2] = (unsigned char)(type >> 8);
+            ip[-1] = (unsigned char)type;
+        }
+        ip[0] = 0x45;
+        for (int b=0; b<4; ++b){
+            ip[12 + b] = (unsigned char)(src >> (24 - 8 * b));
+            ip[16 + b] = (unsigned char)(dst >> (24 - 8 * b));
+        }
+        write_u32(f, 1600000000 + i, swapped);
+        write_u32(f, (uint32_t)i * 1000 % 1000000, swapped);
+        write_u32(f, caplen, swapped);
+        write_u32(f, origlen, swapped);
+        if (i == npackets){
+            fwrite(packet, 1, caplen / 2, f);
+            break;
+        }
+        fwrite(packet, 1, caplen, f);
+        expected->packets++;
+        expected->bytes += origlen;
+        if (kind >= 3)
+            continue;
+        expected->ipv4_packets++;
+        expected->ipv4_bytes += origlen;
+        uint32_t addrs[2] = {src, dst};
+        for (int d=0; d<2; ++d){
+            int rule = cipv4_acl_match(acl, addrs[d]);
+            uint32_t r = rule < 0 ? expected->nrules : (uint32_t)rule;
+            expected->rule_packets[d][r]++;
+            expected->rule_bytes[d][r] += origlen;
+            for (int c=0; c<CIPV4_PCAP_CLASSES; ++c){
+                if (cipv4_flow_class(addrs[d]) & (1 << c)){
+                    expected->class_packets[d][c]++;
+                    expected->class_bytes[d][c] += origlen;
+                }
+            }
+        }
+    }
+    fclose(f);
+}
+
+static int same_totals(const cipv4_pcap_totals * a, const cipv4_pcap_totals * b){
+    if (a->packets != b->packets || a->bytes != b->bytes || a->ipv4_packets != b->ipv4_packets ||
+            a->ipv4_bytes != b->ipv4_bytes || a->nrules != b->nrules)
+        return 0;
+    for (int d=0; d<2; ++d){
+        if (memcmp(a->rule_packets[d], b->rule_packets[d], (a->nrules + 1) * sizeof(uint64_t)) ||
+                memcmp(a->rule_bytes[d], b->rule_bytes[d], (a->nrules + 1) * sizeof(uint64_t)) ||
+                memcmp(a->class_packets[d], b->class_packets[d], sizeof(a->class_packets[d])) ||
+                memcmp(a->class_bytes[d], b->class_bytes[d], sizeof(a->class_bytes[d])))
+            return 0;
+    }
+    return 1;
+}
+
+int test_pcap(){
+    cipv4_acl_rule rules[5] = {
+        {cipv4_str_to_uint("10.0.0.0"), 8, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("10.1.2.0"), 24, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("10.1.0.0"), 16, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("192.168.0.0"), 16, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("8.8.8.0"), 24, CIPV4_ACL_PERMIT},
+    };
+    cipv4_acl * acl = cipv4_acl_compile_lpm(rules, 5, CIPV4_ACL_DENY);
+    char path[64];
+    sprintf(path, "/tmp/cipv4_test_%d.pcap", (int)getpid());
+    uint32_t linktypes[2] = {CIPV4_PCAP_LINKTYPE_ETHERNET, CIPV4_PCAP_LINKTYPE_RAW};
+    for (int k=0; k<2; ++k){
+        cipv4_pcap_totals expected;
+        uint64_t rule_counts[4][6];
+        memset(&expected, 0, sizeof(expected));
+        memset(rule_counts, 0, sizeof(rule_counts));
+        expected.nrules = 5;
+        expected.rule_packets[0] = rule_counts[0];
+        expected.rule_packets[1] = rule_counts[1];
+        expected.rule_bytes[0] = rule_counts[2];
+        expected.rule_bytes[1] = rule_counts[3];
+        write_pcap_fixture(path, linktypes[k], k, 3000, acl, &expected);
+        cipv4_pcap * pcap = cipv4_pcap_open(path);
+        assert(pcap != NULL && pcap->swapped == k && pcap->linktype == linktypes[k] && pcap->snaplen == 96);
+        for (int nthreads=1; nthreads<=4; nthreads+=3){
+            cipv4_pcap_totals * totals = cipv4_pcap_analyze(pcap, acl, nthreads);
+            assert(totals != NULL);
+            assert(totals->packets == 3000);
+            assert(same_totals(totals, &expected));
+            cipv4_pcap_totals_free(totals);
+        }
+        cipv4_pcap_totals * totals = cipv4_pcap_analyze(pcap, NULL, 2);
+        assert(totals->nrules == 0 && totals->rule_packets[CIPV4_PCAP_SRC][0] == expected.ipv4_packets);
+        cipv4_pcap_totals_free(totals);
+        cipv4_pcap_close(pcap);
+    }
+    unlink(path);
+    assert(cipv4_pcap_open("test/example.db") == NULL);
+    assert(cipv4_pcap_open("/nonexistent.pcap") == NULL);
+    cipv4_acl_free(acl);
+    return 0;
+}
+
+int test_gen(){
+    char buffer[CIPV4_GEN_MAX_LINE];
+    for (int kind=0; kind<CIPV4_GEN_BAD_KINDS; ++kind){
+        for (uint64_t r=0; r<2000; ++r){
+            uint64_t random = r * 0x9E3779B97F4A7C15ULL;
+            assert(cipv4_gen_malformed(kind, random, buffer) == buffer);
+            size_t len = strlen(buffer);
+            assert(len < CIPV4_GEN_MAX_LINE);
+            assert(cipv4_is_ip_valid(buffer) == 0);
+            if (kind == CIPV4_GEN_BAD_SHORT)
+                assert(len < 7);
+            if (kind == CIPV4_GEN_BAD_LONG)
+                assert(len > 15);
+            if (kind != CIPV4_GEN_BAD_SHORT && kind != CIPV4_GEN_BAD_LONG)
+                assert(len >= 7 && len <= 15);
+            if (kind != CIPV4_GEN_BAD_DOTS)
+                assert(cstr_count(buffer, DOT) == 3);
+        }
+    }
+    assert(cipv4_gen_malformed(CIPV4_GEN_BAD_KINDS, 0, buffer) == NULL);
+
+    cipv4_gen_config config;
+    cipv4_gen_config_init(&config);
+    cipv4_net nets[3] = {
+        {cipv4_str_to_uint("10.0.0.0"), 8},
+        {cipv4_str_to_uint("8.8.8.0"), 24},
+        {cipv4_str_to_uint("1.2.3.0"), 24},
+    };
+    // exclusion drops 10/8 entirely and nothing is left of 10/8 alone
+    config.exclude = CIPV4_CLASS_PRIVATE;
+    assert(cipv4_gen_new(nets, 1, &config) == NULL);
+    cipv4_gen * gen = cipv4_gen_new(nets, 3, &config);
+    assert(gen != NULL && gen->npieces == 2);
+    cipv4_gen_free(gen);
+    config.exclude = 0;
+    config.malformed_rate = 1.5;
+    assert(cipv4_gen_new(nets, 3, &config) == NULL);
+    config.malformed_rate = 0;
+    assert(cipv4_gen_new(nets, 0, &config) == NULL);
+
+    // same stream for any number of threads and any starting record
+    size_t n = 40000;
+    uint32_t * a = (uint32_t*) malloc(n * sizeof(uint32_t));
+    uint32_t * b = (uint32_t*) malloc(n * sizeof(uint32_t));
+    config.distribution = CIPV4_GEN_ZIPF;
+    config.zipf_s = 1.0;
+    config.seed = 42;
+    gen = cipv4_gen_new(nets, 3, &config);
+    assert(cipv4_gen_addrs(gen, 0, a, n) == 0);
+    cipv4_gen_free(gen);
+    config.nthreads = 4;
+    gen = cipv4_gen_new(nets, 3, &config);
+    assert(cipv4_gen_addrs(gen, 0, b, n) == 0);
+    assert(memcmp(a, b, n * sizeof(uint32_t)) == 0);
+    assert(cipv4_gen_addrs(gen, 1000, b, 5000) == 0);
+    assert(memcmp(a + 1000, b, 5000 * sizeof(uint32_t)) == 0);
+    // Zipf with s=1: 10/8 twice as often as 8.8.8/24, three times as 1.2.3/24
+    size_t hits[3] = {0};
+    for (size_t i=0; i<n; ++i)
+        for (int k=0; k<3; ++k)
+            if ((a[i] & (k ? 0xFFFFFF00 : 0xFF000000)) == nets[k].addr_start)
+                hits[k]++;
+    assert(hits[0] + hits[1] + hits[2] == n);
+    assert(hits[0] > 1.9 * hits[1] && hits[0] < 2.1 * hits[1]);
+    assert(hits[0] > 2.8 * hits[2] && hits[0] < 3.2 * hits[2]);
+    cipv4_gen_free(gen);
+
+    // text: valid lines are the same addresses, malformed ones are rejected
+    config.malformed_rate = 0.1;
+    gen = cipv4_gen_new(nets, 3, &config);
+    char * text = (char*) malloc(n * CIPV4_GEN_MAX_LINE + 1);
+    long int length = cipv4_gen_text(gen, 0, n, text);
+    assert(length > 0 && text[length - 1] == '\n');
+    text[length] = '\0';
+    size_t malformed = 0;
+    char * line = text;
+    for (size_t i=0; i<n; ++i){
+        char * end = strchr(line, '\n');
+        assert(end != NULL);
+        *end = '\0';
+        if (cipv4_is_ip_valid(line))
+            assert(cipv4_str_to_uint(line) == a[i]);
+        else
+            malformed++;
+        line = end + 1;
+    }
+    assert(*line == '\0');
+    assert(malformed > 0.09 * n && malformed < 0.11 * n);
+    cipv4_gen_free(gen);
+
+    // uniform over nested and duplicate networks: every address counts once
+    cipv4_net nested[5] = {
+        {cipv4_str_to_uint("10.0.0.0"), 24},
+        {cipv4_str_to_uint("10.0.0.0"), 25},
+        {cipv4_str_to_uint("10.0.0.0"), 26},
+        {cipv4_str_to_uint("10.0.0.0"), 24},
+        {cipv4_str_to_uint("10.0.1.0"), 24},
+    };
+    cipv4_gen_config_init(&config);
+    gen = cipv4_gen_new(nested, 5, &config);
+    assert(gen != NULL && gen->npieces == 2);
+    assert(cipv4_gen_addrs(gen, 0, a, n) == 0);
+    size_t eighth = 0, second = 0;
+    for (size_t i=0; i<n; ++i){
+        assert((a[i] & 0xFFFFFE00) == cipv4_str_to_uint("10.0.0.0"));
+        eighth += (a[i] & 0xFFFFFFC0) == cipv4_str_to_uint("10.0.0.0");
+        second += (a[i] & 0xFFFFFF00) == cipv4_str_to_uint("10.0.1.0");
+    }
+    // 10.0.0.0/26 is 1/8 of the 512 addresses, 10.0.1.0/24 is half
+    assert(eighth > 0.115 * n && eighth < 0.135 * n);
+    assert(second > 0.48 * n && second < 0.52 * n);
+    cipv4_gen_free(gen);
+
+    // uniform over everything except the special ranges
+    cipv4_net all = {0, 0};
+    cipv4_gen_config_init(&config);
+    config.exclude = CIPV4_CLASS_PRIVATE;
+    gen = cipv4_gen_new(&all, 1, &config);
+    assert(gen != NULL);
+    assert(cipv4_gen_addrs(gen, 0, a, n) == 0);
+    for (size_t i=0; i<n; ++i)
+        assert(!(cipv4_flow_class(a[i]) & CIPV4_CLASS_PRIVATE));
+    cipv4_gen_free(gen);
+    free(text);
+    free(a);
+    free(b);
+    return 0;
+}
+
+static int net_contains(const cipv4_net * a, const cipv4_net * b){
+    uint64_t as = a->addr_start, ae = as + (1ULL << (32 - a->network_prefix)) - 1;
+    uint64_t bs = b->addr_start, be = bs + (1ULL << (32 - b->network_prefix)) - 1;
+    return as <= bs && be <= ae;
+}
+
+int test_net(){
+    cipv4_net a = {cipv4_str_to_uint("10.0.0.0"), 8};
+    cipv4_net b = {cipv4_str_to_uint("10.1.0.0"), 16};
+    cipv4_net c = {cipv4_str_to_uint("11.0.0.0"), 8};
+    cipv4_net all = {0, 0};
+    assert(cipv4_net_overlaps(&a, &b) == 1 && cipv4_net_overlaps(&b, &a) == 1);
+    assert(cipv4_net_overlaps(&a, &c) == 0 && cipv4_net_overlaps(&all, &c) == 1);
+    assert(cipv4_net_subnet_of(&b, &a) == 1 && cipv4_net_subnet_of(&a, &b) == 0);
+    assert(cipv4_net_subnet_of(&a, &a) == 1 && cipv4_net_supernet_of(&a, &a) == 1);
+    assert(cipv4_net_supernet_of(&a, &b) == 1 && cipv4_net_supernet_of(&b, &a) == 0);
+    assert(cipv4_net_subnet_of(&c, &all) == 1);
+    cipv4_net bad = {0, 33};
+    assert(cipv4_net_overlaps(&a, &bad) == -1 && cipv4_net_subnet_of(NULL, &a) == -1);
+
+    // Python's documented example of address_exclude()
+    cipv4_net net = {cipv4_str_to_uint("192.0.2.0"), 28};
+    cipv4_net hole = {cipv4_str_to_uint("192.0.2.1"), 32};
+    cipv4_net out[CIPV4_NET_MAX_EXCLUDE];
+    const char * expected[4] = {"192.0.2.8", "192.0.2.4", "192.0.2.2", "192.0.2.0"};
+    assert(cipv4_net_exclude(&net, &hole, out) == 4);
+    for (int i=0; i<4; ++i)
+        assert(out[i].addr_start == cipv4_str_to_uint(expected[i]) && out[i].network_prefix == 29 + i);
+    assert(cipv4_net_exclude(&net, &net, out) == 0);
+    assert(cipv4_net_exclude(&hole, &net, out) == -1);
+    assert(cipv4_net_exclude(&all, &hole, out) == 32);
+    uint64_t covered = 0;
+    for (int i=0; i<32; ++i){
+        assert(cipv4_net_overlaps(&out[i], &hole) == 0);
+        covered += 1ULL << (32 - out[i].network_prefix);
+    }
+    assert(covered == 0xFFFFFFFFULL);
+
+    // the sweeps against the pair tests on random sets with many overlaps
+    srand(7);
+    enum {N = 700, M = 500};
+    cipv4_net * x = (cipv4_net*) malloc(N * sizeof(cipv4_net));
+    cipv4_net * y = (cipv4_net*) malloc(M * sizeof(cipv4_net));
+    uint8_t flags[N];
+    for (int i=0; i<N + M; ++i){
+        cipv4_net * r = i < N ? &x[i] : &y[i - N];
+        r->network_prefix = (uint8_t)(16 + rand() % 17);
+        uint32_t addr = 0x0A000000 | ((uint32_t)rand() & 0x00FFFFFF);
+        r->addr_start = addr & (0xFFFFFFFFu << (32 - r->network_prefix));
+        if (i < N && rand() % 50 == 0)
+            r->network_prefix = (uint8_t)(rand() % 8);
+        r->addr_start &= r->network_prefix ? 0xFFFFFFFFu << (32 - r->network_prefix) : 0;
+    }
+    y[0] = x[3];
+    for (int relation=CIPV4_NET_OVERLAPS; relation<=CIPV4_NET_SUPERNET_OF; ++relation){
+        long int count = cipv4_net_match_any(x, N, y, M, relation, flags);
+        long int expected_count = 0;
+        for (int i=0; i<N; ++i){
+            int hit = 0;
+            for (int j=0; j<M && !hit; ++j)
+                hit = relation == CIPV4_NET_OVERLAPS ? cipv4_net_overlaps(&x[i], &y[j]) :
+                      relation == CIPV4_NET_SUBNET_OF ? net_contains(&y[j], &x[i]) : net_contains(&x[i], &y[j]);
+            assert(flags[i] == hit);
+            expected_count += hit;
+        }
+        assert(count == expected_count && count > 0 && count < N);
+    }
+    long int count = cipv4_net_overlaps_within(x, N, flags);
+    long int expected_count = 0;
+    for (int i=0; i<N; ++i){
+        int hit = 0;
+        for (int j=0; j<N && !hit; ++j)
+            hit = j != i && cipv4_net_overlaps(&x[i], &x[j]);
+        assert(flags[i] == hit);
+        expected_count += hit;
+    }
+    assert(count == expected_count && count > 0);
+    // outermost: sorted, disjoint, every input inside exactly one of them
+    cipv4_net * outer = (cipv4_net*) malloc(N * sizeof(cipv4_net));
+    long int nouter = cipv4_net_outermost(x, N, outer);
+    assert(nouter > 0 && nouter < N);
+    for (long int k=1; k<nouter; ++k)
+        assert(outer[k - 1].addr_start < outer[k].addr_start && !cipv4_net_overlaps(&outer[k - 1], &outer[k]));
+    for (int i=0; i<N; ++i){
+        int inside = 0;
+        for (long int k=0; k<nouter; ++k)
+            inside += net_contains(&outer[k], &x[i]);
+        assert(inside == 1);
+    }
+    for (long int k=0; k<nouter; ++k){
+        int found = 0;
+        for (int i=0; i<N && !found; ++i)
+            found = outer[k].addr_start == x[i].addr_start && outer[k].network_prefix == x[i].network_prefix;
+        assert(found);
+    }
+    assert(cipv4_net_outermost(x, 0, outer) == 0);
+    free(outer);
+    assert(cipv4_net_match_any(x, N, y, 0, CIPV4_NET_OVERLAPS, flags) == 0 && flags[0] == 0);
+    assert(cipv4_net_match_any(x, N, y, M, 3, flags) == -1);
+    y[1] = bad;
+    assert(cipv4_net_match_any(x, N, y, M, CIPV4_NET_OVERLAPS, flags) == -1);
+    free(x);
+    free(y);
+    return 0;
+}
+
+typedef struct{
+    cipv4_limit * limit;
+    uint32_t addr;
+    long int admitted;
+} limit_job;
+
+static void * limit_worker(void * arg){
+    limit_job * job = (limit_job*) arg;
+    for (int i=0; i<100000; ++i)
+        job->admitted += cipv4_limit_take(job->limit, job->addr + (uint32_t)(i & 0xFF), 1, 5000000000ULL);
+    return NULL;
+}
+
+int test_limit(){
+    cipv4_limit_config config;
+    cipv4_limit_config_init(&config);
+    config.rate = 10;
+    config.burst = 5;
+    uint64_t now = 1000000000ULL;
+    cipv4_limit * limit = cipv4_limit_new(&config);
+    uint32_t addr = cipv4_str_to_uint("192.0.2.7");
+    assert(cipv4_limit_tokens(limit, addr, now) == 5);
+    for (int i=0; i<5; ++i)
+        assert(cipv4_limit_take(limit, addr + i, 1, now) == CIPV4_LIMIT_ADMIT);
+    assert(cipv4_limit_take(limit, addr, 1, now) == CIPV4_LIMIT_DENY);
+    assert(cipv4_limit_tokens(limit, addr, now) == 0);
+    // another /24 has its own bucket, 100ms later one token is back
+    assert(cipv4_limit_take(limit, cipv4_str_to_uint("192.0.3.7"), 1, now) == CIPV4_LIMIT_ADMIT);
+    assert(cipv4_limit_take(limit, addr, 1, now + 99000000) == CIPV4_LIMIT_DENY);
+    assert(cipv4_limit_take(limit, addr, 1, now + 100000000) == CIPV4_LIMIT_ADMIT);
+    assert(cipv4_limit_take(limit, addr, 1, now + 100000000) == CIPV4_LIMIT_DENY);
+    assert(cipv4_limit_tokens(limit, addr, now + 350000000) > 2.49 && cipv4_limit_tokens(limit, addr, now + 350000000) < 2.51);
+    assert(cipv4_limit_take(limit, addr, 3, now + 350000000) == CIPV4_LIMIT_DENY);
+    assert(cipv4_limit_take(limit, addr, 2, now + 350000000) == CIPV4_LIMIT_ADMIT);
+    assert(cipv4_limit_take(limit, addr, 6, now + 9000000000ULL) == CIPV4_LIMIT_DENY);
+    // both buckets are full again after 1s and nothing else is stored
+    assert(cipv4_limit_evict(limit, now + 2000000000ULL) == 2);
+    assert(cipv4_limit_evict(limit, now + 2000000000ULL) == 0);
+    cipv4_limit_free(limit);
+
+    // longest prefix match, /24 for the addresses without a rule
+    cipv4_acl_rule rules[2] = {
+        {cipv4_str_to_uint("10.0.0.0"), 8, CIPV4_ACL_PERMIT},
+        {cipv4_str_to_uint("10.1.0.0"), 16, CIPV4_ACL_PERMIT},
+    };
+    cipv4_acl * acl = cipv4_acl_compile_lpm(rules, 2, CIPV4_ACL_DENY);
+    config.acl = acl;
+    config.burst = 2;
+    limit = cipv4_limit_new(&config);
+    const char * addrs_str[10] = {"10.1.0.1", "10.1.200.1", "10.1.3.3", "10.2.0.1", "10.200.0.1",
+                                  "10.3.0.1", "11.0.0.1", "11.0.0.2", "11.0.0.3", "11.0.1.1"};
+    uint8_t expected[10] = {1, 1, 0, 1, 1, 0, 1, 1, 0, 1};
+    uint32_t addrs[10];
+    uint8_t admitted[10];
+    for (int i=0; i<10; ++i)
+        addrs[i] = cipv4_str_to_uint(addrs_str[i]);
+    assert(cipv4_limit_admit(limit, addrs, 10, now, admitted) == 7);
+    assert(memcmp(admitted, expected, 10) == 0);
+    cipv4_limit_free(limit);
+    config.acl = NULL;
+
+    // batch decisions are the same as one call per address
+    config.rate = 1000;
+    config.burst = 3;
+    config.network_prefix = 28;
+    cipv4_limit * a = cipv4_limit_new(&config);
+    cipv4_limit * b = cipv4_limit_new(&config);
+    uint32_t stream[1000];
+    uint8_t batch[1000];
+    srand(11);
+    for (int i=0; i<1000; ++i)
+        stream[i] = 0xC0000200 | (uint32_t)(rand() & 0x3F);
+    for (int round=0; round<5; ++round){
+        long int count = cipv4_limit_admit(a, stream, 1000, now + round * 1000000, batch);
+        long int single = 0;
+        for (int i=0; i<1000; ++i){
+            int r = cipv4_limit_take(b, stream[i], 1, now + round * 1000000);
+            assert(r == batch[i]);
+            single += r;
+        }
+        assert(count == single && count > 0 && count < 1000);
+    }
+    cipv4_limit_free(a);
+    cipv4_limit_free(b);
+
+    // bounded memory: busy buckets overflow, idle ones are evicted
+    config.capacity = 16;
+    config.network_prefix = 32;
+    config.overflow_action = CIPV4_LIMIT_DENY;
+    limit = cipv4_limit_new(&config);
+    assert(limit->mask == 15);
+    long int placed = 0;
+    for (uint32_t i=0; i<64; ++i)
+        placed += cipv4_limit_take(limit, 0x0A000000 + i, 1, now);
+    assert(placed == 16 && atomic_load(&limit->overflows) == 48);
+    placed = 0;
+    for (uint32_t i=64; i<80; ++i)
+        placed += cipv4_limit_take(limit, 0x0A000000 + i, 1, now + 10000000);
+    assert(placed == 16 && atomic_load(&limit->evictions) == 16);
+    cipv4_limit_free(limit);
+
+    // threads on the same buckets never take more than the burst
+    config.capacity = 1024;
+    config.burst = 1000;
+    config.rate = 1;
+    config.network_prefix = 32;
+    limit = cipv4_limit_new(&config);
+    pthread_t threads[4];
+    limit_job jobs[4];
+    for (int t=0; t<4; ++t){
+        jobs[t].limit = limit;
+        jobs[t].addr = 0x0B000000;
+        jobs[t].admitted = 0;
+        assert(pthread_create(&threads[t], NULL, limit_worker, &jobs[t]) == 0);
+    }
+    long int total = 0;
+    for (int t=0; t<4; ++t){
+        pthread_join(threads[t], NULL);
+        total += jobs[t].admitted;
+    }
+    assert(total == 256 * 1000);
+    cipv4_limit_free(limit);
+
+    config.rate = 0;
+    assert(cipv4_limit_new(&config) == NULL);
+    config.rate = 1;
+    config.network_prefix = 33;
+    assert(cipv4_limit_new(&config) == NULL);
+    cipv4_acl_free(acl);
+    return 0;
+}
+
+static int same_net(const cipv4_net * net, const char * addr, uint8_t prefix){
+    return net->addr_start == cipv4_str_to_uint(addr) && net->network_prefix == prefix;
+}
+
+int test_ingest(){
+    cipv4_net out[CIPV4_INGEST_MAX_NETS];
+    int form = -1;
+    assert(cipv4_ingest_record("10.1.2.3/8", 10, out, &form) == 1 && form == CIPV4_INGEST_CIDR);
+    assert(same_net(&out[0], "10.0.0.0", 8));
+    assert(cipv4_ingest_record("0.0.0.0/0", 9, out, &form) == 1 && same_net(&out[0], "0.0.0.0", 0));
+    assert(cipv4_ingest_record("10.0.0.0/255.255.240.0", 22, out, &form) == 1 && form == CIPV4_INGEST_NETMASK);
+    assert(same_net(&out[0], "10.0.0.0", 20));
+    assert(cipv4_ingest_record("10.0.0.0/0.0.15.255", 19, out, &form) == 1 && form == CIPV4_INGEST_HOSTMASK);
+    assert(same_net(&out[0], "10.0.0.0", 20));
+    assert(cipv4_ingest_record("10.0.0.0/0.0.0.0", 16, out, &form) == 1 && form == CIPV4_INGEST_NETMASK);
+    assert(out[0].network_prefix == 0);
+    assert(cipv4_ingest_record("10.0.0.7/255.255.255.255", 24, out, &form) == 1 && same_net(&out[0], "10.0.0.7", 32));
+    assert(cipv4_ingest_record("  8.8.8.8\r", 10, out, &form) == 1 && form == CIPV4_INGEST_ADDRESS);
+    assert(same_net(&out[0], "8.8.8.8", 32));
+    assert(cipv4_ingest_record("10.0.0.0 - 10.0.2.255 # two", 27, out, &form) == 2 && form == CIPV4_INGEST_RANGE);
+    assert(same_net(&out[0], "10.0.0.0", 23) && same_net(&out[1], "10.0.2.0", 24));
+    assert(cipv4_ingest_record("0.0.0.0-255.255.255.255", 23, out, &form) == 1 && out[0].network_prefix == 0);
+    assert(cipv4_ingest_record("0.0.0.1-255.255.255.254", 23, out, &form) == CIPV4_INGEST_MAX_NETS);
+    assert(cipv4_ingest_record("5.5.5.5-5.5.5.5", 15, out, &form) == 1 && same_net(&out[0], "5.5.5.5", 32));
+    assert(cipv4_ingest_record("   # comment", 12, out, &form) == 0);
+    assert(cipv4_ingest_record("", 0, out, &form) == 0);
+    const char * bad[] = {"10.0.0.0/255.0.255.0", "10.0.0.0/33", "10.0.0.0/08", "10.0.0.0/", "10.0.0.2-10.0.0.1",
+                          "10.0.0.1-", "10.0.0.256", "10.0.0", "10.00.0.1", "10.0.0.0/24x", "1.2.3.4.5", "abc",
+                          "10.0.0.0/255.255.255.0.0", "10.0.0.1 10.0.0.2"};
+    for (size_t i=0; i<sizeof(bad) / sizeof(bad[0]); ++i)
+        assert(cipv4_ingest_record(bad[i], strlen(bad[i]), out, &form) == -1);
+
+    // ranges: the networks are aligned, contiguous and cover exactly the range
+    srand(5);
+    for (int k=0; k<2000; ++k){
+        uint32_t a = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        uint32_t b = a + (k & 1 ? (uint32_t)rand() : (uint32_t)rand() % 5000);
+        if (b < a){
+            uint32_t swap = a;
+            a = b;
+            b = swap;
+        }
+        char text[40];
+        char first[16], last[16];
+        cipv4_uint_to_str(a, first);
+        cipv4_uint_to_str(b, last);
+        sprintf(text, "%s-%s", first, last);
+        int n = cipv4_ingest_record(text, strlen(text), out, &form);
+        assert(n > 0 && n <= CIPV4_INGEST_MAX_NETS);
+        uint64_t next = a;
+        for (int i=0; i<n; ++i){
+            uint64_t size = 1ULL << (32 - out[i].network_prefix);
+            assert(out[i].addr_start == next && (out[i].addr_start & (size - 1)) == 0);
+            // not mergeable with the next one into a bigger network
+            if (i + 1 < n && out[i + 1].network_prefix == out[i].network_prefix)
+                assert((out[i].addr_start & (2 * size - 1)) != 0);
+            next += size;
+        }
+        assert(next == (uint64_t)b + 1);
+    }
+
+    const char * feed = "# feed\n10.0.0.0/8\r\n192.168.0.0/255.255.0.0\n\n172.16.0.0/0.15.255.255\n"
+                        "bogus\n1.1.1.1\n1.0.0.0-1.0.2.255\n10.0.0.0/255.0.255.0\n2.2.2.0/24";
+    cipv4_ingest * ingest = cipv4_ingest_new();
+    assert(cipv4_ingest_buffer(ingest, feed, strlen(feed)) == 7);
+    assert(ingest->count == 7 && ingest->lines == 10 && ingest->errors == 2 && ingest->first_error == 6);
+    assert(ingest->forms[CIPV4_INGEST_CIDR] == 2 && ingest->forms[CIPV4_INGEST_NETMASK] == 1);
+    assert(ingest->forms[CIPV4_INGEST_HOSTMASK] == 1 && ingest->forms[CIPV4_INGEST_ADDRESS] == 1);
+    assert(ingest->forms[CIPV4_INGEST_RANGE] == 1);
+    assert(same_net(&ingest->nets[0], "10.0.0.0", 8) && same_net(&ingest->nets[1], "192.168.0.0", 16));
+    assert(same_net(&ingest->nets[2], "172.16.0.0", 12) && same_net(&ingest->nets[3], "1.1.1.1", 32));
+    assert(same_net(&ingest->nets[4], "1.0.0.0", 23) && same_net(&ingest->nets[5], "1.0.2.0", 24));
+    assert(same_net(&ingest->nets[6], "2.2.2.0", 24));
+    cipv4_ingest_free(ingest);
+
+    // the whole database, same networks as cipv4_parse_ip() line by line
+    ingest = cipv4_ingest_new();
+    long int n = cipv4_ingest_file(ingest, "test/example.db");
+    assert(n > 0 && ingest->errors == 0 && (size_t)n == ingest->count);
+    FILE * f = fopen("test/example.db", "r");
+    char line[256];
+    size_t i = 0;
+    while (fgets(line, sizeof(line), f)){
+        line[strcspn(line, " \t\r\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        cipv4_ctx * ctx = cipv4_parse_ip(line);
+        assert(ctx->error == 0 && ingest->nets[i].addr_start == ctx->addr_start);
+        assert(ingest->nets[i].network_prefix == ctx->network_prefix);
+        cipv4_free(ctx);
+        i++;
+    }
+    fclose(f);
+    assert(i == ingest->count);
+    assert(cipv4_ingest_file(ingest, "/nonexistent.db") == -1);
+    cipv4_ingest_free(ingest);
+    return 0;
+}
+
+int test_hist(){
+    assert(cipv4_hist_new(0, 1) == NULL && cipv4_hist_new(25, 1) == NULL);
+    assert(cipv4_hist_new(16, 0) == NULL);
+    cipv4_hist * hist = cipv4_hist_new(16, 3);
+    assert(hist != NULL && hist->nbuckets == 65536);
+    assert(cipv4_hist_get_shard(hist, 3) == NULL);
+    uint32_t addrs[5] = {cipv4_str_to_uint("10.1.2.3"), cipv4_str_to_uint("10.1.200.1"),
+                         cipv4_str_to_uint("192.168.1.1"), cipv4_str_to_uint("10.1.0.0"),
+                         cipv4_str_to_uint("255.255.255.255")};
+    cipv4_hist_add_batch(cipv4_hist_get_shard(hist, 0), addrs, 5);
+    cipv4_hist_add(cipv4_hist_get_shard(hist, 2), cipv4_str_to_uint("192.168.9.9"), 4);
+    assert(cipv4_hist_merge(hist, 4) == 0);
+    assert(hist->hits == 9 && hist->nonzero == 3);
+    cipv4_net nets[4];
+    uint64_t counts[4];
+    assert(cipv4_hist_top(hist, 2, nets, counts) == 2);
+    assert(same_net(&nets[0], "192.168.0.0", 16) && counts[0] == 5);
+    assert(same_net(&nets[1], "10.1.0.0", 16) && counts[1] == 3);
+    assert(cipv4_hist_export(hist, 0, nets, counts, 4) == 3);
+    assert(same_net(&nets[0], "10.1.0.0", 16) && same_net(&nets[2], "255.255.0.0", 16) && counts[2] == 1);
+    assert(cipv4_hist_export(hist, (cipv4_str_to_uint("10.1.0.0") >> 16) + 1, nets, NULL, 1) == 1);
+    assert(same_net(&nets[0], "192.168.0.0", 16));
+    cipv4_hist_clear(hist);
+    assert(cipv4_hist_merge(hist, 1) == 0 && hist->hits == 0 && hist->nonzero == 0);
+    cipv4_hist_free(hist);
+
+    // every prefix, lanes and threads, same buckets as the addresses masked one by one
+    size_t n = 300000;
+    uint32_t * random = (uint32_t*) malloc(n * sizeof(uint32_t));
+    for (size_t i=0; i<n; ++i)
+        random[i] = i % 3 == 0 ? 0x0A000000u | (rand() & 0xFF) : ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    uint8_t prefixes[4] = {8, 12, 16, 24};
+    for (int p=0; p<4; ++p){
+        hist = cipv4_hist_new(prefixes[p], 4);
+        assert(cipv4_hist_count(hist, random, n) == 0);
+        assert(cipv4_hist_count(hist, random, 1000) == 0);
+        assert(cipv4_hist_merge(hist, 3) == 0 && hist->hits == n + 1000);
+        uint64_t * expected = (uint64_t*) calloc(hist->nbuckets, sizeof(uint64_t));
+        for (size_t i=0; i<n; ++i)
+            expected[random[i] >> (32 - prefixes[p])] += i < 1000 ? 2 : 1;
+        assert(memcmp(expected, hist->total, hist->nbuckets * sizeof(uint64_t)) == 0);
+        cipv4_net top;
+        uint64_t most;
+        assert(cipv4_hist_top(hist, 1, &top, &most) == 1);
+        assert(top.addr_start == 0x0A000000u && top.network_prefix == prefixes[p]);
+        assert(most == expected[0x0A000000u >> (32 - prefixes[p])]);
+        free(expected);
+        cipv4_hist_free(hist);
+    }
+    free(random);
+    return 0;
+}
+
 int main(){
     test_if_ip_valid();
     test_ip_to_int();
     test_int_to_ip();
     test_general();
+    test_arena();
+    test_acl();
+    test_sort();
+    test_counter();
+    test_hhh();
+    test_stats();
+    test_shm();
+    test_anon();
+    test_flow();
+    test_pcap();
+    test_gen();
+    test_net();
+    test_limit();
+    test_ingest();
+    test_hist();
     fprintf(stdout, "** All tests done successfully!\n");
     return 0;
 }
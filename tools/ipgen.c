@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <cipv4.h>
+#include <cipv4_flow.h>
+#include <cipv4_gen.h>
+#include <cipv4_ingest.h>
+
+/**
+ * Synthetic address streams for load and regression tests: addresses
+ * drawn uniformly (or with a Zipf skew by network) from a database of
+ * networks such as test/example.db (any notation of cipv4_ingest.h), one per line or as host-order uint32.
+ *
+ * Usage: ipgen [-d cidr.db] [-n count] [-z s] [-x] [-m rate] [-b] [-s seed] [-t threads] [-o file]
+ */
+
+#define CHUNK (1 << 20)
+
+static const char * usage = "Usage: %s [-d cidr.db] [-n count] [-z s] [-x] [-m rate] [-b] [-s seed] [-t threads] [-o file]\n"
+                            "  -z s     Zipf skew by network (database order) instead of uniform\n"
+                            "  -x       never generate the private/special ranges\n"
+                            "  -m rate  fraction of malformed lines (text only)\n"
+                            "  -b       binary output (host-order uint32)\n";
+
+int main(int argc, char ** argv){
+    const char * db = NULL;
+    const char * output = NULL;
+    unsigned long long count = 1000000;
+    int binary = 0;
+    cipv4_gen_config config;
+    cipv4_gen_config_init(&config);
+    config.nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:z:xm:bs:t:o:")) != -1){
+        switch (opt){
+            case 'd': db = optarg; break;
+            case 'n': count = strtoull(optarg, NULL, 10); break;
+            case 'z': config.distribution = CIPV4_GEN_ZIPF; config.zipf_s = atof(optarg); break;
+            case 'x': config.exclude = CIPV4_CLASS_PRIVATE; break;
+            case 'm': config.malformed_rate = atof(optarg); break;
+            case 'b': binary = 1; break;
+            case 's': config.seed = strtoull(optarg, NULL, 10); break;
+            case 't': config.nthreads = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc){
+        fprintf(stderr, usage, argv[0]);
+        return 1;
+    }
+    cipv4_net all = {0, 0};
+    cipv4_net * nets = &all;
+    uint32_t nnets = 1;
+    cipv4_ingest * ingest = NULL;
+    if (db){
+        ingest = cipv4_ingest_new();
+        if (!ingest || cipv4_ingest_file(ingest, db) <= 0){
+            fprintf(stderr, "Can not load %s\n", db);
+            cipv4_ingest_free(ingest);
+            return 1;
+        }
+        if (ingest->errors)
+            fprintf(stderr, "%s: skipped %llu invalid lines (first at line %llu)\n", db,
+                    (unsigned long long)ingest->errors, (unsigned long long)ingest->first_error);
+        nets = ingest->nets;
+        nnets = (uint32_t)ingest->count;
+    }
+    cipv4_gen * gen = cipv4_gen_new(nets, nnets, &config);
+    cipv4_ingest_free(ingest);
+    if (!gen){
+        fprintf(stderr, "Can not create the generator (wrong option or nothing left to generate)\n");
+        return 1;
+    }
+    FILE * out = output ? fopen(output, binary ? "wb" : "w") : stdout;
+    if (!out){
+        fprintf(stderr, "Can not open %s\n", output);
+        cipv4_gen_free(gen);
+        return 1;
+    }
+    void * buffer = malloc(binary ? CHUNK * sizeof(uint32_t) : (size_t)CHUNK * CIPV4_GEN_MAX_LINE);
+    int ret = buffer ? 0 : 1;
+    if (!buffer)
+        fprintf(stderr, "Can not allocate memory\n");
+    for (unsigned long long first=0; first<count && ret == 0; first+=CHUNK){
+        size_t n = count - first < CHUNK ? (size_t)(count - first) : CHUNK;
+        size_t size;
+        if (binary){
+            cipv4_gen_addrs(gen, first, (uint32_t*)buffer, n);
+            size = n * sizeof(uint32_t);
+        }
+        else
+            size = (size_t)cipv4_gen_text(gen, first, n, (char*)buffer);
+        if (fwrite(buffer, 1, size, out) != size){
+            fprintf(stderr, "Can not write the output\n");
+            ret = 1;
+        }
+    }
+    free(buffer);
+    if (out != stdout)
+        fclose(out);
+    cipv4_gen_free(gen);
+    return ret;
+}
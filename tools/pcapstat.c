@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <cipv4.h>
+#include <cipv4_acl.h>
+#include <cipv4_flow.h>
+#include <cipv4_pcap.h>
+#include <cipv4_ingest.h>
+
+/**
+ * Packet and byte totals of a classic pcap file by address category
+ * (private, multicast, ...) and by the longest matching prefix of a
+ * database of networks such as test/example.db (any notation of
+ * cipv4_ingest.h), for the source and the destination addresses.
+ *
+ * Usage: pcapstat [-d networks.db] [-t threads] [-n top] file.pcap
+ */
+
+static const char * class_names[CIPV4_PCAP_CLASSES] = {
+    "private", "public_network", "global", "loopback",
+    "multicast", "unspecified", "linklocal", "reserved"
+};
+
+static uint64_t * sort_keys = NULL;
+
+static int cmp_busiest(const void * a, const void * b){
+    uint64_t x = sort_keys[*(const uint32_t*)a];
+    uint64_t y = sort_keys[*(const uint32_t*)b];
+    if (x != y)
+        return x > y ? -1 : 1;
+    return *(const uint32_t*)a < *(const uint32_t*)b ? -1 : 1;
+}
+
+#define NAME_SIZE 19         // "255.255.255.255/32" + null
+
+// one rule per network of the database (any notation of cipv4_ingest.h)
+// and its CIDR for the report, 0 if the file can not be read or has no network
+static uint32_t load_db(const char * path, cipv4_acl_rule ** rules, char ** names){
+    cipv4_ingest * ingest = cipv4_ingest_new();
+    if (!ingest || cipv4_ingest_file(ingest, path) <= 0 || ingest->count > UINT32_MAX){
+        cipv4_ingest_free(ingest);
+        return 0;
+    }
+    if (ingest->errors)
+        fprintf(stderr, "%s: skipped %llu invalid lines (first at line %llu)\n", path,
+                (unsigned long long)ingest->errors, (unsigned long long)ingest->first_error);
+    uint32_t n = (uint32_t)ingest->count;
+    *rules = (cipv4_acl_rule*) malloc(n * sizeof(cipv4_acl_rule));
+    *names = (char*) malloc((size_t)n * NAME_SIZE);
+    if (!*rules || !*names){
+        free(*rules);
+        free(*names);
+        *rules = NULL;
+        *names = NULL;
+        cipv4_ingest_free(ingest);
+        return 0;
+    }
+    char buffer[16];
+    for (uint32_t i=0; i<n; ++i){
+        (*rules)[i].addr = ingest->nets[i].addr_start;
+        (*rules)[i].network_prefix = ingest->nets[i].network_prefix;
+        (*rules)[i].action = CIPV4_ACL_PERMIT;
+        snprintf(*names + (size_t)i * NAME_SIZE, NAME_SIZE, "%s/%u",
+                 cipv4_uint_to_str(ingest->nets[i].addr_start, buffer), ingest->nets[i].network_prefix);
+    }
+    cipv4_ingest_free(ingest);
+    return n;
+}
+
+int main(int argc, char ** argv){
+    const char * db = NULL;
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long int top = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:n:")) != -1){
+        switch (opt){
+            case 'd': db = optarg; break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'n': top = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage: %s [-d networks.db] [-t threads] [-n top] file.pcap\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1){
+        fprintf(stderr, "Usage: %s [-d networks.db] [-t threads] [-n top] file.pcap\n", argv[0]);
+        return 1;
+    }
+    cipv4_pcap * pcap = cipv4_pcap_open(argv[optind]);
+    if (!pcap){
+        fprintf(stderr, "Can not read %s as a pcap file\n", argv[optind]);
+        return 1;
+    }
+    cipv4_acl_rule * rules = NULL;
+    char * names = NULL;
+    uint32_t nrules = 0;
+    cipv4_acl * acl = NULL;
+    if (db){
+        nrules = load_db(db, &rules, &names);
+        acl = nrules ? cipv4_acl_compile_lpm(rules, nrules, CIPV4_ACL_DENY) : NULL;
+        if (!acl){
+            free(rules);
+            free(names);
+            fprintf(stderr, "Can not load %s\n", db);
+            cipv4_pcap_close(pcap);
+            return 1;
+        }
+    }
+    cipv4_pcap_totals * t = cipv4_pcap_analyze(pcap, acl, nthreads);
+    if (!t){
+        fprintf(stderr, "Can not allocate memory\n");
+        return 1;
+    }
+    fprintf(stdout, "packets %lu bytes %lu ipv4_packets %lu ipv4_bytes %lu\n\n",
+            (unsigned long)t->packets, (unsigned long)t->bytes,
+            (unsigned long)t->ipv4_packets, (unsigned long)t->ipv4_bytes);
+    fprintf(stdout, "%-20s %12s %14s %12s %14s\n", "category", "src_packets", "src_bytes", "dst_packets", "dst_bytes");
+    for (int c=0; c<CIPV4_PCAP_CLASSES; ++c)
+        fprintf(stdout, "%-20s %12lu %14lu %12lu %14lu\n", class_names[c],
+                (unsigned long)t->class_packets[CIPV4_PCAP_SRC][c], (unsigned long)t->class_bytes[CIPV4_PCAP_SRC][c],
+                (unsigned long)t->class_packets[CIPV4_PCAP_DST][c], (unsigned long)t->class_bytes[CIPV4_PCAP_DST][c]);
+    if (acl){
+        // busiest prefixes by source + destination bytes, unmatched last
+        uint64_t * busy = (uint64_t*) malloc((nrules + 1) * sizeof(uint64_t));
+        uint32_t * order = (uint32_t*) malloc((nrules + 1) * sizeof(uint32_t));
+        uint32_t nbusy = 0;
+        for (uint32_t r=0; r<nrules; ++r){
+            busy[r] = t->rule_bytes[CIPV4_PCAP_SRC][r] + t->rule_bytes[CIPV4_PCAP_DST][r];
+            if (t->rule_packets[CIPV4_PCAP_SRC][r] + t->rule_packets[CIPV4_PCAP_DST][r])
+                order[nbusy++] = r;
+        }
+        sort_keys = busy;
+        qsort(order, nbusy, sizeof(uint32_t), cmp_busiest);
+        if (top && nbusy > top)
+            nbusy = (uint32_t)top;
+        order[nbusy++] = nrules;
+        fprintf(stdout, "\n%-20s %12s %14s %12s %14s\n", "prefix", "src_packets", "src_bytes", "dst_packets", "dst_bytes");
+        for (uint32_t i=0; i<nbusy; ++i){
+            uint32_t r = order[i];
+            fprintf(stdout, "%-20s %12lu %14lu %12lu %14lu\n", r < nrules ? names + (size_t)r * NAME_SIZE : "(no match)",
+                    (unsigned long)t->rule_packets[CIPV4_PCAP_SRC][r], (unsigned long)t->rule_bytes[CIPV4_PCAP_SRC][r],
+                    (unsigned long)t->rule_packets[CIPV4_PCAP_DST][r], (unsigned long)t->rule_bytes[CIPV4_PCAP_DST][r]);
+        }
+        free(busy);
+        free(order);
+    }
+    free(names);
+    free(rules);
+    cipv4_acl_free(acl);
+    cipv4_pcap_totals_free(t);
+    cipv4_pcap_close(pcap);
+    return 0;
+}